@@ -0,0 +1,87 @@
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic_uint64_t allocation_count{};
+    std::atomic_uint64_t allocated_bytes{};
+
+    void* counted_alloc(std::size_t size) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+            return ptr;
+        }
+        throw std::bad_alloc{};
+    }
+
+    void* counted_aligned_alloc(std::size_t size, std::align_val_t alignment) {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+        auto align = static_cast<std::size_t>(alignment);
+        // aligned_alloc requires a size multiple of the alignment
+        std::size_t rounded_size = (size + align - 1) / align * align;
+        if (void* ptr = std::aligned_alloc(align, rounded_size == 0 ? align : rounded_size)) {
+            return ptr;
+        }
+        throw std::bad_alloc{};
+    }
+}
+
+bench::allocation_counts bench::allocations() noexcept {
+    return {
+        .count = allocation_count.load(std::memory_order_relaxed),
+        .bytes = allocated_bytes.load(std::memory_order_relaxed)
+    };
+}
+
+// the nothrow versions of the standard library forward to these
+void* operator new(std::size_t size) {
+    return counted_alloc(size);
+}
+
+void* operator new[](std::size_t size) {
+    return counted_alloc(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return counted_aligned_alloc(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return counted_aligned_alloc(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
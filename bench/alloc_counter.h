@@ -0,0 +1,17 @@
+#ifndef IMEDIT_LS_BENCH_ALLOC_COUNTER_H
+#define IMEDIT_LS_BENCH_ALLOC_COUNTER_H
+
+#include <cstdint>
+
+namespace bench {
+    // Counts of the calls to the global operator new, from every thread, since the program started
+    struct allocation_counts {
+        std::uint64_t count{};
+        std::uint64_t bytes{};
+    };
+
+    [[nodiscard]] allocation_counts allocations() noexcept;
+}
+
+
+#endif //IMEDIT_LS_BENCH_ALLOC_COUNTER_H
@@ -0,0 +1,190 @@
+#include "bench_driver.h"
+
+#include <imgui_app.h>
+
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "editor_text.h"
+
+namespace {
+    constexpr ImVec2 display_size{1440, 900};
+    constexpr auto server_startup_timeout = std::chrono::seconds{30};
+
+    double to_ms(bench::clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+}
+
+bench_driver::bench_driver(const std::filesystem::path& server, lsptypes::server_options options, std::chrono::microseconds frame_period)
+    : _server{std::make_unique<clangd_server>(server, options)}
+    , _frame_period{frame_period}
+{
+    auto start = bench::clock::now();
+    _server->setup_editor(_editor);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = nullptr;
+
+    _app = ImGuiApp_ImplNull_Create();
+    _app->InitCreateWindow(_app, "ImEdit_LS bench", display_size);
+    _app->InitBackends(_app);
+    // the null backend leaves the font atlas alone, but ImGui::NewFrame needs it built
+    ImGui::GetIO().Fonts->Build();
+
+    _editor._width = display_size.x - 20;
+    _editor._height = display_size.y - 50;
+
+    // lay the editor out, then click in it to give it the keyboard focus
+    frame();
+    ImGuiIO& io = ImGui::GetIO();
+    io.AddMousePosEvent(display_size.x / 2, display_size.y / 2);
+    io.AddMouseButtonEvent(ImGuiMouseButton_Left, true);
+    frame();
+    io.AddMouseButtonEvent(ImGuiMouseButton_Left, false);
+    frame();
+
+    // the server starts in the background, scenarios are measured once it is up
+    auto deadline = start + server_startup_timeout;
+    while (_server->state() != lsptypes::server_state::ready) {
+        if (_server->state() == lsptypes::server_state::failed || bench::clock::now() > deadline) {
+            throw std::runtime_error("the language server did not start");
+        }
+        frame();
+    }
+    _server_ready_ms = to_ms(bench::clock::now() - start);
+    _samples = {};
+}
+
+bench_driver::~bench_driver() {
+    _server.reset();
+
+    _app->ShutdownBackends(_app);
+    _app->ShutdownCloseWindow(_app);
+    ImGui::DestroyContext();
+    _app->Destroy(_app);
+}
+
+void bench_driver::frame() {
+    std::this_thread::sleep_until(_next_frame);
+    auto start = bench::clock::now();
+    _next_frame = start + _frame_period;
+
+    _app->NewFrame(_app);
+    ImGui::NewFrame();
+
+    _server->update(_editor, _visible_lines);
+
+    ImGui::SetNextWindowPos({0, 0});
+    ImGui::SetNextWindowSize(display_size);
+    if (ImGui::Begin("Editor", nullptr, ImGuiWindowFlags_NoDecoration)) {
+        _editor.render();
+        _visible_lines = editor_visible_lines(_editor);
+    }
+    ImGui::End();
+
+    ImGui::Render();
+    _app->Render(_app);
+
+    _samples.frame_time_ms.push_back(to_ms(bench::clock::now() - start));
+    record_highlights();
+}
+
+void bench_driver::type(std::string_view text, std::chrono::milliseconds interval) {
+    for (char c : text) {
+        auto next_key = bench::clock::now() + interval;
+        if (c == '\n') {
+            press(ImGuiKey_Enter);
+        } else {
+            ImGui::GetIO().AddInputCharacter(static_cast<unsigned char>(c));
+            edit_injected();
+            frame();
+        }
+        while (bench::clock::now() < next_key) {
+            frame();
+        }
+    }
+}
+
+void bench_driver::paste(const std::string& text) {
+    ImGui::SetClipboardText(text.c_str());
+    key_chord(ImGuiKey_V, true, true);
+}
+
+void bench_driver::select_all() {
+    key_chord(ImGuiKey_A, true, false);
+}
+
+void bench_driver::press(ImGuiKey key) {
+    key_chord(key, false, true);
+}
+
+bool bench_driver::wait_for_highlight(std::chrono::milliseconds timeout) {
+    auto deadline = bench::clock::now() + timeout;
+    while (!_unhighlighted_edits.empty()) {
+        if (bench::clock::now() > deadline) {
+            ++_samples.timeouts;
+            _unhighlighted_edits.clear();
+            return false;
+        }
+        frame();
+    }
+    return true;
+}
+
+void bench_driver::idle(std::chrono::milliseconds duration) {
+    auto end = bench::clock::now() + duration;
+    while (bench::clock::now() < end) {
+        frame();
+    }
+}
+
+bench::samples bench_driver::take_samples() {
+    return std::exchange(_samples, {});
+}
+
+void bench_driver::key_chord(ImGuiKey key, bool ctrl, bool is_edit) {
+    ImGuiIO& io = ImGui::GetIO();
+    if (ctrl) {
+        io.AddKeyEvent(ImGuiMod_Ctrl, true);
+    }
+    io.AddKeyEvent(key, true);
+    if (is_edit) {
+        edit_injected();
+    }
+    frame();
+
+    io.AddKeyEvent(key, false);
+    if (ctrl) {
+        io.AddKeyEvent(ImGuiMod_Ctrl, false);
+    }
+    frame();
+}
+
+void bench_driver::edit_injected() {
+    if (_unhighlighted_edits.empty()) {
+        _version_before_edits = _server->document_version(_editor);
+    }
+    _unhighlighted_edits.push_back(bench::clock::now());
+}
+
+void bench_driver::record_highlights() {
+    if (_unhighlighted_edits.empty()) {
+        return;
+    }
+
+    // the edits are highlighted once they were all sent, and the tokens of the resulting version applied
+    const clangd_server& server = *_server;
+    if (server.has_pending_edits(_editor) || server.document_version(_editor) == _version_before_edits
+        || server.highlighted_version(_editor) != server.document_version(_editor)) {
+        return;
+    }
+
+    auto now = bench::clock::now();
+    for (bench::clock::time_point edit_time : _unhighlighted_edits) {
+        _samples.edit_to_highlight_ms.push_back(to_ms(now - edit_time));
+    }
+    _unhighlighted_edits.clear();
+}
@@ -0,0 +1,86 @@
+#ifndef IMEDIT_LS_BENCH_BENCH_DRIVER_H
+#define IMEDIT_LS_BENCH_BENCH_DRIVER_H
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <imgui.h>
+#include <imedit/editor.h>
+
+#include "clangd_server.h"
+
+struct ImGuiApp;
+
+namespace bench {
+    using clock = std::chrono::steady_clock;
+
+    // Measures gathered while the driver runs, reset by take_samples()
+    struct samples {
+        std::vector<double> edit_to_highlight_ms{}; // one per edit input
+        std::vector<double> frame_time_ms{}; // time spent in each frame, without waiting for the next one
+        unsigned int timeouts{};
+    };
+}
+
+// Runs an editor connected to a language server in a headless ImGui application (ImGuiApp_ImplNull), and drives
+// it through ImGui input events the way a user would
+class bench_driver {
+public:
+    bench_driver(const std::filesystem::path& server, lsptypes::server_options options, std::chrono::microseconds frame_period);
+    ~bench_driver();
+
+    bench_driver(const bench_driver&) = delete;
+    bench_driver& operator=(const bench_driver&) = delete;
+
+    void frame();
+
+    // Types text one character per interval, '\n' being typed as the Enter key
+    void type(std::string_view text, std::chrono::milliseconds interval);
+    void paste(const std::string& text);
+    void select_all();
+    void press(ImGuiKey key);
+
+    // Runs frames until the tokens of the latest edit are applied. Returns false on timeout.
+    bool wait_for_highlight(std::chrono::milliseconds timeout);
+    // Runs frames for the given duration
+    void idle(std::chrono::milliseconds duration);
+
+    [[nodiscard]] bench::samples take_samples();
+
+    // time from the construction of the driver until the server was ready, frames running meanwhile
+    [[nodiscard]] double server_ready_ms() const noexcept {
+        return _server_ready_ms;
+    }
+
+    [[nodiscard]] const clangd_server& server() const noexcept {
+        return *_server;
+    }
+
+private:
+    // injects a key press, optionally with ctrl held, and its release over two frames
+    void key_chord(ImGuiKey key, bool ctrl, bool is_edit);
+    void edit_injected();
+    void record_highlights();
+
+    std::unique_ptr<clangd_server> _server;
+    ImEdit::editor _editor{"bench.cpp"};
+    ImGuiApp* _app{nullptr};
+
+    double _server_ready_ms{};
+    std::chrono::microseconds _frame_period;
+    bench::clock::time_point _next_frame{};
+    lsptypes::line_range _visible_lines{};
+
+    // edit inputs not highlighted yet, and the document version they will be part of
+    std::vector<bench::clock::time_point> _unhighlighted_edits{};
+    int _version_before_edits{};
+
+    bench::samples _samples{};
+};
+
+
+#endif //IMEDIT_LS_BENCH_BENCH_DRIVER_H
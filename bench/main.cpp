@@ -0,0 +1,194 @@
+#include <charconv>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "bench_driver.h"
+#include "report.h"
+
+namespace {
+    using namespace std::chrono_literals;
+
+    struct options {
+        std::string server{"/usr/bin/clangd"};
+        std::vector<std::string> server_arguments{};
+        std::string output{};
+        unsigned int fps{60};
+        unsigned int large_file_lines{10'000};
+    };
+
+    constexpr std::string_view usage =
+        "usage: ImEdit_LS_bench [--server PATH] [--server-arg ARG]... [--output FILE] [--fps N] [--lines N]\n"
+        "  --server      language server executable (default: /usr/bin/clangd)\n"
+        "  --server-arg  argument the language server is started with, replaces the default ones\n"
+        "  --output      file the JSON report is written to (default: standard output)\n"
+        "  --fps         frame rate the render loop is paced at (default: 60)\n"
+        "  --lines       line count of the pasted file (default: 10000)\n";
+
+    bool parse_uint(std::string_view str, unsigned int& value) {
+        auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+        return error == std::errc{} && end == str.data() + str.size() && value != 0;
+    }
+
+    bool parse_options(int argc, char* argv[], options& opts) {
+        for (int i = 1 ; i < argc ; ++i) {
+            std::string_view arg = argv[i];
+            if (i + 1 == argc) {
+                return false;
+            }
+            std::string_view value = argv[++i];
+
+            if (arg == "--server") {
+                opts.server = value;
+            } else if (arg == "--server-arg") {
+                opts.server_arguments.emplace_back(value);
+            } else if (arg == "--output") {
+                opts.output = value;
+            } else if (arg == "--fps") {
+                if (!parse_uint(value, opts.fps)) {
+                    return false;
+                }
+            } else if (arg == "--lines") {
+                if (!parse_uint(value, opts.large_file_lines)) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Plausible C++ with a bit of every kind of semantic token
+    std::string generate_source(unsigned int line_count) {
+        constexpr std::string_view block[] = {
+            "namespace bench_%%_ns {",
+            "    template <typename T>",
+            "    struct widget_%% : public std::vector<T> {",
+            "        static constexpr int id = %%;",
+            "        [[nodiscard]] T get(std::size_t idx) const { return (*this)[idx] + T{id}; }",
+            "    };",
+            "#define WIDGET_%%(x) widget_%%<x>",
+            "    inline int use_%%(const WIDGET_%%(int)& w) { return w.empty() ? -1 : w.get(0); }",
+            "}",
+            "",
+        };
+        constexpr auto block_size = static_cast<unsigned int>(std::size(block));
+
+        std::string source = "#include <vector>\n";
+        for (unsigned int line = 1 ; line < line_count ; ++line) {
+            std::string_view pattern = block[(line - 1) % block_size];
+            std::string index = std::to_string((line - 1) / block_size);
+            for (std::size_t pos = 0 ; pos < pattern.size() ;) {
+                auto marker = pattern.find("%%", pos);
+                source.append(pattern.substr(pos, marker - pos));
+                if (marker == std::string_view::npos) {
+                    break;
+                }
+                source.append(index);
+                pos = marker + 2;
+            }
+            source += '\n';
+        }
+        return source;
+    }
+
+    bench::scenario_report run_scenario(bench_driver& driver, std::string name, const std::function<void(bench_driver&)>& script) {
+        std::cerr << "running " << name << "...\n";
+
+        // drop whatever the previous scenario left in flight
+        driver.idle(200ms);
+        static_cast<void>(driver.take_samples());
+
+        const clangd_server& server = driver.server();
+        std::uint64_t bytes_sent = server.bytes_sent();
+        std::uint64_t bytes_received = server.bytes_received();
+        bench::allocation_counts allocated = bench::allocations();
+        auto start = bench::clock::now();
+
+        script(driver);
+
+        bench::allocation_counts allocated_after = bench::allocations();
+        return {
+            .name = std::move(name),
+            .duration_ms = std::chrono::duration<double, std::milli>(bench::clock::now() - start).count(),
+            .measures = driver.take_samples(),
+            .bytes_sent = server.bytes_sent() - bytes_sent,
+            .bytes_received = server.bytes_received() - bytes_received,
+            .allocated = {
+                .count = allocated_after.count - allocated.count,
+                .bytes = allocated_after.bytes - allocated.bytes
+            }
+        };
+    }
+}
+
+int main(int argc, char* argv[]) {
+    options opts;
+    if (!parse_options(argc, argv, opts)) {
+        std::cerr << usage;
+        return 1;
+    }
+
+    constexpr std::string_view typed_code = "int typed_value = 42;\nauto twice = typed_value * 2;\n";
+    constexpr auto typing_interval = 80ms;
+
+    bench::run_report report{
+        .server = opts.server,
+        .frame_period = std::chrono::microseconds{1'000'000 / opts.fps}
+    };
+
+    try {
+        lsptypes::server_options server_options;
+        if (!opts.server_arguments.empty()) {
+            server_options.server_arguments = opts.server_arguments;
+        }
+        bench_driver driver(opts.server, std::move(server_options), report.frame_period);
+        report.server_ready_ms = driver.server_ready_ms();
+
+        report.scenarios.push_back(run_scenario(driver, "typing_burst", [&](bench_driver& d) {
+            d.type(typed_code, typing_interval);
+            d.wait_for_highlight(10s);
+        }));
+
+        std::string large_file = generate_source(opts.large_file_lines);
+        report.scenarios.push_back(run_scenario(driver, "paste_large_file", [&](bench_driver& d) {
+            d.paste(large_file);
+            d.wait_for_highlight(60s);
+        }));
+
+        report.scenarios.push_back(run_scenario(driver, "typing_in_large_file", [&](bench_driver& d) {
+            d.type(typed_code, typing_interval);
+            d.wait_for_highlight(30s);
+        }));
+
+        report.scenarios.push_back(run_scenario(driver, "mass_delete", [&](bench_driver& d) {
+            d.select_all();
+            d.press(ImGuiKey_Delete);
+            d.wait_for_highlight(30s);
+        }));
+
+        report.telemetry = lsptypes::to_json(driver.server().telemetry());
+    } catch (const std::exception& e) {
+        std::cerr << "benchmark failed: " << e.what() << '\n';
+        return 1;
+    }
+
+    if (opts.output.empty()) {
+        bench::write_json(std::cout, report);
+    } else {
+        std::ofstream out(opts.output);
+        bench::write_json(out, report);
+        if (!out) {
+            std::cerr << "could not write " << opts.output << '\n';
+            return 1;
+        }
+    }
+    return 0;
+}
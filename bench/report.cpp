@@ -0,0 +1,76 @@
+#include "report.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+
+namespace {
+    // nearest-rank percentile of sorted values
+    double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        auto rank = static_cast<std::size_t>(std::ceil(p / 100 * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    void write_string(std::ostream& out, std::string_view str) {
+        out << '"';
+        for (char c : str) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                constexpr std::string_view hex = "0123456789abcdef";
+                out << "\\u00" << hex[static_cast<unsigned char>(c) >> 4] << hex[static_cast<unsigned char>(c) & 0xf];
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+
+    void write_distribution(std::ostream& out, std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        out << "{\"count\":" << values.size()
+            << ",\"p50\":" << percentile(values, 50)
+            << ",\"p90\":" << percentile(values, 90)
+            << ",\"p99\":" << percentile(values, 99)
+            << ",\"max\":" << (values.empty() ? 0 : values.back())
+            << '}';
+    }
+}
+
+void bench::write_json(std::ostream& out, const run_report& report) {
+    out << "{\"server\":";
+    write_string(out, report.server);
+    out << ",\"frame_period_us\":" << report.frame_period.count();
+    out << ",\"server_ready_ms\":" << report.server_ready_ms;
+    out << ",\"scenarios\":[";
+
+    bool first = true;
+    for (const scenario_report& scenario : report.scenarios) {
+        if (!first) {
+            out << ',';
+        }
+        first = false;
+
+        out << "\n  {\"name\":";
+        write_string(out, scenario.name);
+        out << ",\"duration_ms\":" << scenario.duration_ms;
+        out << ",\"timeouts\":" << scenario.measures.timeouts;
+        out << ",\"edit_to_highlight_ms\":";
+        write_distribution(out, scenario.measures.edit_to_highlight_ms);
+        out << ",\"frame_time_ms\":";
+        write_distribution(out, scenario.measures.frame_time_ms);
+        out << ",\"bytes_sent\":" << scenario.bytes_sent;
+        out << ",\"bytes_received\":" << scenario.bytes_received;
+        out << ",\"allocations\":" << scenario.allocated.count;
+        out << ",\"allocated_bytes\":" << scenario.allocated.bytes;
+        out << '}';
+    }
+    out << "\n]";
+    if (!report.telemetry.empty()) {
+        out << ",\"telemetry\":" << report.telemetry;
+    }
+    out << "}\n";
+}
@@ -0,0 +1,36 @@
+#ifndef IMEDIT_LS_BENCH_REPORT_H
+#define IMEDIT_LS_BENCH_REPORT_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "alloc_counter.h"
+#include "bench_driver.h"
+
+namespace bench {
+    struct scenario_report {
+        std::string name{};
+        double duration_ms{};
+        samples measures{};
+        std::uint64_t bytes_sent{};
+        std::uint64_t bytes_received{};
+        allocation_counts allocated{};
+    };
+
+    struct run_report {
+        std::string server{};
+        std::chrono::microseconds frame_period{};
+        double server_ready_ms{};
+        std::vector<scenario_report> scenarios{};
+        std::string telemetry{}; // JSON, client telemetry over the whole run
+    };
+
+    // Writes the report as a single JSON object
+    void write_json(std::ostream& out, const run_report& report);
+}
+
+
+#endif //IMEDIT_LS_BENCH_REPORT_H
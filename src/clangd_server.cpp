@@ -1,79 +1,330 @@
 #include "clangd_server.h"
+#include "document_messages.h"
+#include "editor_text.h"
 #include "lsp/error.h"
 
 #include <imedit/editor.h>
 
 #include <lsp/messages.h>
 
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
+#include <utility>
+#include <variant>
 
 namespace {
-    template <typename PrintableT>
-    void print_val(PrintableT&& v, const char* name, unsigned int indent) {
-        while (indent--) {
-            std::cout << "  ";
+    // documents shown this recently are opened, and kept open even past the budgets
+    constexpr auto recently_visible = std::chrono::seconds{1};
+
+    bool is_word_glyph(const ImEdit::glyph& glyph) noexcept {
+        if (glyph.cp.size() != 1) {
+            return !glyph.cp.empty();
+        }
+        char c = glyph.cp[0];
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    lsptypes::completion_item to_completion_item(const lsp::CompletionItem& item) {
+        lsptypes::completion_item converted;
+        converted.label = item.label;
+        converted.filter_text = item.filterText.value_or(item.label);
+        converted.sort_text = item.sortText.value_or(item.label);
+        converted.detail = item.detail.value_or("");
+        if (item.textEdit) {
+            std::visit([&converted](auto&& edit) {
+                converted.insert_text = edit.newText;
+            }, *item.textEdit);
+        } else {
+            converted.insert_text = item.insertText.value_or(item.label);
+        }
+        if (item.documentation) {
+            std::visit([&converted](auto&& documentation) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(documentation)>, std::string>) {
+                    converted.documentation = documentation;
+                } else {
+                    converted.documentation = documentation.value;
+                }
+            }, *item.documentation);
+        }
+        if (item.kind) {
+            converted.kind = static_cast<int>(*item.kind);
         }
-        std::cout << name << ": " << v << '\n';
+        return converted;
     }
 
-    template <typename PrintableT>
-    void print_val(const std::vector<PrintableT>& vect, const char* name, unsigned int indent) {
-        while (indent--) {
-            std::cout << "  ";
+    // symbol under the glyph at character, or the glyph itself if not part of a word
+    lsptypes::symbol_range symbol_range_at(const ImEdit::line& line, unsigned int line_idx, unsigned int character) {
+        const auto size = static_cast<unsigned int>(line.size());
+        character = std::min(character, size);
+        lsptypes::symbol_range range{.line = line_idx, .first = character, .last = character};
+        while (range.first > 0 && is_word_glyph(line[range.first - 1])) {
+            --range.first;
+        }
+        while (range.last < size && is_word_glyph(line[range.last])) {
+            ++range.last;
+        }
+        if (range.first == range.last && range.last < size) {
+            ++range.last;
+        }
+        return range;
+    }
+
+    template <typename T>
+    struct is_vector : std::false_type {};
+    template <typename T>
+    struct is_vector<std::vector<T>> : std::true_type {};
+
+    template <typename T>
+    struct is_optional : std::false_type {};
+    template <typename T>
+    struct is_optional<std::optional<T>> : std::true_type {};
+
+    template <typename T>
+    struct is_variant : std::false_type {};
+    template <typename... Ts>
+    struct is_variant<std::variant<Ts...>> : std::true_type {};
+
+    template <typename UriT>
+    std::string uri_string(const UriT& uri) {
+        if constexpr (std::is_convertible_v<const UriT&, std::string>) {
+            return uri;
+        } else {
+            return std::string{uri.toString()};
         }
-        std::cout << name << ": ";
-        for (const PrintableT& p : vect) {
-            std::cout << '\'' << p << "' ";
+    }
+
+    // uri of the document as the framework would send it, for the messages we write ourselves
+    std::string wire_uri(const managed_document& document) {
+        return uri_string(decltype(lsp::TextDocumentItem::uri){document.uri});
+    }
+
+    template <typename UriT, typename RangeT>
+    lsptypes::location to_location(const UriT& uri, const RangeT& range) {
+        return {
+                .uri = uri_string(uri),
+                .start = {.line = range.start.line, .character = range.start.character},
+                .end = {.line = range.end.line, .character = range.end.character}
+        };
+    }
+
+    // Walks the answer to any of the symbol queries, whose shapes are a mix of variants, vectors and optionals of
+    // locations, location links, markup and signatures
+    template <typename T>
+    void collect_answer(const T& value, lsptypes::symbol_answer& answer) {
+        if constexpr (std::is_same_v<T, std::nullptr_t>) {
+            // nothing there
+        } else if constexpr (is_variant<T>::value) {
+            std::visit([&answer](const auto& alternative) {
+                collect_answer(alternative, answer);
+            }, value);
+        } else if constexpr (is_optional<T>::value) {
+            if (value) {
+                collect_answer(*value, answer);
+            }
+        } else if constexpr (is_vector<T>::value) {
+            for (const auto& element : value) {
+                collect_answer(element, answer);
+            }
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            if (!answer.text.empty()) {
+                answer.text += "\n\n";
+            }
+            answer.text += std::string_view{value};
+        } else if constexpr (requires { value.targetUri; value.targetSelectionRange; }) {
+            answer.locations.push_back(to_location(value.targetUri, value.targetSelectionRange));
+        } else if constexpr (requires { value.uri; value.range; }) {
+            answer.locations.push_back(to_location(value.uri, value.range));
+        } else if constexpr (requires { value.contents; }) {
+            // hover
+            collect_answer(value.contents, answer);
+        } else if constexpr (requires { value.signatures; }) {
+            // signature help, the active signature only
+            if (value.signatures.empty()) {
+                return;
+            }
+            std::size_t active = 0;
+            if (value.activeSignature) {
+                active = std::min(static_cast<std::size_t>(*value.activeSignature), value.signatures.size() - 1);
+            }
+            collect_answer(value.signatures[active].label, answer);
+            collect_answer(value.signatures[active].documentation, answer);
+        } else if constexpr (requires { value.value; }) {
+            // markup content, or a marked string with its language
+            collect_answer(value.value, answer);
         }
-        std::cout << '\n';
     }
 }
 
-clangd_server::clangd_server(const std::filesystem::path &path_to_language_server)
+clangd_server::clangd_server(const std::filesystem::path &path_to_language_server, lsptypes::server_options options)
+    : _server_path{path_to_language_server}
+    , _symbols{options.symbol_cache_size}
+    , _semantic_interceptor{[this](const std::string& id, lsptypes::semantic_tokens_payload payload) {
+        std::shared_ptr<document_tokens> tokens;
+        {
+            std::lock_guard lock(_token_routes_mutex);
+            auto it = _token_routes.find(id);
+            if (it == _token_routes.end()) {
+                return;
+            }
+            tokens = std::move(it->second);
+            _token_routes.erase(it);
+        }
+
+        if (auto batch = tokens->worker.process(id, std::move(payload)) ; batch) {
+            push_result(lsptypes::tokens_result{.document = tokens->document_id, .id = id, .batch = std::move(*batch)});
+        }
+    }}
+    , _options{options}
 {
     if (!std::filesystem::is_regular_file(path_to_language_server) || access(path_to_language_server.c_str(), X_OK) != F_OK) {
         throw std::runtime_error("\"" + path_to_language_server.generic_string() + "\" is not an executable file");
     }
 
-    if (pipe(_parent_to_child_fd) == -1) {
+    // a server dying while we write to it must not take the editor down with it: writes fail with EPIPE instead
+    struct sigaction sigpipe_action{};
+    if (sigaction(SIGPIPE, nullptr, &sigpipe_action) == 0 && sigpipe_action.sa_handler == SIG_DFL) {
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    _wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (_wakeup_fd == -1) {
+        throw std::runtime_error("Failed to create the wakeup eventfd");
+    }
+
+    try {
+        start_server();
+    } catch (...) {
+        close(_wakeup_fd);
+        throw;
+    }
+}
+
+clangd_server::~clangd_server() {
+    // a server being stopped was already asked to shut down
+    stop_server(clock::now() + _options.shutdown_timeout, _state != lsptypes::server_state::stopping);
+    close(_wakeup_fd);
+}
+
+void clangd_server::start_server() {
+    if (!_options.traffic_recording.empty() && !_recorder) {
+        _recorder = std::make_unique<traffic_recorder>(_options.traffic_recording);
+    }
+
+    if (pipe2(_parent_to_child_fd, O_CLOEXEC) == -1) {
         throw std::runtime_error("Failed to init Client > Server pipes");
     }
 
-    if (pipe(_child_to_parent_fd) == -1) {
-        close(_parent_to_child_fd[0]);
-        close(_parent_to_child_fd[1]);
+    if (pipe2(_child_to_parent_fd, O_CLOEXEC) == -1) {
+        close_pipes();
         throw std::runtime_error("Failed to init Server > Client pipes");
     }
 
-    pid_t pid = fork();
-    if (pid == -1) {
+    // needs non const char * for posix_spawn
+    std::string path_str = _server_path.generic_string();
+    std::vector<char*> args{path_str.data()};
+    for (std::string& arg : _options.server_arguments) {
+        args.push_back(arg.data());
+    }
+    args.push_back(nullptr);
+    char* environment[] = {nullptr};
+
+    // dup2 clears close-on-exec on the server's ends, every other descriptor of ours is closed on exec
+    posix_spawn_file_actions_t file_actions;
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_adddup2(&file_actions, _parent_to_child_fd[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, _child_to_parent_fd[1], STDOUT_FILENO);
+
+    // we ignore SIGPIPE, the server should not inherit that
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &default_signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+    // unlike fork, posix_spawn does not copy our page tables, which can be large
+    int error = posix_spawn(&_server_pid, path_str.c_str(), &file_actions, &attributes, args.data(), environment);
+    posix_spawn_file_actions_destroy(&file_actions);
+    posix_spawnattr_destroy(&attributes);
+    if (error != 0) {
+        _server_pid = -1;
         close_pipes();
-        throw std::runtime_error("Failed to fork process");
+        throw std::runtime_error("Failed to spawn the language server: " + std::to_string(error));
     }
 
-    if (pid == 0) {
-        dup2(_parent_to_child_fd[0], STDIN_FILENO);
-        dup2(_child_to_parent_fd[1], STDOUT_FILENO);
-        std::string arg1_str = "-offset-encoding=utf-8"; // needs non const char * for execve
-        std::string arg0_str = path_to_language_server.generic_string();
-        char* const args[] = {arg0_str.data(), arg1_str.data(), nullptr};
-        execve(path_to_language_server.c_str(), args, nullptr);
+    // without our copy of the server's ends, its exit closes the pipe
+    close(_parent_to_child_fd[0]);
+    close(_child_to_parent_fd[1]);
+    _parent_to_child_fd[0] = -1;
+    _child_to_parent_fd[1] = -1;
+
+    _input_buffer.emplace(_child_to_parent_fd[0]);
+    _output_buffer.emplace(_parent_to_child_fd[1]);
+    if (_recorder) {
+        _recorder->record(lsptypes::record_kind::session_start, {});
+        _input_buffer->set_recorder(_recorder.get());
+        _output_buffer->set_recorder(_recorder.get());
     }
 
-    _input_filebuf = {_child_to_parent_fd[0], std::ios_base::in};
-    _output_filebuf = {_parent_to_child_fd[1], std::ios_base::out};
+    _input_buffer->set_message_filter([this](std::string_view body) {
+        auto received_at = lsp_telemetry::clock::now();
+        if (auto response = lsptypes::scan_response(body) ; response) {
+            _telemetry.response_received(response->id, response->is_error, received_at);
+        }
 
-    _input_stream.emplace(&_input_filebuf);
-    _output_stream.emplace(&_output_filebuf);
+        auto replacement = _semantic_interceptor.intercept(body);
+        if (replacement) {
+            // decoded, merged into the cache and turned into a token store
+            _telemetry.tokens_decoded(lsp_telemetry::clock::now() - received_at);
+        }
+        return replacement;
+    });
+    _output_buffer->set_request_observer([this](std::string_view id, std::string_view method) {
+        _telemetry.request_sent(id, method, lsp_telemetry::clock::now());
+        if (_sending_tokens_of) {
+            std::lock_guard lock(_token_routes_mutex);
+            _token_routes.emplace(id, _sending_tokens_of);
+        }
+        _semantic_interceptor.request_sent(id, method);
+    });
+
+    _input_stream.emplace(&*_input_buffer);
+    _output_stream.emplace(&*_output_buffer);
 
     _connection.emplace(*_input_stream, *_output_stream);
     _msg_handler.emplace(*_connection);
+    _msg_handler->requestHandler().add<lsp::notifications::TextDocument_PublishDiagnostics>(
+            [this](lsp::notifications::TextDocument_PublishDiagnostics::Params&& params) {
+                receive_diagnostics(std::move(params));
+            });
 
+    // what the previous server's reader pushed after the last poll is about requests of that server
+    while (_results.try_pop()) {
+    }
+    _running = true;
+    _connection_closed = false;
+    _stop_requested = false;
+    _last_shown = clock::now();
     _incomming_message_processing_thread.emplace([this](){ process_messages(); });
 
-    auto future_result = _msg_handler->messageDispatcher().sendRequest<lsp::requests::Initialize>(
+    // answered whenever the server is up: the editor is usable meanwhile, see poll_startup
+    _lsp_conf = {};
+    _state = lsptypes::server_state::initializing;
+    _startup_deadline = clock::now() + _options.startup_timeout;
+    _initialize_answer = _msg_handler->messageDispatcher().sendRequest<lsp::requests::Initialize>(
             lsp::requests::Initialize::Params{
                     lsp::_InitializeParams{
                             .workDoneToken = {},
@@ -81,7 +332,12 @@ clangd_server::clangd_server(const std::filesystem::path &path_to_language_serve
                             .rootUri = nullptr,
                             .capabilities = {
                                     .workspace = {},
-                                    .textDocument = {},
+                                    .textDocument = lsp::TextDocumentClientCapabilities{
+                                            // so that diagnostics about outdated versions can be told apart
+                                            .publishDiagnostics = lsp::PublishDiagnosticsClientCapabilities{
+                                                    .versionSupport = true
+                                            }
+                                    },
                                     .notebookDocument = {},
                                     .window = {},
                                     .general = lsp::GeneralClientCapabilities{
@@ -103,7 +359,7 @@ clangd_server::clangd_server(const std::filesystem::path &path_to_language_serve
                                     .version = "0.1"
                             },
                             .locale = {},
-                            .rootPath = std::string("/tmp"),
+                            .rootPath = _options.workspace_root,
                             .initializationOptions = {},
                             .trace = lsp::TraceValues::Verbose
                     },
@@ -113,119 +369,441 @@ clangd_server::clangd_server(const std::filesystem::path &path_to_language_serve
 
             }
     );
-
-    process_initialize_answer(future_result.get());
-
-    _msg_handler->messageDispatcher().sendNotification<lsp::notifications::TextDocument_DidOpen>(
-            lsp::notifications::TextDocument_DidOpen::Params{
-                .textDocument = {
-                        .uri = {
-                                "/tmp/test.cpp"
-                        },
-                        .languageId = "cpp",
-                        .version = _document_version++,
-                        .text = ""
-                }
-            }
-    );
-
 }
 
-clangd_server::~clangd_server() {
-    auto request = _msg_handler->messageDispatcher().sendRequest<lsp::requests::Shutdown>();
-    request.wait();
+void clangd_server::stop_server(clock::time_point deadline, bool graceful) {
+    if (!_msg_handler) {
+        return;
+    }
+    _stop_requested = true;
+
+    // writing to a server that is gone would be pointless
+    if (graceful && !_connection_closed) {
+        auto request = _msg_handler->messageDispatcher().sendRequest<lsp::requests::Shutdown>();
+        if (request.wait_until(deadline) == std::future_status::ready) {
+            _msg_handler->messageDispatcher().sendNotification<lsp::notifications::Exit>();
+        }
+    }
+    reap_server(deadline);
 
+    // the server is gone, so the reader can't be stuck in the middle of a message
     _running = false;
+    wake_message_processing();
     _incomming_message_processing_thread->join();
+    _incomming_message_processing_thread.reset();
+    {
+        std::lock_guard lock(_awaited_answers_mutex);
+        _awaited_answers.clear();
+    }
+
+    // the requests still pending fail with a broken promise when the handler goes away
+    _bytes_sent_before += _output_buffer->bytes_written();
+    _bytes_received_before += _input_buffer->bytes_read();
+    _msg_handler.reset();
+    _connection.reset();
+    _output_stream.reset();
+    _input_stream.reset();
+    _output_buffer.reset();
+    _input_buffer.reset();
     close_pipes();
 }
 
-void clangd_server::process_messages() {
-    while (_running) {
-        _msg_handler->processIncomingMessages();
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
+void clangd_server::reap_server(clock::time_point deadline) {
+    if (_server_pid == -1) {
+        return;
+    }
+
+    while (waitpid(_server_pid, nullptr, WNOHANG) == 0) {
+        if (clock::now() >= deadline) {
+            kill(_server_pid, SIGKILL);
+            waitpid(_server_pid, nullptr, 0);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
     }
+    _server_pid = -1;
 }
 
-void clangd_server::close_pipes() {
-    close(_parent_to_child_fd[0]);
-    close(_parent_to_child_fd[1]);
-    close(_child_to_parent_fd[0]);
-    close(_child_to_parent_fd[1]);
+void clangd_server::supervise() {
+    if (_state != lsptypes::server_state::initializing && _state != lsptypes::server_state::ready) {
+        return;
+    }
+
+    auto now = clock::now();
+    if (_options.idle_timeout.count() != 0 && now - _last_shown >= _options.idle_timeout) {
+        stop();
+        return;
+    }
+
+    const char* reason = nullptr;
+    if (_server_pid != -1 && waitpid(_server_pid, nullptr, WNOHANG) == _server_pid) {
+        _server_pid = -1;
+        reason = "exited";
+    } else if (_connection_closed) {
+        reason = "closed its output";
+    } else if (_state == lsptypes::server_state::initializing && now >= _startup_deadline) {
+        reason = "did not answer initialize in time";
+    } else if (_state == lsptypes::server_state::ready && is_stalled(now)) {
+        reason = "stopped answering";
+    }
+
+    if (reason != nullptr) {
+        std::cerr << "the language server " << reason << ", restarting it\n";
+        restart_server(now);
+    }
 }
 
-void clangd_server::process_initialize_answer(const lsp::InitializeResult & result) {
-    std::cout << std::boolalpha;
-    if (result.serverInfo) {
-        std::cout << "server info:\n";
-        print_val(result.serverInfo->name, "name", 1);
-        if (result.serverInfo->version) {
-            print_val(result.serverInfo->version.value(), "value", 1);
+bool clangd_server::is_stalled(clock::time_point now) {
+    // stalled once requests are waiting, and nothing at all came from the server for response_timeout
+    std::uint64_t received = bytes_received();
+    if (pending_token_request_count() == 0 || received != _watchdog.bytes_received) {
+        _watchdog.bytes_received = received;
+        _watchdog.last_progress = now;
+        return false;
+    }
+    return now - _watchdog.last_progress >= _options.response_timeout;
+}
+
+void clangd_server::restart_server(clock::time_point now) {
+    std::erase_if(_restart_times, [this, now](clock::time_point restart) {
+        return now - restart >= _options.restart_window;
+    });
+
+    // the server is dead or hung: no point in asking it to shut down
+    stop_server(now, false);
+
+    reset_documents(false);
+    _telemetry.server_restarted();
+
+    if (_restart_times.size() >= _options.max_restarts) {
+        std::cerr << "the language server was restarted " << _restart_times.size() << " times in a row, giving up\n";
+        _state = lsptypes::server_state::failed;
+        return;
+    }
+    _restart_times.push_back(now);
+
+    _state = lsptypes::server_state::spawning;
+    try {
+        start_server();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        _state = lsptypes::server_state::failed;
+    }
+}
+
+void clangd_server::stop() {
+    // a server that refused to initialize is still running
+    const bool running = _state == lsptypes::server_state::initializing || _state == lsptypes::server_state::ready
+                         || (_state == lsptypes::server_state::failed && _msg_handler);
+    if (!running) {
+        return;
+    }
+
+    _stop_requested = true;
+    // the documents are opened again if the server is started again, their mirrors are not worth keeping
+    reset_documents(true);
+    _shutdown_answer = _msg_handler->messageDispatcher().sendRequest<lsp::requests::Shutdown>();
+    _stop_deadline = clock::now() + _options.shutdown_timeout;
+    _exit_sent = false;
+    _state = lsptypes::server_state::stopping;
+}
+
+void clangd_server::poll_shutdown() {
+    if (_state != lsptypes::server_state::stopping) {
+        return;
+    }
+
+    // polled every frame rather than waited for, other servers and the editor go on meanwhile
+    auto now = clock::now();
+    if (!_exit_sent) {
+        if (!_connection_closed && now < _stop_deadline
+            && _shutdown_answer.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+            return;
+        }
+        if (!_connection_closed) {
+            _msg_handler->messageDispatcher().sendNotification<lsp::notifications::Exit>();
         }
+        _exit_sent = true;
     }
-    std::cout << "capabilities:\n";
-    if (result.capabilities.positionEncoding) {
-        print_val(result.capabilities.positionEncoding.value().value(), "position_encoding", 1);
-        if (*result.capabilities.positionEncoding == lsp::PositionEncodingKind::ValueIndex::UTF8) {
-            _lsp_conf.position_encoding = lsptypes::encoding::utf8;
+
+    if (_server_pid != -1 && now < _stop_deadline) {
+        if (waitpid(_server_pid, nullptr, WNOHANG) == 0) {
+            return;
         }
+        _server_pid = -1;
+    }
+
+    // killed if still there
+    stop_server(now, false);
+    _state = lsptypes::server_state::stopped;
+}
+
+void clangd_server::reset_documents(bool drop_mirrors) {
+    _documents.for_each([drop_mirrors](managed_document& document) {
+        // opened again with its current text and version the next time it is visible
+        document.is_open = false;
+        document.pending_token_requests.clear();
+        document.token_update_deferred = false;
+        document.requested_lines = {};
+        document.tokens->worker.reset();
+        document.diagnostics.reset();
+        if (drop_mirrors) {
+            document.text.assign({});
+            document.mirror_valid = false;
+        }
+    });
+    _early_results.clear();
+    {
+        std::lock_guard lock(_token_routes_mutex);
+        _token_routes.clear();
+    }
+    _semantic_interceptor.reset();
+    {
+        std::lock_guard lock(_document_routes_mutex);
+        _document_routes.clear();
+    }
+    // the requests were sent to the previous server
+    _completion = {};
+    _completions.clear();
+    _symbol_requests.clear();
+    _symbols.clear();
+}
+
+void clangd_server::process_messages() {
+    std::array<pollfd, 2> fds{{
+        {.fd = _child_to_parent_fd[0], .events = POLLIN, .revents = 0},
+        {.fd = _wakeup_fd, .events = POLLIN, .revents = 0}
+    }};
+
+    try {
+        while (_running) {
+            // messages already buffered do not make the pipe readable
+            while (_running && _input_buffer->has_buffered_message()) {
+                _msg_handler->processIncomingMessages();
+            }
+            // whatever came is waiting for the next poll, answers awaited as results
+            collect_answers();
+            notify_message_listener();
+
+            if (poll(fds.data(), fds.size(), -1) == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "poll failed on the language server pipe: " << errno << '\n';
+                _connection_closed = true;
+                return;
+            }
+
+            if ((fds[1].revents & POLLIN) != 0) {
+                std::uint64_t count;
+                [[maybe_unused]] auto ignored = read(_wakeup_fd, &count, sizeof(count));
+            }
+
+            if ((fds[0].revents & POLLIN) != 0) {
+                _msg_handler->processIncomingMessages();
+            } else if ((fds[0].revents & (POLLHUP | POLLERR)) != 0) {
+                // the server closed its output, nothing will ever come again
+                _connection_closed = true;
+                notify_message_listener();
+                return;
+            }
+        }
+    } catch (const std::exception& e) {
+        // the connection ended in the middle of a message
+        if (_running) {
+            std::cerr << "lost the connection to the language server: " << e.what() << '\n';
+        }
+        _connection_closed = true;
+        notify_message_listener();
+    }
+}
+
+void clangd_server::notify_message_listener() const {
+    if (_options.message_listener && _running) {
+        _options.message_listener();
+    }
+}
+
+clangd_server::clock::time_point clangd_server::next_poll() const {
+    auto next = clock::time_point::max();
+    auto at_the_latest = [&next](clock::time_point deadline) {
+        next = std::min(next, deadline);
+    };
+
+    switch (_state) {
+        case lsptypes::server_state::initializing:
+            at_the_latest(_startup_deadline);
+            break;
+        case lsptypes::server_state::stopping:
+            // the server exiting closes its output, which wakes the listener up
+            at_the_latest(_stop_deadline);
+            return next;
+        case lsptypes::server_state::ready:
+            break;
+        default:
+            return next;
+    }
+
+    if (_options.idle_timeout.count() != 0) {
+        at_the_latest(_last_shown + _options.idle_timeout);
+    }
+    if (pending_token_request_count() != 0) {
+        at_the_latest(_watchdog.last_progress + _options.response_timeout);
+    }
+    _documents.for_each([this, &at_the_latest](const managed_document& document) {
+        if (auto flush = document.scheduler.flush_deadline() ; flush) {
+            at_the_latest(*flush);
+        }
+        if (document.cursor && !document.cursor_prefetched && !document.large_file && _options.prefetch_delay.count() != 0) {
+            at_the_latest(document.cursor_moved + _options.prefetch_delay);
+        }
+        if (document.tokens_to_apply) {
+            // right away, the next frame applies some more
+            at_the_latest(clock::now());
+        }
+    });
+    return next;
+}
+
+lsptypes::telemetry_snapshot clangd_server::telemetry() const noexcept {
+    lsptypes::telemetry_snapshot snapshot = _telemetry.snapshot();
+    snapshot.bytes_sent = bytes_sent();
+    snapshot.bytes_received = bytes_received();
+    return snapshot;
+}
+
+void clangd_server::wake_message_processing() const {
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto ignored = write(_wakeup_fd, &one, sizeof(one));
+}
+
+void clangd_server::close_pipes() {
+    for (int* fd : {&_parent_to_child_fd[0], &_parent_to_child_fd[1], &_child_to_parent_fd[0], &_child_to_parent_fd[1]}) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void clangd_server::poll_startup() {
+    if (_state != lsptypes::server_state::initializing
+        || _initialize_answer.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+        return;
+    }
+
+    try {
+        process_initialize_answer(_initialize_answer.get());
+    } catch (const std::exception& e) {
+        // a server refusing to initialize would only do so again if restarted
+        std::cerr << "the language server failed to initialize: " << e.what() << '\n';
+        _state = lsptypes::server_state::failed;
+        return;
+    }
+
+    _msg_handler->messageDispatcher().sendNotification<lsp::notifications::Initialized>(lsp::notifications::Initialized::Params{});
+    // documents are opened as they get shown
+    _state = lsptypes::server_state::ready;
+}
+
+void clangd_server::open_document(managed_document& document) {
+    if (!document.mirror_valid) {
+        document.text.assign(editor_lines(*document.editor));
+        document.mirror_valid = true;
+    }
+    check_large_file(document);
+
+    // whatever was edited while the document was closed is part of the opened text
+    document.pending_changes.clear();
+    document.full_sync_pending = false;
+    document.edited_lines = {0, document.text.line_count()};
+    document.requested_lines = {};
+    document.scheduler.flushed();
+    document.tokens->worker.set_token_styles(_token_styles);
+    document.tokens->worker.set_document_version(document.version);
+    document.tokens->version = document.version;
+
+    // streamed from the mirror, large documents are never copied whole
+    write_did_open(*_output_buffer, wire_uri(document), document.language_id, document.version, document.text.snapshot());
+    document.is_open = true;
+    {
+        std::lock_guard lock(_document_routes_mutex);
+        _document_routes[document.uri] = document.tokens;
+    }
+
+    if (_lsp_conf.supports_semantic_tokens) {
+        request_token_update(document);
+    }
+}
+
+void clangd_server::close_document(managed_document& document) {
+    if (_completion.document == document.id) {
+        end_completion();
+    }
+    // the server forgets about the document too
+    _symbols.forget(document.id);
+    if (document.is_open) {
+        cancel_token_requests(document, false);
+        lsp::notifications::TextDocument_DidClose::Params params;
+        params.textDocument.uri = document.uri;
+        _msg_handler->messageDispatcher().sendNotification<lsp::notifications::TextDocument_DidClose>(std::move(params));
+        document.is_open = false;
+    }
+
+    {
+        std::lock_guard lock(_document_routes_mutex);
+        _document_routes.erase(document.uri);
+    }
+    document.diagnostics.reset();
+
+    // rebuilt from the editor when the document is opened again
+    document.tokens->worker.reset();
+    document.tokens_to_apply.reset();
+    document.decorations.clear();
+    document.text.assign({});
+    document.mirror_valid = false;
+    document.pending_changes.clear();
+    document.full_sync_pending = false;
+    document.edited_lines = {};
+    document.requested_lines = {};
+    document.scheduler.flushed();
+}
+
+void clangd_server::evict_documents() {
+    auto keep_after = clock::now() - recently_visible;
+    for (managed_document* document : _documents.eviction_candidates(_options.max_open_documents, _options.open_documents_memory_budget, keep_after)) {
+        close_document(*document);
+    }
+}
+
+void clangd_server::process_initialize_answer(const lsp::InitializeResult & result) {
+    if (result.capabilities.positionEncoding
+        && *result.capabilities.positionEncoding == lsp::PositionEncodingKind::ValueIndex::UTF8) {
+        _lsp_conf.position_encoding = lsptypes::encoding::utf8;
     }
     if (result.capabilities.textDocumentSync) {
-        std::cout << "  text doc sync:\n";
         std::visit([this](auto&& v) {
             if constexpr (std::is_same_v<std::decay_t<decltype(v)>, lsp::TextDocumentSyncKind>) {
-                std::string str;
-                switch(v) {
-                    case lsp::TextDocumentSyncKind::Full:
-                        str = "Full";
-                        break;
-                    case lsp::TextDocumentSyncKind::Incremental:
-                        str = "Incremental";
-                        _lsp_conf.support_incremental_file_change = true;
-                        break;
-                    default:
-                        str = "None";
-                        break;
-                }
-                print_val(str, "text_document_sync_kind", 2);
+                _lsp_conf.support_incremental_file_change = v == lsp::TextDocumentSyncKind::Incremental;
             }
             else {
                 if (v.openClose) {
-                    print_val(v.openClose.value(), "open_close", 2);
                     _lsp_conf.support_open_close_notifications = v.openClose.value();
                 }
                 if (v.change) {
-                    std::string str;
-                    switch(v.change.value()) {
-                        case lsp::TextDocumentSyncKind::Full:
-                            str = "Full";
-                            break;
-                        case lsp::TextDocumentSyncKind::Incremental:
-                            str = "Incremental";
-                            _lsp_conf.support_incremental_file_change = true;
-                            break;
-                        default:
-                            str = "None";
-                            break;
-                    }
-                    print_val(str, "text_document_sync_kind", 2);
+                    _lsp_conf.support_incremental_file_change = v.change.value() == lsp::TextDocumentSyncKind::Incremental;
                 }
                 if (v.willSave) {
-                    print_val(v.willSave.value(), "will_save", 2);
                     _lsp_conf.support_send_will_save_notifications = v.willSave.value();
                 }
                 if (v.willSaveWaitUntil) {
-                    print_val(v.willSaveWaitUntil.value(), "will_save_wait_until", 2);
                     _lsp_conf.support_wait_will_save_request = v.willSaveWaitUntil.value();
                 }
                 if (v.save) {
-                    std::cout << "    save:\n";
                     std::visit([this](auto&& v2){
                         if constexpr (std::is_same_v<std::decay_t<decltype(v2)>, bool>) {
-                            print_val(v2, "value", 3);
                             _lsp_conf.support_save_notifications = v2;
                         } else if (v2.includeText){
-                            print_val(v2.includeText.value(), "include_text", 3);
                             _lsp_conf.support_save_notifications = true;
                             _lsp_conf.send_text_on_save = v2.includeText.value();
                         }
@@ -236,28 +814,15 @@ void clangd_server::process_initialize_answer(const lsp::InitializeResult & resu
     }
 
     if (result.capabilities.completionProvider) {
-        std::cout << "  completion provider:\n";
         const lsp::CompletionOptions& completion = result.capabilities.completionProvider.value();
-        if (completion.workDoneProgress) {
-            print_val(completion.workDoneProgress.value(), "work done progress?", 2);
-        }
         if (completion.triggerCharacters) {
             _lsp_conf.completion_option_trigger_characters = *completion.triggerCharacters;
-            print_val(completion.triggerCharacters.value(), "trigger characters", 2);
-        }
-        if (completion.allCommitCharacters) {
-            print_val(completion.allCommitCharacters.value(), "all commit characters", 2);
         }
         if (completion.resolveProvider) {
             _lsp_conf.is_completion_resolve_provider = *completion.resolveProvider;
-            print_val(completion.resolveProvider.value(), "resolve provider", 2);
-        }
-        if (completion.completionItem && completion.completionItem->labelDetailsSupport) {
-            print_val(completion.completionItem->labelDetailsSupport.value(), "label details support", 2);
         }
     }
 
-    // TODO prints?
     if (result.capabilities.hoverProvider) {
         std::visit([this](auto&& val) {
             if constexpr (std::is_same_v<std::decay_t<decltype(val)>, bool>) {
@@ -327,65 +892,32 @@ void clangd_server::process_initialize_answer(const lsp::InitializeResult & resu
             _lsp_conf.supports_semantic_tokens = true;
             _lsp_conf.token_modifiers = val.legend.tokenModifiers;
             _lsp_conf.token_types = val.legend.tokenTypes;
+            if (val.range) {
+                std::visit([this](auto&& range) {
+                    if constexpr (std::is_same_v<std::decay_t<decltype(range)>, bool>) {
+                        _lsp_conf.supports_semantic_tokens_range = range;
+                    } else {
+                        _lsp_conf.supports_semantic_tokens_range = true;
+                    }
+                }, val.range.value());
+            }
+            if (val.full) {
+                std::visit([this](auto&& full) {
+                    if constexpr (!std::is_same_v<std::decay_t<decltype(full)>, bool>) {
+                        _lsp_conf.supports_semantic_tokens_delta = full.delta.value_or(false);
+                    }
+                }, val.full.value());
+            }
         }, result.capabilities.semanticTokensProvider.value());
     }
 
-
-
-
-    std::unordered_map<std::string, ImEdit::token_type::enum_> str_to_tok_table;
-
-    str_to_tok_table["variable"] = ImEdit::token_type::variable;
-    str_to_tok_table["parameter"] = ImEdit::token_type::function;
-    str_to_tok_table["function"] = ImEdit::token_type::function;
-    str_to_tok_table["method"] = ImEdit::token_type::variable;
-    str_to_tok_table["function"] = ImEdit::token_type::type;
-    str_to_tok_table["property"] = ImEdit::token_type::unknown;
-    str_to_tok_table["class"] = ImEdit::token_type::type;
-    str_to_tok_table["interface"] = ImEdit::token_type::type;
-    str_to_tok_table["enum"] = ImEdit::token_type::type;
-    str_to_tok_table["enumMember"] = ImEdit::token_type::constant;
-    str_to_tok_table["type"] = ImEdit::token_type::type;
-    str_to_tok_table["unknown"] = ImEdit::token_type::unknown;
-    str_to_tok_table["namespace"] = ImEdit::token_type::unknown;
-    str_to_tok_table["typeParameter"] = ImEdit::token_type::type;
-    str_to_tok_table["concept"] = ImEdit::token_type::type;
-    str_to_tok_table["macro"] = ImEdit::token_type::preprocessor;
-    str_to_tok_table["modifier"] = ImEdit::token_type::unknown;
-    str_to_tok_table["operator"] = ImEdit::token_type::operators;
-    str_to_tok_table["bracket"] = ImEdit::token_type::opening;
-    str_to_tok_table["label"] = ImEdit::token_type::type;
-    str_to_tok_table["comment"] = ImEdit::token_type::comment;
-    str_to_tok_table["struct"] = ImEdit::token_type::type;
-    str_to_tok_table["enum"] = ImEdit::token_type::type;
-    str_to_tok_table["interface"] = ImEdit::token_type::type;
-    str_to_tok_table["typeParameter"] = ImEdit::token_type::type;
-    str_to_tok_table["parameter"] = ImEdit::token_type::variable;
-    str_to_tok_table["variable"] = ImEdit::token_type::variable;
-    str_to_tok_table["property"] = ImEdit::token_type::variable;
-    str_to_tok_table["event"] = ImEdit::token_type::unknown;
-    str_to_tok_table["function"] = ImEdit::token_type::function;
-    str_to_tok_table["method"] = ImEdit::token_type::function;
-    str_to_tok_table["macro"] = ImEdit::token_type::preprocessor;
-    str_to_tok_table["keyword"] = ImEdit::token_type::keyword;
-    str_to_tok_table["modifier"] = ImEdit::token_type::keyword;
-    str_to_tok_table["comment"] = ImEdit::token_type::comment;
-    str_to_tok_table["string"] = ImEdit::token_type::string_literal;
-    str_to_tok_table["number"] = ImEdit::token_type::num_literal;
-    str_to_tok_table["regexp"] = ImEdit::token_type::unknown;
-    str_to_tok_table["operator"] = ImEdit::token_type::operator_;
-    str_to_tok_table["decorator"] = ImEdit::token_type::keyword;
-
-
-    for (const std::string& token_type : _lsp_conf.token_types) {
-        _token_type_jump_table.emplace_back(str_to_tok_table.at(token_type));
-    }
-
-    std::cout << std::boolalpha;
+    // legend entries we know nothing about are left unstyled
+    _token_styles = std::make_shared<const token_style_table>(_lsp_conf.token_types, _lsp_conf.token_modifiers);
 }
 
-void clangd_server::setup_editor(ImEdit::editor &ed) {
-
+void clangd_server::add_editor(ImEdit::editor &ed, std::string uri, std::string language_id) {
+    remove_editor(ed);
+    check_large_file(_documents.add(ed, std::move(uri), std::move(language_id), edit_scheduler{_options.edit_debounce, _options.edit_max_delay}));
 
     ed._on_data_modified_data = this;
     ed._on_data_modified_new_line = [](std::any lsp, unsigned int new_line_idx, ImEdit::editor& e){
@@ -402,30 +934,237 @@ void clangd_server::setup_editor(ImEdit::editor &ed) {
     };
 }
 
-void clangd_server::line_changed(ImEdit::editor &ed, unsigned int, const ImEdit::line&) {
-    request_token_update(ed);
+void clangd_server::remove_editor(ImEdit::editor &ed) {
+    if (managed_document* document = _documents.find(ed) ; document != nullptr) {
+        close_document(*document);
+        // answers still on their way are dropped, see process_result
+        _documents.remove(ed);
+    }
+}
+
+void clangd_server::setup_editor(ImEdit::editor &ed) {
+    add_editor(ed, "/tmp/test.cpp");
+}
+
+void clangd_server::visible_diagnostics(const ImEdit::editor& editor, lsptypes::line_range lines, std::vector<lsptypes::diagnostic_mark>& marks) const {
+    marks.clear();
+    const managed_document* document = _documents.find(editor);
+    if (document == nullptr || !document->diagnostics) {
+        return;
+    }
+
+    // the diagnostics may be about an older version, in which the lines were elsewhere
+    lines.last = std::min(lines.last, editor_line_count(editor));
+    document->diagnostics->for_each_in(lines, [&](const lsptypes::diagnostic& diagnostic) {
+        const unsigned int first_line = std::max(diagnostic.start.line, lines.first);
+        const unsigned int last_line = std::min(diagnostic.last_line(), lines.last - 1);
+        for (unsigned int line = first_line ; line <= last_line ; ++line) {
+            const ImEdit::line& glyphs = editor._lines[line];
+            lsptypes::diagnostic_mark mark{
+                    .line = line,
+                    .first = line == diagnostic.start.line ? glyph_index(glyphs, diagnostic.start.character, _lsp_conf.position_encoding) : 0,
+                    .last = line == diagnostic.end.line ? glyph_index(glyphs, diagnostic.end.character, _lsp_conf.position_encoding)
+                                                        : static_cast<unsigned int>(glyphs.size()),
+                    .severity = diagnostic.severity,
+                    .source = &diagnostic
+            };
+            // empty ranges still get a glyph wide mark, past the end of the line if need be
+            mark.last = std::max(mark.last, mark.first + 1);
+            marks.push_back(mark);
+        }
+    });
+}
+
+void clangd_server::visible_decorations(const ImEdit::editor& editor, lsptypes::line_range lines, std::vector<lsptypes::decoration_mark>& marks) const {
+    marks.clear();
+    if (const managed_document* document = _documents.find(editor) ; document != nullptr) {
+        document->decorations.for_each_in(lines, [&marks](const lsptypes::decoration_mark& mark) {
+            marks.push_back(mark);
+        });
+    }
+}
+
+std::shared_ptr<const diagnostic_index> clangd_server::diagnostics(const ImEdit::editor& editor) const {
+    const managed_document* document = _documents.find(editor);
+    return document == nullptr ? nullptr : document->diagnostics;
+}
+
+int clangd_server::document_version(const ImEdit::editor& editor) const noexcept {
+    const managed_document* document = _documents.find(editor);
+    return document == nullptr ? 0 : document->version;
+}
+
+int clangd_server::highlighted_version(const ImEdit::editor& editor) const noexcept {
+    const managed_document* document = _documents.find(editor);
+    return document == nullptr ? -1 : document->highlighted_version;
+}
+
+bool clangd_server::has_pending_edits(const ImEdit::editor& editor) const noexcept {
+    const managed_document* document = _documents.find(editor);
+    return document != nullptr && document->scheduler.has_pending_edits();
+}
+
+void clangd_server::line_changed(ImEdit::editor &ed, unsigned int line_idx, const ImEdit::line&) {
+    lines_edited(ed, line_idx, 1, 1);
+}
+
+void clangd_server::region_deleted(ImEdit::editor &ed, ImEdit::region region) {
+    // the deleted region's lines have been merged into its first line
+    lines_edited(ed, region.beg.line, region.end.line - region.beg.line + 1, 1);
+}
+
+void clangd_server::newline_deleted(ImEdit::editor &ed, unsigned int old_line_idx) {
+    // old_line_idx got merged into the line preceding it
+    if (old_line_idx == 0) {
+        document_replaced(ed);
+        return;
+    }
+    lines_edited(ed, old_line_idx - 1, 2, 1);
+}
+
+void clangd_server::newline_created(ImEdit::editor &ed, unsigned int new_line_idx) {
+    // new_line_idx was split from the line preceding it
+    if (new_line_idx == 0) {
+        document_replaced(ed);
+        return;
+    }
+    lines_edited(ed, new_line_idx - 1, 1, 2);
+}
+
+void clangd_server::lines_edited(ImEdit::editor& ed, unsigned int first_line, unsigned int old_line_count, unsigned int new_line_count) {
+    managed_document* document = _documents.find(ed);
+    if (document == nullptr) {
+        return;
+    }
+
+    // answers about the other lines stay valid, they are moved along
+    _symbols.lines_replaced(document->id, document->uri, first_line, old_line_count, new_line_count);
+    // the tokens left to apply are about lines that may have moved
+    document->tokens_to_apply.reset();
+    document->decorations.lines_replaced(first_line, old_line_count, new_line_count);
+    // the semantic tokens of the edited lines are a round trip away
+    if (document->lexer) {
+        document->lexer->lines_replaced(ed, first_line, old_line_count, new_line_count, document->visible_lines);
+    }
+    if (document->mirror_valid) {
+        sync_lines(*document, first_line, old_line_count, new_line_count);
+    }
+}
+
+void clangd_server::document_replaced(ImEdit::editor& ed) {
+    managed_document* document = _documents.find(ed);
+    if (document == nullptr) {
+        return;
+    }
+
+    _symbols.forget(document->id);
+    document->tokens_to_apply.reset();
+    document->decorations.clear();
+    if (document->mirror_valid) {
+        resync_document(*document);
+    } else {
+        check_large_file(*document);
+    }
+    if (document->lexer) {
+        document->lexer->reset(ed, document->visible_lines);
+    }
 }
 
-void clangd_server::region_deleted(ImEdit::editor &ed, ImEdit::region) {
-    request_token_update(ed);
+void clangd_server::sync_lines(managed_document& document, unsigned int first_line, unsigned int old_line_count, unsigned int new_line_count) {
+    const unsigned int mirror_line_count = document.text.line_count();
+    if (first_line + old_line_count > mirror_line_count
+        || editor_line_count(*document.editor) != mirror_line_count - old_line_count + new_line_count) {
+        // the editor and our mirror disagree on what happened, start over from the editor's content
+        resync_document(document);
+        return;
+    }
+
+    auto change = document.text.replace_lines(first_line, old_line_count, editor_lines(*document.editor, first_line, new_line_count), _lsp_conf.position_encoding);
+
+    auto& edited = document.edited_lines;
+    if (!edited.empty() && edited.last > first_line + old_line_count) {
+        edited.last = edited.last + new_line_count - old_line_count;
+    }
+    edited = edited.merged_with({first_line, first_line + new_line_count});
+
+    if (_lsp_conf.support_incremental_file_change && !document.full_sync_pending) {
+        document.pending_changes.emplace_back(std::move(change));
+    } else {
+        document.full_sync_pending = true;
+    }
+    document.scheduler.edit_happened(edit_scheduler::clock::now());
+    check_large_file(document);
 }
 
-void clangd_server::newline_deleted(ImEdit::editor &ed, unsigned int) {
-    request_token_update(ed);
+void clangd_server::resync_document(managed_document& document) {
+    document.text.assign(editor_lines(*document.editor));
+    document.edited_lines = {0, document.text.line_count()};
+    document.pending_changes.clear();
+    document.full_sync_pending = true;
+    document.scheduler.edit_happened(edit_scheduler::clock::now());
+    check_large_file(document);
 }
 
-void clangd_server::newline_created(ImEdit::editor &ed, unsigned int) {
-    request_token_update(ed);
+void clangd_server::check_large_file(managed_document& document) {
+    // the size in bytes is only known once the document is mirrored
+    const unsigned int line_count = document.mirror_valid ? document.text.line_count() : editor_line_count(*document.editor);
+    const std::size_t byte_size = document.mirror_valid ? document.text.byte_size() : 0;
+    const bool large = (_options.large_file_lines != 0 && line_count >= _options.large_file_lines)
+                       || (_options.large_file_bytes != 0 && byte_size >= _options.large_file_bytes);
+    if (large == document.large_file) {
+        return;
+    }
+
+    if (large) {
+        // neither the tokens of the whole document nor the cache holding them are wanted anymore
+        cancel_token_requests(document, false);
+        document.tokens->worker.reset();
+    }
+    document.set_large_file(large);
 }
 
-void clangd_server::request_token_update(ImEdit::editor& ed) {
+void clangd_server::flush_edits(managed_document& document) {
+    if (!document.is_open) {
+        // kept in the mirror, and sent along with the document once it is opened
+        return;
+    }
 
+    document.scheduler.flushed();
+    if (!document.full_sync_pending && document.pending_changes.empty()) {
+        return;
+    }
+
+    send_pending_changes(document);
+    cancel_token_requests(document, false);
+    request_token_update(document);
+}
+
+void clangd_server::send_pending_changes(managed_document& document) {
     lsp::VersionedTextDocumentIdentifier vtdi;
-    vtdi.uri = std::string("/tmp/test.cpp");
-    vtdi.version = _document_version++;
+    vtdi.uri = document.uri;
+    vtdi.version = ++document.version;
+    document.tokens->worker.set_document_version(document.version);
+    document.tokens->version = document.version;
+
+    if (document.full_sync_pending) {
+        document.pending_changes.clear();
+        document.full_sync_pending = false;
+        write_full_did_change(*_output_buffer, wire_uri(document), document.version, document.text.snapshot());
+        return;
+    }
 
-    std::string str;
-    std::copy(ed.begin(), ed.end(), std::back_inserter(str));
+    std::vector<lsp::TextDocumentContentChangeEvent> changes;
+    changes.reserve(document.pending_changes.size());
+    for (lsptypes::text_change& change : document.pending_changes) {
+        lsp::TextDocumentContentChangeEvent_Range range_change;
+        range_change.range.start.line = change.start.line;
+        range_change.range.start.character = change.start.character;
+        range_change.range.end.line = change.end.line;
+        range_change.range.end.character = change.end.character;
+        range_change.text = std::move(change.text);
+        changes.emplace_back(std::move(range_change));
+    }
+    document.pending_changes.clear();
 
     _msg_handler->messageDispatcher().sendNotification<lsp::notifications::TextDocument_DidChange>(
         lsp::notifications::TextDocument_DidChange::Params{
@@ -433,64 +1172,733 @@ void clangd_server::request_token_update(ImEdit::editor& ed) {
                     vtdi
                 },
                 .contentChanges{
-                        lsp::TextDocumentContentChangeEvent{
-                                lsp::TextDocumentContentChangeEvent_Text{
-                                        str
-                                }
-                        }
+                        std::move(changes)
                 }
         }
     );
+}
+
+template <typename RequestT>
+void clangd_server::send_token_request(managed_document& document, typename RequestT::Params params) {
+    // picked up by the request observer, on this thread, before the request is written
+    _sending_tokens_of = document.tokens;
+    // answers come through the results queue, the futures are not needed
+    static_cast<void>(_msg_handler->messageDispatcher().sendRequest<RequestT>(std::move(params)));
+    _sending_tokens_of.reset();
+}
+
+template <typename ResultT, typename ConvertT>
+void clangd_server::await_answer(std::future<ResultT> answer, ConvertT convert) {
+    // std::function wants a copyable target
+    auto shared_answer = std::make_shared<std::future<ResultT>>(std::move(answer));
+    {
+        std::lock_guard lock(_awaited_answers_mutex);
+        _awaited_answers.emplace_back([this, shared_answer, convert = std::move(convert)] {
+            if (shared_answer->wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+                return false;
+            }
+            push_result(convert(*shared_answer));
+            return true;
+        });
+    }
+    // the answer may have been read before it was registered
+    wake_message_processing();
+}
+
+void clangd_server::request_token_update(managed_document& document) {
+    if (at_request_limit()) {
+        // sent by poll once some requests are answered
+        document.token_update_deferred = true;
+        return;
+    }
+    document.token_update_deferred = false;
+
+    document.requested_lines = {};
+    if (document.large_file) {
+        // the tokens of the whole document would take seconds to come and to apply, the others are asked for
+        // as they get shown
+        if (!document.visible_lines.empty()) {
+            request_visible_tokens(document);
+        }
+        return;
+    }
+    if (_options.viewport_first_highlighting && !document.visible_lines.empty()) {
+        request_visible_tokens(document);
+    }
+
+    std::string result_id = document.tokens->worker.result_id();
+    if (_lsp_conf.supports_semantic_tokens_delta && !result_id.empty()) {
+        lsp::requests::TextDocument_SemanticTokens_Full_Delta::Params params;
+        params.textDocument.uri = document.uri;
+        params.previousResultId = result_id;
+        send_token_request<lsp::requests::TextDocument_SemanticTokens_Full_Delta>(document, std::move(params));
+        tokens_requested(document, {
+                .type = lsptypes::tokens_request::kind::delta,
+                .version = document.version,
+                .lines = document.edited_lines,
+                .previous_result_id = std::move(result_id)
+        });
+        return;
+    }
 
-    _pending_requests_results.emplace_back(
-            _msg_handler->messageDispatcher().sendRequest<lsp::requests::TextDocument_SemanticTokens_Full>(
+    send_token_request<lsp::requests::TextDocument_SemanticTokens_Full>(document,
             lsp::requests::TextDocument_SemanticTokens_Full::Params{
                 .workDoneToken = {},
                 .partialResultToken = {},
                 .textDocument = {
-                        .uri = std::string("/tmp/test.cpp")
+                        .uri = document.uri
                 }
-            })
-    );
+            });
+    tokens_requested(document, {
+            .type = lsptypes::tokens_request::kind::full,
+            .version = document.version,
+            .lines = document.edited_lines
+    });
 }
 
-void clangd_server::update(ImEdit::editor &editor) {
-    for (auto it = _pending_requests_results.begin() ; it != _pending_requests_results.end() ;) {
-        if (it->wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-            try {
-                process_semantics(it->get(), editor);
-            } catch (lsp::ResponseError& e) {
-                std::cerr << e.what();
+void clangd_server::tokens_requested(managed_document& document, lsptypes::tokens_request request) {
+    std::string id = _output_buffer->last_request_id();
+    document.pending_token_requests.push_back({.id = id, .is_range = request.type == lsptypes::tokens_request::kind::range});
+    if (auto batch = document.tokens->worker.request_sent(id, std::move(request)) ; batch) {
+        // answered before we could register it, the reader thread left it to us
+        _early_results.push_back({.document = document.id, .id = std::move(id), .batch = std::move(*batch)});
+    }
+}
+
+bool clangd_server::at_request_limit() const {
+    return pending_token_request_count() >= _options.max_in_flight_requests;
+}
+
+std::size_t clangd_server::pending_token_request_count() const {
+    std::size_t count = 0;
+    _documents.for_each([&count](const managed_document& document) {
+        count += document.pending_token_requests.size();
+    });
+    return count;
+}
+
+void clangd_server::request_visible_tokens(managed_document& document) {
+    if (!_lsp_conf.supports_semantic_tokens_range) {
+        return;
+    }
+
+    const lsptypes::line_range& visible = document.visible_lines;
+    lsptypes::line_range lines{
+        .first = visible.first - std::min(visible.first, _options.viewport_margin),
+        .last = std::min(visible.last + _options.viewport_margin, document.text.line_count())
+    };
+
+    lsp::requests::TextDocument_SemanticTokens_Range::Params params;
+    params.textDocument.uri = document.uri;
+    params.range.start.line = lines.first;
+    params.range.start.character = 0;
+    params.range.end.line = lines.last;
+    params.range.end.character = 0;
+
+    send_token_request<lsp::requests::TextDocument_SemanticTokens_Range>(document, std::move(params));
+    tokens_requested(document, {
+            .type = lsptypes::tokens_request::kind::range,
+            .version = document.version,
+            .lines = lines
+    });
+    document.requested_lines = lines;
+}
+
+void clangd_server::cancel_token_requests(managed_document& document, bool range_requests_only) {
+    std::erase_if(document.pending_token_requests, [this, &document, range_requests_only](const managed_document::pending_tokens_request& request) {
+        if (range_requests_only && !request.is_range) {
+            return false;
+        }
+
+        // a cancelled request may still be answered, but nobody is waiting for it anymore
+        cancel_request(request.id);
+        _semantic_interceptor.forget(request.id);
+        {
+            std::lock_guard lock(_token_routes_mutex);
+            _token_routes.erase(request.id);
+        }
+        document.tokens->worker.forget(request.id);
+        return true;
+    });
+}
+
+void clangd_server::cancel_request(const std::string& id) {
+    if (id.empty()) {
+        return;
+    }
+
+    lsp::notifications::CancelRequest::Params params;
+    if (id.front() == '"') {
+        params.id = id.substr(1, id.size() - 2);
+    } else {
+        params.id = std::stoi(id);
+    }
+    _msg_handler->messageDispatcher().sendNotification<lsp::notifications::CancelRequest>(std::move(params));
+    _telemetry.request_cancelled();
+}
+
+void clangd_server::complete(ImEdit::editor& editor, ImEdit::coordinates cursor) {
+    managed_document* document = _documents.find(editor);
+    if (document == nullptr || !document->is_open || _state != lsptypes::server_state::ready
+        || cursor.line >= editor_line_count(editor)) {
+        end_completion();
+        return;
+    }
+
+    const ImEdit::line& line = editor._lines[cursor.line];
+    cursor.char_index = std::min(cursor.char_index, static_cast<unsigned int>(line.size()));
+    unsigned int word_start = cursor.char_index;
+    while (word_start > 0 && is_word_glyph(line[word_start - 1])) {
+        --word_start;
+    }
+
+    const lsptypes::position anchor{.line = cursor.line, .character = word_start};
+    const bool same_word = _completion.document == document->id && _completion.anchor.line == anchor.line
+                           && _completion.anchor.character == anchor.character;
+    std::string typed = to_utf8(line, word_start, cursor.char_index);
+    if (same_word) {
+        const bool grew = typed.size() > _completion.typed.size();
+        _completion.typed = std::move(typed);
+        if (_completions.is_for(document->id, anchor)) {
+            // no round trip: the list we have is filtered again
+            _completions.filter(_completion.typed);
+        }
+        if (grew && _completions.is_incomplete() && _completion.request_id.empty()) {
+            // the server left items out, the longer word may get them. The current list is shown meanwhile
+            request_completion(*document, cursor, lsp::CompletionTriggerKind::TriggerForIncompleteCompletions, {});
+        }
+        return;
+    }
+
+    end_completion();
+    _completion.document = document->id;
+    _completion.anchor = anchor;
+    _completion.typed = std::move(typed);
+
+    std::optional<std::string> trigger_character;
+    if (word_start == cursor.char_index && word_start > 0) {
+        const std::string& previous = line[word_start - 1].cp;
+        if (std::ranges::find(_lsp_conf.completion_option_trigger_characters, previous) != _lsp_conf.completion_option_trigger_characters.end()) {
+            trigger_character = previous;
+        }
+    }
+    request_completion(*document, cursor, trigger_character ? lsp::CompletionTriggerKind::TriggerCharacter : lsp::CompletionTriggerKind::Invoked,
+                       std::move(trigger_character));
+}
+
+void clangd_server::end_completion() {
+    if (!_completion.request_id.empty() && _state == lsptypes::server_state::ready) {
+        cancel_request(_completion.request_id);
+    }
+    _completion = {};
+    _completions.clear();
+}
+
+void clangd_server::request_completion(managed_document& document, ImEdit::coordinates cursor, lsp::CompletionTriggerKind trigger_kind,
+                                       std::optional<std::string> trigger_character) {
+    // the server has to know about what was just typed
+    if (document.scheduler.has_pending_edits()) {
+        flush_edits(document);
+    }
+
+    lsp::requests::TextDocument_Completion::Params params;
+    params.textDocument.uri = document.uri;
+    params.position.line = cursor.line;
+    params.position.character = lsptypes::encoded_length(to_utf8(document.editor->_lines[cursor.line], 0, cursor.char_index),
+                                                         _lsp_conf.position_encoding);
+    lsp::CompletionContext context;
+    context.triggerKind = trigger_kind;
+    context.triggerCharacter = std::move(trigger_character);
+    params.context = std::move(context);
+
+    auto request = _msg_handler->messageDispatcher().sendRequest<lsp::requests::TextDocument_Completion>(std::move(params));
+    _completion.request_id = _output_buffer->last_request_id();
+    // the items are converted on the message processing thread, lists can hold thousands of them
+    await_answer(std::move(request), [id = _completion.request_id](auto& answer) {
+        lsptypes::completion_result result{.id = id};
+        try {
+            std::visit([&result](auto&& list) {
+                using list_t = std::decay_t<decltype(list)>;
+                if constexpr (std::is_same_v<list_t, std::vector<lsp::CompletionItem>>) {
+                    result.server_items = std::move(list);
+                } else if constexpr (std::is_same_v<list_t, lsp::CompletionList>) {
+                    result.server_items = std::move(list.items);
+                    result.incomplete = list.isIncomplete;
+                }
+            }, answer.get());
+        } catch (const std::exception&) {
+            result.failed = true;
+        }
+
+        result.items.reserve(result.server_items.size());
+        for (const lsp::CompletionItem& item : result.server_items) {
+            result.items.push_back(to_completion_item(item));
+        }
+        return lsptypes::server_result{std::move(result)};
+    });
+}
+
+void clangd_server::completion_items_shown(std::size_t first_match, std::size_t count) {
+    if (!_lsp_conf.is_completion_resolve_provider || _state != lsptypes::server_state::ready) {
+        return;
+    }
+
+    // items that are never shown are never resolved, out of the thousands a list may hold
+    const std::vector<std::uint32_t>& matches = _completions.matches();
+    for (std::size_t i = first_match ; i < first_match + count && i < matches.size() ; ++i) {
+        const std::uint32_t idx = matches[i];
+        if (_completions.item(idx).resolved || std::ranges::find(_completion.resolving, idx) != _completion.resolving.end()) {
+            continue;
+        }
+        _completion.resolving.push_back(idx);
+        await_answer(_msg_handler->messageDispatcher().sendRequest<lsp::requests::CompletionItem_Resolve>(
+                             lsp::CompletionItem{_completion.server_items[idx]}),
+                     [list = _completion.list, idx](auto& answer) {
+                         lsptypes::completion_resolve_result result{.list = list, .item = idx};
+                         try {
+                             result.server_item = answer.get();
+                             result.resolved = to_completion_item(result.server_item);
+                         } catch (const std::exception&) {
+                             result.failed = true;
+                         }
+                         return lsptypes::server_result{std::move(result)};
+                     });
+    }
+}
+
+const lsptypes::symbol_answer* clangd_server::query_symbol(ImEdit::editor& editor, ImEdit::coordinates position, lsptypes::symbol_query query) {
+    managed_document* document = _documents.find(editor);
+    if (document == nullptr) {
+        return nullptr;
+    }
+
+    const lsptypes::position pos{.line = position.line, .character = position.char_index};
+    if (const lsptypes::symbol_answer* answer = _symbols.find(document->id, query, pos) ; answer != nullptr) {
+        return answer;
+    }
+    request_symbol(*document, pos, query);
+    return nullptr;
+}
+
+void clangd_server::set_cursor(ImEdit::editor& editor, ImEdit::coordinates cursor) {
+    managed_document* document = _documents.find(editor);
+    if (document == nullptr) {
+        return;
+    }
+
+    if (document->cursor && document->cursor->line == cursor.line && document->cursor->character == cursor.char_index) {
+        return;
+    }
+    document->cursor = lsptypes::position{.line = cursor.line, .character = cursor.char_index};
+    document->cursor_moved = clock::now();
+    document->cursor_prefetched = false;
+}
+
+bool clangd_server::supports(lsptypes::symbol_query query) const noexcept {
+    switch (query) {
+        case lsptypes::symbol_query::hover:
+            return _lsp_conf.is_hover_provider;
+        case lsptypes::symbol_query::definition:
+            return _lsp_conf.is_definition_provider;
+        case lsptypes::symbol_query::declaration:
+            return _lsp_conf.is_declaration_provider;
+        case lsptypes::symbol_query::type_definition:
+            return _lsp_conf.is_type_definition_provider;
+        case lsptypes::symbol_query::implementation:
+            return _lsp_conf.is_implementation_provider;
+        case lsptypes::symbol_query::signature_help:
+            return _lsp_conf.is_signature_help_provider;
+    }
+    return false;
+}
+
+void clangd_server::request_symbol(managed_document& document, lsptypes::position position, lsptypes::symbol_query query) {
+    if (!document.is_open || _state != lsptypes::server_state::ready || !supports(query)
+        || position.line >= editor_line_count(*document.editor)) {
+        return;
+    }
+
+    bool pending = std::ranges::any_of(_symbol_requests, [&document, position, query](const pending_symbol_request& request) {
+        return request.document == document.id && request.query == query && request.range.contains(position);
+    });
+    if (pending) {
+        return;
+    }
+
+    // the answer has to be about the text we see
+    if (document.scheduler.has_pending_edits()) {
+        flush_edits(document);
+    }
+
+    lsptypes::symbol_range range = symbol_range_at(document.editor->_lines[position.line], position.line, position.character);
+    switch (query) {
+        case lsptypes::symbol_query::hover:
+            send_symbol_request<lsp::requests::TextDocument_Hover>(document, position, query, range);
+            break;
+        case lsptypes::symbol_query::definition:
+            send_symbol_request<lsp::requests::TextDocument_Definition>(document, position, query, range);
+            break;
+        case lsptypes::symbol_query::declaration:
+            send_symbol_request<lsp::requests::TextDocument_Declaration>(document, position, query, range);
+            break;
+        case lsptypes::symbol_query::type_definition:
+            send_symbol_request<lsp::requests::TextDocument_TypeDefinition>(document, position, query, range);
+            break;
+        case lsptypes::symbol_query::implementation:
+            send_symbol_request<lsp::requests::TextDocument_Implementation>(document, position, query, range);
+            break;
+        case lsptypes::symbol_query::signature_help:
+            // tied to the cursor rather than to a symbol
+            range = {.line = position.line, .first = position.character, .last = position.character};
+            send_symbol_request<lsp::requests::TextDocument_SignatureHelp>(document, position, query, range);
+            break;
+    }
+}
+
+template <typename RequestT>
+void clangd_server::send_symbol_request(managed_document& document, lsptypes::position position, lsptypes::symbol_query query,
+                                        lsptypes::symbol_range range) {
+    typename RequestT::Params params;
+    params.textDocument.uri = document.uri;
+    params.position.line = position.line;
+    params.position.character = lsptypes::encoded_length(to_utf8(document.editor->_lines[position.line], 0, position.character),
+                                                         _lsp_conf.position_encoding);
+
+    auto request = _msg_handler->messageDispatcher().sendRequest<RequestT>(std::move(params));
+    _symbol_requests.push_back({
+            .document = document.id,
+            .generation = _symbols.generation(document.id),
+            .query = query,
+            .range = range,
+            .id = _output_buffer->last_request_id()
+    });
+    await_answer(std::move(request), [id = _symbol_requests.back().id](auto& answer) {
+        lsptypes::symbol_result result{.id = id};
+        try {
+            collect_answer(answer.get(), result.answer);
+        } catch (const std::exception&) {
+            result.failed = true;
+        }
+        return lsptypes::server_result{std::move(result)};
+    });
+}
+
+void clangd_server::prefetch_symbols(clock::time_point now) {
+    if (_options.prefetch_delay.count() == 0 || !_symbol_requests.empty() || at_request_limit()) {
+        return;
+    }
+
+    _documents.for_each([this, now](managed_document& document) {
+        if (!document.cursor || document.cursor_prefetched || !document.is_open || document.large_file || document.scheduler.has_pending_edits()
+            || now - document.cursor_moved < _options.prefetch_delay) {
+            return;
+        }
+
+        // the user is likely to hover or jump from where the cursor rests
+        document.cursor_prefetched = true;
+        for (lsptypes::symbol_query query : {lsptypes::symbol_query::hover, lsptypes::symbol_query::definition}) {
+            if (_symbols.find(document.id, query, *document.cursor) == nullptr) {
+                request_symbol(document, *document.cursor, query);
             }
-            it = _pending_requests_results.erase(it);
-        } else {
-            ++it;
+        }
+    });
+}
+
+void clangd_server::update(ImEdit::editor &editor, lsptypes::line_range visible_lines) {
+    show(editor, visible_lines);
+    poll();
+}
+
+void clangd_server::update(ImEdit::editor &editor) {
+    const managed_document* document = _documents.find(editor);
+    update(editor, document == nullptr ? lsptypes::line_range{} : document->visible_lines);
+}
+
+void clangd_server::show(ImEdit::editor &editor, lsptypes::line_range visible_lines) {
+    managed_document* document = _documents.find(editor);
+    if (document == nullptr) {
+        return;
+    }
+    document->visible_lines = visible_lines;
+    document->last_visible = clock::now();
+    _last_shown = document->last_visible;
+    if (document->lexer) {
+        // colours lines shown for the first time until their semantic tokens come
+        document->lexer->highlight_new_lines(editor, visible_lines);
+    }
+
+    if (_state == lsptypes::server_state::stopped) {
+        try {
+            start_server();
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            _state = lsptypes::server_state::failed;
+        }
+        return;
+    }
+
+    // while edits are being buffered, the server's view of the document is outdated
+    const auto& requested = document->requested_lines;
+    bool visible_requested = requested.first <= visible_lines.first && visible_lines.last <= requested.last;
+    if (document->is_open && (_options.viewport_first_highlighting || document->large_file) && !visible_lines.empty() && !visible_requested
+        && !document->scheduler.has_pending_edits()) {
+        cancel_token_requests(*document, true);
+        if (!at_request_limit()) {
+            request_visible_tokens(*document);
         }
     }
 }
 
-void clangd_server::process_semantics(const lsp::TextDocument_SemanticTokens_FullResult &toks, ImEdit::editor& ed) {
-    if (toks.isNull()) {
+void clangd_server::poll() {
+    supervise();
+    poll_startup();
+    poll_shutdown();
+    if (_state != lsptypes::server_state::ready) {
         return;
     }
 
-    unsigned int last_line = 0;
-    unsigned int last_char_idx = 0;
-    for (unsigned int i = 0 ; i < toks.value().data.size() ; i += 5) {
-        auto& data = toks.value().data;
-        assert(i + 4 < toks.value().data.size());
-        auto line = last_line + data[i];
-        auto char_idx = (line != last_line) ? data[i + 1] : (data[i + 1] + last_char_idx);
+    auto now = clock::now();
+    auto shown_after = now - recently_visible;
+    _documents.for_each([this, now, shown_after](managed_document& document) {
+        if (!document.is_open && document.last_visible >= shown_after) {
+            open_document(document);
+        }
+        // edits of documents that are not shown anymore are sent too
+        if (document.scheduler.flush_due(now)) {
+            flush_edits(document);
+        }
+    });
 
-        last_line = line;
-        last_char_idx = char_idx;
+    process_results();
+    apply_partial_tokens();
+    prefetch_symbols(now);
+    _documents.for_each([this](managed_document& document) {
+        if (document.token_update_deferred && !at_request_limit()) {
+            request_token_update(document);
+        }
+    });
+    evict_documents();
+}
 
-        ImEdit::token_view token;
-        token.char_idx = char_idx;
-        token.length = data[i + 2];
-        token.type = _token_type_jump_table[data[i + 3]];
+void clangd_server::process_results() {
+    std::size_t result_count = _early_results.size();
+    for (lsptypes::tokens_result& result : std::exchange(_early_results, {})) {
+        process_result(std::move(result));
+    }
 
-        ed.add_token(line, token);
+    while (auto result = _results.try_pop()) {
+        ++result_count;
+        std::visit([this](auto&& r) {
+            process_result(std::move(r));
+        }, std::move(*result));
     }
+    _telemetry.results_processed(result_count, pending_token_request_count());
+}
 
+void clangd_server::process_result(lsptypes::tokens_result result) {
+    managed_document* document = _documents.find(result.document);
+    if (document == nullptr || !document->is_open) {
+        // closed while the answer was on its way
+        return;
+    }
+
+    std::erase_if(document->pending_token_requests, [&result](const managed_document::pending_tokens_request& request) {
+        return request.id == result.id;
+    });
+    apply_tokens(*document, std::move(result.batch));
+}
+
+void clangd_server::process_result(lsptypes::diagnostics_result result) {
+    managed_document* document = _documents.find(result.document);
+    if (document == nullptr || !document->is_open) {
+        return;
+    }
+
+    // edits may have been sent while the result was queued
+    if (diagnostic_index::outdated(result.diagnostics->version(), document->version, document->diagnostics.get())) {
+        return;
+    }
+    document->diagnostics = std::move(result.diagnostics);
+}
+
+void clangd_server::process_result(lsptypes::completion_result result) {
+    if (result.id != _completion.request_id) {
+        // cancelled, or the word changed meanwhile
+        return;
+    }
+    _completion.request_id.clear();
+    if (result.failed) {
+        // the list we had is kept
+        return;
+    }
+
+    for (lsptypes::completion_item& item : result.items) {
+        item.resolved = !_lsp_conf.is_completion_resolve_provider;
+    }
+    _completion.list = ++_completion_lists;
+    _completion.server_items = std::move(result.server_items);
+    _completion.resolving.clear();
+    _completions.assign(_completion.document, _completion.anchor, std::move(result.items), result.incomplete);
+    _completions.filter(_completion.typed);
+}
+
+void clangd_server::process_result(lsptypes::completion_resolve_result result) {
+    if (result.list != _completion.list || result.item >= _completions.size()) {
+        // the item belongs to a list that was replaced since
+        return;
+    }
+    std::erase(_completion.resolving, result.item);
+
+    // left unresolved if it failed, it is not asked again
+    lsptypes::completion_item& item = _completions.item(result.item);
+    if (!result.failed) {
+        if (result.server_item.detail) {
+            item.detail = std::move(result.resolved.detail);
+        }
+        item.documentation = std::move(result.resolved.documentation);
+        _completion.server_items[result.item] = std::move(result.server_item);
+    }
+    item.resolved = true;
+}
+
+void clangd_server::process_result(lsptypes::symbol_result result) {
+    auto request = std::ranges::find_if(_symbol_requests, [&result](const pending_symbol_request& pending) {
+        return pending.id == result.id;
+    });
+    if (request == _symbol_requests.end()) {
+        // sent to a previous server
+        return;
+    }
+
+    // a failed one is asked again the next time it is needed, an answer is dropped if the document was edited meanwhile
+    if (!result.failed) {
+        _symbols.store(request->document, request->generation, request->query, request->range, std::move(result.answer));
+    }
+    _symbol_requests.erase(request);
+}
+
+void clangd_server::receive_diagnostics(lsp::notifications::TextDocument_PublishDiagnostics::Params params) {
+    std::shared_ptr<document_tokens> document;
+    {
+        std::string uri = uri_string(params.uri);
+        std::lock_guard lock(_document_routes_mutex);
+        auto route = _document_routes.find(uri);
+        if (route == _document_routes.end() && uri.starts_with("file://")) {
+            // documents are opened with bare paths
+            route = _document_routes.find(uri.substr(7));
+        }
+        if (route == _document_routes.end()) {
+            // closed meanwhile
+            return;
+        }
+        document = route->second;
+    }
+
+    // newer diagnostics are on their way: these are not even decoded
+    const int version = params.version.value_or(document->version);
+    if (diagnostic_index::outdated(version, document->version, nullptr)) {
+        return;
+    }
+
+    std::vector<lsptypes::diagnostic> diagnostics;
+    diagnostics.reserve(params.diagnostics.size());
+    for (lsp::Diagnostic& diagnostic : params.diagnostics) {
+        diagnostics.push_back({
+                .start = {.line = diagnostic.range.start.line, .character = diagnostic.range.start.character},
+                .end = {.line = diagnostic.range.end.line, .character = diagnostic.range.end.character},
+                .severity = diagnostic.severity ? static_cast<lsptypes::diagnostic_severity>(*diagnostic.severity)
+                                                : lsptypes::diagnostic_severity::error,
+                .message = std::move(diagnostic.message),
+                .source = diagnostic.source.value_or("")
+        });
+    }
+
+    // indexed here rather than by the render loop, bursts of thousands of diagnostics happen on broken files
+    push_result(lsptypes::diagnostics_result{
+            .document = document->document_id,
+            .diagnostics = std::make_shared<const diagnostic_index>(version, std::move(diagnostics))
+    });
+}
+
+void clangd_server::push_result(lsptypes::server_result result) {
+    // the render loop drains the queue every frame of the ready state, it only fills up if the loop stalls. Once
+    // a stop is requested nothing drains it anymore, and the reader must go on to read the answer to shutdown
+    while (!_results.try_push(result)) {
+        if (_stop_requested) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void clangd_server::collect_answers() {
+    // the answers are only ready once their message was processed, by this thread
+    std::vector<std::function<bool()>> awaited;
+    {
+        std::lock_guard lock(_awaited_answers_mutex);
+        awaited.swap(_awaited_answers);
+    }
+    // pushed without the lock: the render loop may be waiting for it while the queue is full
+    std::erase_if(awaited, [](const std::function<bool()>& take) {
+        return take();
+    });
+    if (!awaited.empty()) {
+        std::lock_guard lock(_awaited_answers_mutex);
+        _awaited_answers.insert(_awaited_answers.end(), std::make_move_iterator(awaited.begin()), std::make_move_iterator(awaited.end()));
+    }
+}
+
+void clangd_server::apply_tokens(managed_document& document, lsptypes::token_batch batch) {
+    if (batch.version != document.version) {
+        if (!batch.is_range) {
+            // the cache moved on anyway: these lines will have to be refreshed by the next answer
+            document.edited_lines = document.edited_lines.merged_with(batch.changed_lines);
+        }
+        return;
+    }
+
+    if (batch.out_of_sync) {
+        // our cache went out of sync with the server, ask for everything again
+        request_token_update(document);
+        return;
+    }
+
+    if (document.large_file) {
+        // applied by the next frames, the rest of an older answer is not worth it anymore
+        const unsigned int first_line = batch.tokens.lines().first;
+        document.tokens_to_apply = managed_document::partial_tokens{
+                .tokens = std::move(batch.tokens),
+                .next_line = first_line,
+                .version = batch.version
+        };
+        return;
+    }
+
+    batch.tokens.apply(*document.editor, document.lexer ? &*document.lexer : nullptr);
+    document.decorations.replace(batch.tokens.lines(), batch.tokens);
+    _telemetry.tokens_applied(batch.tokens.token_count());
+    document.highlighted_version = batch.version;
+    if (!batch.is_range && !document.scheduler.has_pending_edits()) {
+        document.edited_lines = {};
+    }
+}
+
+void clangd_server::apply_partial_tokens() {
+    std::size_t budget = _options.large_file_tokens_per_frame;
+    _documents.for_each([this, &budget](managed_document& document) {
+        if (!document.tokens_to_apply) {
+            return;
+        }
+
+        auto& partial = *document.tokens_to_apply;
+        const std::size_t budget_before = budget;
+        const unsigned int first_line = partial.next_line;
+        partial.next_line = partial.tokens.apply_some(*document.editor, partial.next_line, budget, document.lexer ? &*document.lexer : nullptr);
+        document.decorations.replace({first_line, partial.next_line}, partial.tokens);
+        _telemetry.tokens_applied(budget_before - budget);
+        if (partial.next_line >= partial.tokens.lines().last) {
+            document.highlighted_version = partial.version;
+            document.tokens_to_apply.reset();
+        }
+    });
 }
@@ -1,12 +1,19 @@
 #ifndef IMEDIT_LS_LSP_H
 #define IMEDIT_LS_LSP_H
 
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <optional>
-#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
-#include <ext/stdio_filebuf.h>
+#include <sys/types.h>
 
 #include <lsp/connection.h>
 #include <lsp/messagehandler.h>
@@ -14,6 +21,21 @@
 
 #include <imedit/simple_types.h>
 
+#include "completion_cache.h"
+#include "document_manager.h"
+#include "edit_scheduler.h"
+#include "lsp_transport.h"
+#include "semantic_tokens.h"
+#include "semantic_tokens_decoder.h"
+#include "semantic_tokens_worker.h"
+#include "server_results.h"
+#include "spsc_queue.h"
+#include "symbol_cache.h"
+#include "telemetry.h"
+#include "text_document.h"
+#include "token_styles.h"
+#include "traffic_recorder.h"
+
 namespace lsp {
     struct InitializeResult;
 }
@@ -23,59 +45,304 @@ namespace ImEdit {
 }
 
 namespace lsptypes {
-    enum class encoding {
-        utf8,
-        utf16,
-        utf32
+    enum class server_state {
+        spawning,
+        initializing, // waiting for the answer to initialize, edits are buffered meanwhile
+        ready,
+        stopping, // asked to shut down, see clangd_server::stop
+        stopped, // started again when one of its documents is shown
+        failed // the server exited or refused to initialize, edits are not sent anywhere
+    };
+
+    struct server_options {
+        // arguments the language server is started with, after its path
+        std::vector<std::string> server_arguments{"-offset-encoding=utf-8"};
+        std::string workspace_root{"/tmp"};
+
+        // ask for the tokens of the visible lines before the ones of the whole document
+        bool viewport_first_highlighting{true};
+        // lines highlighted above and below the visible ones, so that small scrolls are already highlighted
+        unsigned int viewport_margin{50};
+
+        // edits are sent once no edit happened for edit_debounce, or once the oldest unsent one is edit_max_delay old
+        std::chrono::milliseconds edit_debounce{50};
+        std::chrono::milliseconds edit_max_delay{300};
+
+        // upper bound on the time the destructor waits for the server to shut down before killing it
+        std::chrono::milliseconds shutdown_timeout{500};
+
+        // the server is restarted when it exits, when it does not answer initialize within startup_timeout, or
+        // when requests are waiting and nothing came from it for response_timeout
+        std::chrono::milliseconds startup_timeout{10'000};
+        std::chrono::milliseconds response_timeout{15'000};
+        // past max_restarts restarts within restart_window, the server is given up on
+        unsigned int max_restarts{3};
+        std::chrono::milliseconds restart_window{60'000};
+
+        // least recently visible documents are closed on the server, and their mirror and tokens dropped, past
+        // max_open_documents open documents or once open documents take more than open_documents_memory_budget bytes
+        std::size_t max_open_documents{32};
+        std::size_t open_documents_memory_budget{64 * 1024 * 1024};
+
+        // requests past max_in_flight_requests unanswered ones are held back until some are answered
+        std::size_t max_in_flight_requests{16};
+        // the server is stopped once none of its documents was shown for idle_timeout, never if zero
+        std::chrono::milliseconds idle_timeout{0};
+
+        // hover and definition of the symbol under the cursor are asked for once the cursor rested for
+        // prefetch_delay, never if zero
+        std::chrono::milliseconds prefetch_delay{250};
+        // answers about symbols kept, see symbol_cache
+        std::size_t symbol_cache_size{512};
+
+        // documents of at least large_file_bytes bytes or large_file_lines lines are in large file mode: semantic
+        // tokens are only asked for the visible lines and applied large_file_tokens_per_frame at most per frame,
+        // the lexer and symbol prefetching are turned off. Thresholds of zero are never reached
+        std::size_t large_file_bytes{1024 * 1024};
+        unsigned int large_file_lines{30'000};
+        std::size_t large_file_tokens_per_frame{10'000};
+
+        // the messages exchanged with every server started are appended to this file, to be played back by
+        // tools/lsp_replay. Nothing is recorded if empty
+        std::string traffic_recording{};
+
+        // Called from the thread reading the server's messages once some were read, for the render loop to poll
+        // soon. See clangd_server::next_poll for the polls timers need
+        std::function<void()> message_listener{};
     };
 }
 
 class clangd_server {
 public:
-    explicit clangd_server(const std::filesystem::path& path_to_language_server);
+    using clock = std::chrono::steady_clock;
+
+    explicit clangd_server(const std::filesystem::path& path_to_language_server, lsptypes::server_options options = {});
     ~clangd_server();
 
+    // only valid while state() is initializing or ready
     lsp::MessageHandler* operator->() noexcept {
         return &*_msg_handler;
     }
 
+    // Binds the editor to the document at uri, and tracks its edits from now on. The document is opened on the
+    // server the first time the editor is updated
+    void add_editor(ImEdit::editor& editor, std::string uri, std::string language_id = "cpp");
+    // Closes the editor's document, must be called before the editor is destroyed
+    void remove_editor(ImEdit::editor& editor);
+    // binds the editor to /tmp/test.cpp
     void setup_editor(ImEdit::editor& editor);
 
+    // To be called every frame for each shown editor: show then poll
     void update(ImEdit::editor& editor);
+    // visible_lines are the lines shown by the editor, which are highlighted first
+    void update(ImEdit::editor& editor, lsptypes::line_range visible_lines);
+
+    // The editor counts as visible: its document is opened on the next poll, and the server started again if it
+    // was stopped
+    void show(ImEdit::editor& editor, lsptypes::line_range visible_lines);
+    // Sends due edits, applies the results of every document and watches over the server, once per frame
+    void poll();
+
+    // Starts shutting the server down without waiting for it, poll then reaps it. A server that failed to initialize
+    // is stopped too
+    void stop();
+
+    // When poll has to be called again at the latest, for edits to be flushed, the server to be supervised or symbols
+    // prefetched, time_point::max() if only messages from the server need it, see server_options::message_listener
+    [[nodiscard]] clock::time_point next_poll() const;
+
+    // Completes the word ending at cursor, to be called again after each edit while completing. The server is asked
+    // once per word: its answer is filtered and ranked on our side as the word is typed further
+    void complete(ImEdit::editor& editor, ImEdit::coordinates cursor);
+    void end_completion();
+
+    // Items of the word being completed, see completion_cache::matches. Empty until the server answered
+    [[nodiscard]] const completion_cache& completions() const noexcept {
+        return _completions;
+    }
+
+    // Asks the server for the detail and documentation of the matches shown, if it only gives them on request
+    void completion_items_shown(std::size_t first_match, std::size_t count);
+
+    // The server's answer about the symbol at position, from the cache if it was asked already. Otherwise the server
+    // is asked, and nullptr returned until it answered
+    [[nodiscard]] const lsptypes::symbol_answer* query_symbol(ImEdit::editor& editor, ImEdit::coordinates position, lsptypes::symbol_query query);
+
+    // The symbol under the cursor is prefetched once the cursor rests
+    void set_cursor(ImEdit::editor& editor, ImEdit::coordinates cursor);
+
+    // Parts of the diagnostics of the editor's document on the given lines, in editor glyphs. Only the diagnostics
+    // on these lines are looked at, so that it can be called every frame with the visible lines. The marks are valid
+    // until the next poll
+    void visible_diagnostics(const ImEdit::editor& editor, lsptypes::line_range lines, std::vector<lsptypes::diagnostic_mark>& marks) const;
+
+    // Decorations of the semantic tokens applied to the editor on the given lines, see lsptypes::token_decoration
+    void visible_decorations(const ImEdit::editor& editor, lsptypes::line_range lines, std::vector<lsptypes::decoration_mark>& marks) const;
+
+    // last diagnostics published for the editor's document, nullptr if none
+    [[nodiscard]] std::shared_ptr<const diagnostic_index> diagnostics(const ImEdit::editor& editor) const;
+
+    [[nodiscard]] lsptypes::server_state state() const noexcept {
+        return _state;
+    }
+
+    [[nodiscard]] std::size_t document_count() const noexcept {
+        return _documents.size();
+    }
+
+    // last version of the editor's document sent to the server
+    [[nodiscard]] int document_version(const ImEdit::editor& editor) const noexcept;
+
+    // version of the editor's document the last tokens applied to it were computed for
+    [[nodiscard]] int highlighted_version(const ImEdit::editor& editor) const noexcept;
+
+    // true if some edits of the editor were not sent to the server yet
+    [[nodiscard]] bool has_pending_edits(const ImEdit::editor& editor) const noexcept;
+
+    // over all the servers started so far
+    [[nodiscard]] std::uint64_t bytes_sent() const noexcept {
+        return _bytes_sent_before + (_output_buffer ? _output_buffer->bytes_written() : 0);
+    }
+
+    [[nodiscard]] std::uint64_t bytes_received() const noexcept {
+        return _bytes_received_before + (_input_buffer ? _input_buffer->bytes_read() : 0);
+    }
+
+    [[nodiscard]] lsptypes::telemetry_snapshot telemetry() const noexcept;
 
 private:
+    // spawns the server, connects to it and sends initialize
+    void start_server();
+    // waits for the server to exit until deadline, after asking it to if graceful, then kills it
+    void stop_server(clock::time_point deadline, bool graceful);
+    void reap_server(clock::time_point deadline);
+
+    // restarts the server if it exited or hung, stops it if idle
+    void supervise();
+    [[nodiscard]] bool is_stalled(clock::time_point now);
+    void restart_server(clock::time_point now);
+
     void process_messages();
+    void wake_message_processing() const;
+    void notify_message_listener() const;
 
-    void process_semantics(const lsp::TextDocument_SemanticTokens_FullResult& toks, ImEdit::editor& ed);
+    void apply_tokens(managed_document& document, lsptypes::token_batch batch);
+    // applies the tokens left to large documents, within the budget of a frame
+    void apply_partial_tokens();
 
     void close_pipes();
 
+    // moves to the ready state once initialize is answered, without waiting for it
+    void poll_startup();
     void process_initialize_answer(const lsp::InitializeResult&);
+    // moves to the stopped state once the server exited, or after shutdown_timeout
+    void poll_shutdown();
+    // the documents will be opened again on the next server, mirrors are kept unless drop_mirrors
+    void reset_documents(bool drop_mirrors);
+    void open_document(managed_document& document);
+    void close_document(managed_document& document);
+    // closes the least recently visible documents past the budgets of the options
+    void evict_documents();
 
     void line_changed(ImEdit::editor& ed, unsigned int line_idx, const ImEdit::line& before);
     void region_deleted(ImEdit::editor& ed, ImEdit::region old_region);
     void newline_deleted(ImEdit::editor& ed, unsigned int old_line_idx);
     void newline_created(ImEdit::editor& ed, unsigned int new_line_idx);
-
-    void request_token_update(ImEdit::editor& ed);
+    // Highlights the edit with the lexer right away, and mirrors it if the document's mirror is kept
+    void lines_edited(ImEdit::editor& ed, unsigned int first_line, unsigned int old_line_count, unsigned int new_line_count);
+    void document_replaced(ImEdit::editor& ed);
+
+    // Mirrors the replacement of old_line_count lines by new_line_count lines of the editor, starting at first_line
+    void sync_lines(managed_document& document, unsigned int first_line, unsigned int old_line_count, unsigned int new_line_count);
+    void resync_document(managed_document& document);
+    // switches the document in or out of large file mode as its size crosses the thresholds of the options
+    void check_large_file(managed_document& document);
+
+    void flush_edits(managed_document& document);
+    void send_pending_changes(managed_document& document);
+
+    void request_token_update(managed_document& document);
+    void request_visible_tokens(managed_document& document);
+    // sends a token request, and routes its answer to the document's token worker
+    template <typename RequestT>
+    void send_token_request(managed_document& document, typename RequestT::Params params);
+    // registers the request that was just sent to the document's token worker
+    void tokens_requested(managed_document& document, lsptypes::tokens_request request);
+    [[nodiscard]] std::size_t pending_token_request_count() const;
+    [[nodiscard]] bool at_request_limit() const;
+
+    void process_results();
+    void process_result(lsptypes::tokens_result result);
+    void process_result(lsptypes::diagnostics_result result);
+    void process_result(lsptypes::completion_result result);
+    void process_result(lsptypes::completion_resolve_result result);
+    // stores the answer in the symbol cache
+    void process_result(lsptypes::symbol_result result);
+    // from the message processing thread only
+    void push_result(lsptypes::server_result result);
+    // Hands the answer to a request that was just sent to the message processing thread, which turns it into the
+    // result convert(answer) returns as soon as it came
+    template <typename ResultT, typename ConvertT>
+    void await_answer(std::future<ResultT> answer, ConvertT convert);
+    // from the message processing thread only, queues the results of the awaited answers that came
+    void collect_answers();
+    // from the message processing thread only, decodes the diagnostics unless edits were sent since
+    void receive_diagnostics(lsp::notifications::TextDocument_PublishDiagnostics::Params params);
+    void cancel_token_requests(managed_document& document, bool range_requests_only);
+    void cancel_request(const std::string& id);
+
+    void request_completion(managed_document& document, ImEdit::coordinates cursor, lsp::CompletionTriggerKind trigger_kind,
+                            std::optional<std::string> trigger_character);
+
+    [[nodiscard]] bool supports(lsptypes::symbol_query query) const noexcept;
+    // sends the query, unless the same one is on its way
+    void request_symbol(managed_document& document, lsptypes::position position, lsptypes::symbol_query query);
+    template <typename RequestT>
+    void send_symbol_request(managed_document& document, lsptypes::position position, lsptypes::symbol_query query, lsptypes::symbol_range range);
+    void prefetch_symbols(clock::time_point now);
 
     //using optionals to delay the construction of objects
     std::optional<std::thread> _incomming_message_processing_thread{};
     std::atomic_bool _running{true};
+    std::atomic_bool _connection_closed{false}; // set by the message processing thread when the server is gone
+    std::atomic_bool _stop_requested{false}; // results are dropped rather than waited for room, see push_result
+
+    std::filesystem::path _server_path;
+    pid_t _server_pid{-1};
+    lsptypes::server_state _state{lsptypes::server_state::spawning};
+    std::future<lsp::InitializeResult> _initialize_answer{};
+    clock::time_point _startup_deadline{};
+    std::future<lsp::requests::Shutdown::Result> _shutdown_answer{};
+    clock::time_point _stop_deadline{};
+    bool _exit_sent{false};
+    clock::time_point _last_shown{};
+    std::vector<clock::time_point> _restart_times{};
+
+    struct {
+        std::uint64_t bytes_received{};
+        clock::time_point last_progress{};
+    } _watchdog{};
 
-    __gnu_cxx::stdio_filebuf<char> _input_filebuf{};
+    std::unique_ptr<traffic_recorder> _recorder{}; // outlives the buffers writing to it
+    std::optional<fd_input_buffer> _input_buffer{};
     std::optional<std::istream> _input_stream{};
-    __gnu_cxx::stdio_filebuf<char> _output_filebuf{};
+    std::optional<fd_output_buffer> _output_buffer{};
 
     std::optional<std::ostream> _output_stream{};
     std::optional<lsp::Connection> _connection{};
 
     std::optional<lsp::MessageHandler> _msg_handler{};
-    int _parent_to_child_fd[2]{};
+    int _parent_to_child_fd[2]{-1, -1};
 
-    int _child_to_parent_fd[2]{};
+    int _child_to_parent_fd[2]{-1, -1};
 
-    int _document_version{};
+    // transport counters of the servers that were stopped
+    std::uint64_t _bytes_sent_before{};
+    std::uint64_t _bytes_received_before{};
+
+    int _wakeup_fd{-1}; // eventfd interrupting the message processing thread's poll
+
+    document_manager _documents{};
 
     struct {
         lsptypes::encoding position_encoding{lsptypes::encoding::utf16};
@@ -98,14 +365,56 @@ private:
         bool is_color_provider{false};
 
         bool supports_semantic_tokens{false};
+        bool supports_semantic_tokens_delta{false};
+        bool supports_semantic_tokens_range{false};
         std::vector<std::string> token_types;
         std::vector<std::string> token_modifiers;
     } _lsp_conf{};
 
-    std::vector<ImEdit::token_type::enum_> _token_type_jump_table;
+    std::shared_ptr<const token_style_table> _token_styles{std::make_shared<const token_style_table>()};
+    std::vector<lsptypes::tokens_result> _early_results{};
+    spsc_queue<lsptypes::server_result, 256> _results{};
+
+    // token workers awaiting the answer of each token request, registered by the request observer before the
+    // request is written so that the answer can't get there first
+    std::mutex _token_routes_mutex{};
+    std::unordered_map<std::string, std::shared_ptr<document_tokens>> _token_routes{};
+    std::shared_ptr<document_tokens> _sending_tokens_of{}; // set while a token request is being sent
+
+    // answers converted by the message processing thread, see await_answer. Each returns true once it queued its result
+    std::mutex _awaited_answers_mutex{};
+    std::vector<std::function<bool()>> _awaited_answers{};
+
+    // open documents by uri, for the notifications the server sends about them
+    std::mutex _document_routes_mutex{};
+    std::unordered_map<std::string, std::shared_ptr<document_tokens>> _document_routes{};
+
+    struct completion_session {
+        std::uint64_t document{}; // 0 if not completing
+        lsptypes::position anchor{}; // start of the completed word, in editor coordinates
+        std::string typed{}; // part of the word before the cursor
+        std::string request_id{}; // of the list request being answered, empty if none
+        std::uint64_t list{}; // number of the list received, 0 until one is
+        std::vector<lsp::CompletionItem> server_items{}; // sent back as is to completionItem/resolve
+        std::vector<std::uint32_t> resolving{}; // items whose details were asked for
+    } _completion{};
+    std::uint64_t _completion_lists{}; // received so far, numbering them
+    completion_cache _completions{};
+
+    struct pending_symbol_request {
+        std::uint64_t document{};
+        std::uint64_t generation{}; // of the document in the cache when the request was sent
+        lsptypes::symbol_query query{};
+        lsptypes::symbol_range range{};
+        std::string id{};
+    };
+    std::vector<pending_symbol_request> _symbol_requests{};
+    symbol_cache _symbols;
 
-    std::list<std::future<lsp::TextDocument_SemanticTokens_FullResult>> _pending_requests_results;
+    semantic_tokens_interceptor _semantic_interceptor;
+    lsp_telemetry _telemetry{};
 
+    lsptypes::server_options _options;
 };
 
 
@@ -0,0 +1,67 @@
+#include "completion_cache.h"
+
+#include <algorithm>
+#include <numeric>
+
+void completion_cache::assign(std::uint64_t document, lsptypes::position anchor, std::vector<lsptypes::completion_item> items, bool incomplete) {
+    _document = document;
+    _anchor = anchor;
+    _incomplete = incomplete;
+    _items = std::move(items);
+
+    _candidates.clear();
+    _candidates.reserve(_items.size());
+    for (const lsptypes::completion_item& item : _items) {
+        _candidates.emplace_back(item.filter_text);
+    }
+
+    // sort texts are only compared here, ranking compares integers
+    std::vector<std::uint32_t> order(_items.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [this](std::uint32_t lhs, std::uint32_t rhs) {
+        return _items[lhs].sort_text < _items[rhs].sort_text;
+    });
+    _sort_rank.assign(_items.size(), 0);
+    for (std::uint32_t rank = 0 ; rank < order.size() ; ++rank) {
+        _sort_rank[order[rank]] = rank;
+    }
+
+    _typed.clear();
+    _filtered = false;
+    _matches.clear();
+    _scores.assign(_items.size(), 0);
+}
+
+void completion_cache::clear() {
+    assign(0, {}, {}, false);
+}
+
+const std::vector<std::uint32_t>& completion_cache::filter(std::string_view typed) {
+    // a subsequence of the longer word is one of the shorter word too
+    const bool narrowing = _filtered && typed.starts_with(_typed);
+    if (!narrowing) {
+        _matches.resize(_items.size());
+        std::iota(_matches.begin(), _matches.end(), 0u);
+    }
+
+    fuzzy_matcher matcher{typed};
+    std::erase_if(_matches, [this, &matcher](std::uint32_t idx) {
+        auto score = matcher.score(_candidates[idx]);
+        if (!score) {
+            return true;
+        }
+        _scores[idx] = *score;
+        return false;
+    });
+
+    std::sort(_matches.begin(), _matches.end(), [this](std::uint32_t lhs, std::uint32_t rhs) {
+        if (_scores[lhs] != _scores[rhs]) {
+            return _scores[lhs] > _scores[rhs];
+        }
+        return _sort_rank[lhs] < _sort_rank[rhs];
+    });
+
+    _typed = typed;
+    _filtered = true;
+    return _matches;
+}
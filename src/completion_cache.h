@@ -0,0 +1,88 @@
+#ifndef IMEDIT_LS_COMPLETION_CACHE_H
+#define IMEDIT_LS_COMPLETION_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "fuzzy_matcher.h"
+#include "text_document.h"
+
+namespace lsptypes {
+    struct completion_item {
+        std::string label{};
+        std::string filter_text{}; // what typed text is matched against, the label if the server gave none
+        std::string insert_text{}; // the label if the server gave none
+        std::string sort_text{}; // the label if the server gave none
+        std::string detail{};
+        std::string documentation{};
+        int kind{}; // lsp::CompletionItemKind, 0 if unknown
+        bool resolved{false}; // detail and documentation are complete
+    };
+}
+
+// Last completion list received for a word, filtered and ranked on our side as the word is typed further
+class completion_cache {
+public:
+    // anchor is the start of the completed word, in editor coordinates
+    void assign(std::uint64_t document, lsptypes::position anchor, std::vector<lsptypes::completion_item> items, bool incomplete);
+    void clear();
+
+    [[nodiscard]] bool empty() const noexcept {
+        return _items.empty();
+    }
+
+    // the list was given for the word starting at anchor
+    [[nodiscard]] bool is_for(std::uint64_t document, lsptypes::position anchor) const noexcept {
+        return _document == document && _anchor.line == anchor.line && _anchor.character == anchor.character;
+    }
+
+    // start of the completed word, in editor coordinates
+    [[nodiscard]] lsptypes::position anchor() const noexcept {
+        return _anchor;
+    }
+
+    // the server left items out, a longer word may get others
+    [[nodiscard]] bool is_incomplete() const noexcept {
+        return _incomplete;
+    }
+
+    // Ranks the items matching typed, best first. When typed extends the previous word, only the items that matched
+    // it are looked at again
+    const std::vector<std::uint32_t>& filter(std::string_view typed);
+
+    // indices of the items matching the last filter, best first
+    [[nodiscard]] const std::vector<std::uint32_t>& matches() const noexcept {
+        return _matches;
+    }
+
+    [[nodiscard]] const lsptypes::completion_item& item(std::uint32_t idx) const noexcept {
+        return _items[idx];
+    }
+
+    [[nodiscard]] lsptypes::completion_item& item(std::uint32_t idx) noexcept {
+        return _items[idx];
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return _items.size();
+    }
+
+private:
+    std::uint64_t _document{};
+    lsptypes::position _anchor{};
+    bool _incomplete{false};
+
+    std::vector<lsptypes::completion_item> _items{};
+    std::vector<fuzzy_candidate> _candidates{};
+    std::vector<std::uint32_t> _sort_rank{}; // of each item in the server's order, breaking score ties
+
+    std::string _typed{};
+    bool _filtered{false};
+    std::vector<std::uint32_t> _matches{};
+    std::vector<int> _scores{}; // of each item, valid for the items in _matches
+};
+
+
+#endif //IMEDIT_LS_COMPLETION_CACHE_H
@@ -0,0 +1,339 @@
+#include "cpp_lexer.h"
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <string_view>
+
+namespace {
+    enum char_class : std::uint8_t {
+        identifier_start = 1 << 0,
+        identifier = 1 << 1,
+        digit = 1 << 2,
+        space = 1 << 3,
+        operator_char = 1 << 4
+    };
+
+    // stands for any glyph outside of ASCII, which may be part of identifiers
+    constexpr unsigned char non_ascii = 0x80;
+
+    constexpr std::array<std::uint8_t, 256> make_char_classes() {
+        std::array<std::uint8_t, 256> classes{};
+        for (unsigned char c = 'a' ; c <= 'z' ; ++c) {
+            classes[c] = identifier_start | identifier;
+        }
+        for (unsigned char c = 'A' ; c <= 'Z' ; ++c) {
+            classes[c] = identifier_start | identifier;
+        }
+        for (unsigned char c = '0' ; c <= '9' ; ++c) {
+            classes[c] = digit | identifier;
+        }
+        for (std::size_t c = non_ascii ; c < classes.size() ; ++c) {
+            classes[c] = identifier_start | identifier;
+        }
+        classes['_'] = identifier_start | identifier;
+        for (char c : std::string_view{" \t\v\f\r"}) {
+            classes[static_cast<unsigned char>(c)] = space;
+        }
+        for (char c : std::string_view{"+-*/%^&|~!=<>?:."}) {
+            classes[static_cast<unsigned char>(c)] = operator_char;
+        }
+        return classes;
+    }
+
+    constexpr std::array<std::uint8_t, 256> char_classes = make_char_classes();
+
+    // C and C++ keywords, alternative operator spellings included
+    constexpr std::array<std::string_view, 95> keywords{
+        "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case", "catch",
+        "char", "char16_t", "char32_t", "char8_t", "class", "co_await", "co_return", "co_yield", "compl", "concept",
+        "const", "const_cast", "consteval", "constexpr", "constinit", "continue", "decltype", "default", "delete",
+        "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "final", "float",
+        "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not",
+        "not_eq", "nullptr", "operator", "or", "or_eq", "override", "private", "protected", "public", "register",
+        "reinterpret_cast", "requires", "restrict", "return", "short", "signed", "sizeof", "static",
+        "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true",
+        "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
+        "wchar_t", "while", "xor", "xor_eq"
+    };
+    static_assert(std::ranges::is_sorted(keywords), "keywords are binary searched");
+
+    constexpr std::size_t max_keyword_size = 16;
+
+    bool is(unsigned char c, char_class cls) noexcept {
+        return (char_classes[c] & cls) != 0;
+    }
+
+    class line_lexer {
+    public:
+        line_lexer(const ImEdit::line& line, std::vector<ImEdit::token_view>* tokens) noexcept
+            : _line{line}, _tokens{tokens} {}
+
+        lsptypes::lexer_state run(lsptypes::lexer_state state) {
+            switch (state) {
+                case lsptypes::lexer_state::block_comment:
+                    if (!block_comment(0)) {
+                        return lsptypes::lexer_state::block_comment;
+                    }
+                    break;
+                case lsptypes::lexer_state::line_comment:
+                    add(0, _line.size(), ImEdit::token_type::comment);
+                    return continued() ? lsptypes::lexer_state::line_comment : lsptypes::lexer_state::code;
+                case lsptypes::lexer_state::string:
+                    if (!quoted(0, '"')) {
+                        return lsptypes::lexer_state::string;
+                    }
+                    break;
+                case lsptypes::lexer_state::raw_string:
+                    if (!raw_string(0)) {
+                        return lsptypes::lexer_state::raw_string;
+                    }
+                    break;
+                case lsptypes::lexer_state::code:
+                    break;
+            }
+            return code(state == lsptypes::lexer_state::code);
+        }
+
+    private:
+        // 0 past the end
+        [[nodiscard]] unsigned char at(std::size_t i) const noexcept {
+            if (i >= _line.size()) {
+                return 0;
+            }
+            const auto& cp = _line[i].cp;
+            return cp.size() == 1 ? static_cast<unsigned char>(cp[0]) : non_ascii;
+        }
+
+        // the line ends with a backslash, joining it with the next one
+        [[nodiscard]] bool continued() const noexcept {
+            return !_line.empty() && at(_line.size() - 1) == '\\';
+        }
+
+        void add(std::size_t start, std::size_t length, ImEdit::token_type::enum_ type) {
+            if (_tokens == nullptr || length == 0) {
+                return;
+            }
+            ImEdit::token_view token;
+            token.char_idx = static_cast<unsigned int>(start);
+            token.length = static_cast<unsigned int>(length);
+            token.type = type;
+            _tokens->push_back(token);
+        }
+
+        // ascii spelling of [start, end), empty if too long for a keyword
+        [[nodiscard]] std::string_view word(std::size_t start, std::size_t end, std::array<char, max_keyword_size>& buffer) const noexcept {
+            if (end - start > buffer.size()) {
+                return {};
+            }
+            for (std::size_t i = start ; i < end ; ++i) {
+                buffer[i - start] = static_cast<char>(at(i));
+            }
+            return {buffer.data(), end - start};
+        }
+
+        lsptypes::lexer_state code(bool line_start) {
+            while (_pos < _line.size()) {
+                const std::size_t start = _pos;
+                const unsigned char c = at(_pos);
+
+                if (is(c, space)) {
+                    ++_pos;
+                    continue;
+                }
+                if (c == '#' && line_start) {
+                    directive();
+                    line_start = false;
+                    continue;
+                }
+                line_start = false;
+
+                if (c == '/' && at(_pos + 1) == '/') {
+                    add(start, _line.size() - start, ImEdit::token_type::comment);
+                    _pos = _line.size();
+                    return continued() ? lsptypes::lexer_state::line_comment : lsptypes::lexer_state::code;
+                }
+                if (c == '/' && at(_pos + 1) == '*') {
+                    _pos += 2;
+                    if (!block_comment(start)) {
+                        return lsptypes::lexer_state::block_comment;
+                    }
+                } else if (c == '"') {
+                    ++_pos;
+                    if (!quoted(start, '"')) {
+                        return lsptypes::lexer_state::string;
+                    }
+                } else if (c == '\'') {
+                    ++_pos;
+                    quoted(start, '\'');
+                } else if (is(c, digit) || (c == '.' && is(at(_pos + 1), digit))) {
+                    number();
+                } else if (is(c, identifier_start)) {
+                    if (auto state = identifier_or_prefixed_literal() ; state) {
+                        return *state;
+                    }
+                } else if (is(c, operator_char)) {
+                    operators();
+                } else {
+                    ++_pos;
+                }
+            }
+            return lsptypes::lexer_state::code;
+        }
+
+        // from _pos, past the opening of the comment. Returns false if it goes on on the next line
+        bool block_comment(std::size_t start) {
+            while (_pos < _line.size()) {
+                if (at(_pos) == '*' && at(_pos + 1) == '/') {
+                    _pos += 2;
+                    add(start, _pos - start, ImEdit::token_type::comment);
+                    return true;
+                }
+                ++_pos;
+            }
+            add(start, _pos - start, ImEdit::token_type::comment);
+            return false;
+        }
+
+        // from _pos, past the opening quote. Returns false if it goes on on the next line
+        bool quoted(std::size_t start, unsigned char quote) {
+            while (_pos < _line.size()) {
+                unsigned char c = at(_pos++);
+                if (c == '\\') {
+                    ++_pos;
+                } else if (c == quote) {
+                    add(start, _pos - start, ImEdit::token_type::string_literal);
+                    return true;
+                }
+            }
+            _pos = _line.size();
+            add(start, _pos - start, ImEdit::token_type::string_literal);
+            // unterminated literals end with their line, unless escaped
+            return !continued();
+        }
+
+        // from _pos, past R". The delimiter is not remembered across lines: any )delimiter" closes the string
+        bool raw_string(std::size_t start) {
+            while (_pos < _line.size()) {
+                if (at(_pos++) != ')') {
+                    continue;
+                }
+                std::size_t end = _pos;
+                while (end < _line.size() && end - _pos <= max_keyword_size && at(end) != '"'
+                       && !is(at(end), space) && at(end) != '(' && at(end) != ')' && at(end) != '\\') {
+                    ++end;
+                }
+                if (at(end) == '"') {
+                    _pos = end + 1;
+                    add(start, _pos - start, ImEdit::token_type::string_literal);
+                    return true;
+                }
+            }
+            add(start, _pos - start, ImEdit::token_type::string_literal);
+            return false;
+        }
+
+        void number() {
+            const std::size_t start = _pos;
+            while (_pos < _line.size()) {
+                unsigned char c = at(_pos);
+                if ((c == 'e' || c == 'E' || c == 'p' || c == 'P') && (at(_pos + 1) == '+' || at(_pos + 1) == '-')) {
+                    _pos += 2;
+                } else if (is(c, identifier) || c == '.' || (c == '\'' && is(at(_pos + 1), identifier))) {
+                    ++_pos;
+                } else {
+                    break;
+                }
+            }
+            add(start, _pos - start, ImEdit::token_type::num_literal);
+        }
+
+        // returns the state of the next line if the identifier turned out to prefix a raw string going on there
+        std::optional<lsptypes::lexer_state> identifier_or_prefixed_literal() {
+            const std::size_t start = _pos;
+            while (is(at(_pos), identifier)) {
+                ++_pos;
+            }
+
+            std::array<char, max_keyword_size> buffer;
+            std::string_view spelling = word(start, _pos, buffer);
+            unsigned char next = at(_pos);
+            if (next == '"' || next == '\'') {
+                if (spelling == "L" || spelling == "u" || spelling == "U" || spelling == "u8") {
+                    ++_pos;
+                    if (!quoted(start, next)) {
+                        return lsptypes::lexer_state::string;
+                    }
+                    return {};
+                }
+                if (next == '"' && (spelling == "R" || spelling == "LR" || spelling == "uR" || spelling == "UR" || spelling == "u8R")) {
+                    ++_pos;
+                    if (!raw_string(start)) {
+                        return lsptypes::lexer_state::raw_string;
+                    }
+                    return {};
+                }
+            }
+
+            if (!spelling.empty() && std::binary_search(keywords.begin(), keywords.end(), spelling)) {
+                add(start, _pos - start, ImEdit::token_type::keyword);
+            }
+            return {};
+        }
+
+        void operators() {
+            const std::size_t start = _pos;
+            while (is(at(_pos), operator_char)) {
+                // comments and .5 are not operators
+                if ((at(_pos) == '/' && (at(_pos + 1) == '/' || at(_pos + 1) == '*'))
+                    || (at(_pos) == '.' && is(at(_pos + 1), digit))) {
+                    break;
+                }
+                ++_pos;
+            }
+            if (_pos == start) {
+                ++_pos;
+                return;
+            }
+            add(start, _pos - start, ImEdit::token_type::operators);
+        }
+
+        void directive() {
+            const std::size_t start = _pos++;
+            while (is(at(_pos), space)) {
+                ++_pos;
+            }
+            const std::size_t name_start = _pos;
+            while (is(at(_pos), identifier)) {
+                ++_pos;
+            }
+            add(start, _pos - start, ImEdit::token_type::preprocessor);
+
+            std::array<char, max_keyword_size> buffer;
+            std::string_view name = word(name_start, _pos, buffer);
+            if (name != "include" && name != "include_next" && name != "import") {
+                return;
+            }
+
+            while (is(at(_pos), space)) {
+                ++_pos;
+            }
+            if (at(_pos) == '<') {
+                const std::size_t header_start = _pos;
+                while (_pos < _line.size() && at(_pos) != '>') {
+                    ++_pos;
+                }
+                _pos = std::min(_pos + 1, _line.size());
+                add(header_start, _pos - header_start, ImEdit::token_type::string_literal);
+            }
+        }
+
+        const ImEdit::line& _line;
+        std::vector<ImEdit::token_view>* _tokens;
+        std::size_t _pos{0};
+    };
+}
+
+lsptypes::lexer_state lex_cpp_line(const ImEdit::line& line, lsptypes::lexer_state state, std::vector<ImEdit::token_view>* tokens) {
+    return line_lexer{line, tokens}.run(state);
+}
@@ -0,0 +1,26 @@
+#ifndef IMEDIT_LS_CPP_LEXER_H
+#define IMEDIT_LS_CPP_LEXER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <imedit/simple_types.h>
+
+namespace lsptypes {
+    // What the previous lines left open at the start of a line
+    enum class lexer_state : std::uint8_t {
+        code,
+        block_comment,
+        line_comment, // continued by a trailing backslash
+        string, // continued by a trailing backslash
+        raw_string
+    };
+}
+
+// Tokenises one line of C or C++ starting in the given state, and returns the state the next line starts in.
+// Keywords, literals, comments, preprocessor directives and operators are appended to tokens, if not null, in
+// glyph coordinates. Identifiers are left to the language server.
+lsptypes::lexer_state lex_cpp_line(const ImEdit::line& line, lsptypes::lexer_state state, std::vector<ImEdit::token_view>* tokens);
+
+
+#endif //IMEDIT_LS_CPP_LEXER_H
@@ -0,0 +1,20 @@
+#include "diagnostics.h"
+
+diagnostic_index::diagnostic_index(int version, std::vector<lsptypes::diagnostic> diagnostics)
+    : _version{version}
+    , _diagnostics{std::move(diagnostics)}
+{
+    std::sort(_diagnostics.begin(), _diagnostics.end(), [](const lsptypes::diagnostic& lhs, const lsptypes::diagnostic& rhs) {
+        if (lhs.start.line != rhs.start.line) {
+            return lhs.start.line < rhs.start.line;
+        }
+        return lhs.start.character < rhs.start.character;
+    });
+
+    _reach.reserve(_diagnostics.size());
+    unsigned int reach = 0;
+    for (const lsptypes::diagnostic& diagnostic : _diagnostics) {
+        reach = std::max(reach, diagnostic.last_line());
+        _reach.push_back(reach);
+    }
+}
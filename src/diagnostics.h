@@ -0,0 +1,87 @@
+#ifndef IMEDIT_LS_DIAGNOSTICS_H
+#define IMEDIT_LS_DIAGNOSTICS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "semantic_tokens.h"
+#include "text_document.h"
+
+namespace lsptypes {
+    enum class diagnostic_severity : std::uint8_t {
+        error = 1,
+        warning = 2,
+        information = 3,
+        hint = 4
+    };
+
+    // in the server's coordinates
+    struct diagnostic {
+        position start{};
+        position end{};
+        diagnostic_severity severity{diagnostic_severity::error};
+        std::string message{};
+        std::string source{};
+
+        // ranges ending at the start of a line do not cover it
+        [[nodiscard]] unsigned int last_line() const noexcept {
+            return end.line > start.line && end.character == 0 ? end.line - 1 : end.line;
+        }
+    };
+
+    // part of a diagnostic on a single line, in editor glyphs [first, last)
+    struct diagnostic_mark {
+        unsigned int line{};
+        unsigned int first{};
+        unsigned int last{};
+        diagnostic_severity severity{};
+        const diagnostic* source{}; // valid as long as the index it comes from
+    };
+}
+
+// Diagnostics published for a version of a document, indexed by the lines they cover so that drawing the visible
+// lines only looks at the diagnostics on them. Built by the thread reading the server's messages
+class diagnostic_index {
+public:
+    diagnostic_index(int version, std::vector<lsptypes::diagnostic> diagnostics);
+
+    // version of the document the diagnostics are about
+    [[nodiscard]] int version() const noexcept {
+        return _version;
+    }
+
+    // Diagnostics about version are dropped once a later version was sent, document_version being the last one sent,
+    // or when diagnostics about a later version are shown already
+    [[nodiscard]] static bool outdated(int version, int document_version, const diagnostic_index* shown) noexcept {
+        return version < document_version || (shown != nullptr && version < shown->version());
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return _diagnostics.size();
+    }
+
+    // Calls func(diagnostic) for each diagnostic covering some of the lines, by start position
+    template <typename FuncT>
+    void for_each_in(lsptypes::line_range lines, FuncT&& func) const {
+        if (lines.empty()) {
+            return;
+        }
+        // _reach is sorted: the diagnostics before the bound all end before the lines
+        auto first = static_cast<std::size_t>(std::lower_bound(_reach.begin(), _reach.end(), lines.first) - _reach.begin());
+        for (std::size_t i = first ; i < _diagnostics.size() && _diagnostics[i].start.line < lines.last ; ++i) {
+            if (_diagnostics[i].last_line() >= lines.first) {
+                func(_diagnostics[i]);
+            }
+        }
+    }
+
+private:
+    int _version;
+    std::vector<lsptypes::diagnostic> _diagnostics; // by start position
+    std::vector<unsigned int> _reach{}; // greatest last line of the diagnostics up to each one
+};
+
+
+#endif //IMEDIT_LS_DIAGNOSTICS_H
@@ -0,0 +1,103 @@
+#include "document_manager.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+    bool has_lexer(const std::string& language_id) noexcept {
+        return language_id == "c" || language_id == "cpp" || language_id == "objective-c" || language_id == "objective-cpp";
+    }
+}
+
+managed_document::managed_document(std::uint64_t document_id, ImEdit::editor& ed, std::string document_uri, std::string language,
+                                   edit_scheduler document_scheduler)
+    : id{document_id}
+    , editor{&ed}
+    , uri{std::move(document_uri)}
+    , language_id{std::move(language)}
+    , scheduler{document_scheduler}
+    , tokens{std::make_shared<document_tokens>(document_id)}
+{
+    if (has_lexer(language_id)) {
+        lexer.emplace();
+    }
+}
+
+void managed_document::set_large_file(bool large) {
+    large_file = large;
+    if (large) {
+        // lexing a line needs the state of every line above it
+        lexer.reset();
+    } else if (!lexer && has_lexer(language_id)) {
+        lexer.emplace();
+    }
+}
+
+std::size_t managed_document::memory_usage() const {
+    return text.byte_size() + tokens->worker.cache_size();
+}
+
+managed_document& document_manager::add(ImEdit::editor& editor, std::string uri, std::string language_id, edit_scheduler scheduler) {
+    return *_documents.emplace_back(std::make_unique<managed_document>(_next_id++, editor, std::move(uri), std::move(language_id), scheduler));
+}
+
+void document_manager::remove(const ImEdit::editor& editor) {
+    std::erase_if(_documents, [&editor](const std::unique_ptr<managed_document>& document) {
+        return document->editor == &editor;
+    });
+}
+
+managed_document* document_manager::find(const ImEdit::editor& editor) const noexcept {
+    for (const std::unique_ptr<managed_document>& document : _documents) {
+        if (document->editor == &editor) {
+            return document.get();
+        }
+    }
+    return nullptr;
+}
+
+managed_document* document_manager::find(std::uint64_t id) const noexcept {
+    for (const std::unique_ptr<managed_document>& document : _documents) {
+        if (document->id == id) {
+            return document.get();
+        }
+    }
+    return nullptr;
+}
+
+std::vector<managed_document*> document_manager::eviction_candidates(std::size_t max_open, std::size_t memory_budget,
+                                                                     managed_document::clock::time_point keep_after) const {
+    struct open_document {
+        managed_document* document;
+        std::size_t memory;
+    };
+
+    std::vector<open_document> open;
+    std::size_t memory = 0;
+    for (const std::unique_ptr<managed_document>& document : _documents) {
+        if (document->is_open) {
+            open.push_back({document.get(), document->memory_usage()});
+            memory += open.back().memory;
+        }
+    }
+
+    std::vector<managed_document*> candidates;
+    if (open.size() <= max_open && memory <= memory_budget) {
+        return candidates;
+    }
+
+    std::sort(open.begin(), open.end(), [](const open_document& lhs, const open_document& rhs) {
+        return lhs.document->last_visible < rhs.document->last_visible;
+    });
+
+    std::size_t open_count = open.size();
+    for (const open_document& candidate : open) {
+        if ((open_count <= max_open && memory <= memory_budget) || candidate.document->last_visible >= keep_after) {
+            break;
+        }
+        candidates.push_back(candidate.document);
+        --open_count;
+        memory -= candidate.memory;
+    }
+    return candidates;
+}
@@ -0,0 +1,122 @@
+#ifndef IMEDIT_LS_DOCUMENT_MANAGER_H
+#define IMEDIT_LS_DOCUMENT_MANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "diagnostics.h"
+#include "edit_scheduler.h"
+#include "lexical_highlighter.h"
+#include "semantic_tokens.h"
+#include "semantic_tokens_worker.h"
+#include "text_document.h"
+#include "token_store.h"
+
+namespace ImEdit {
+    class editor;
+}
+
+// Semantic tokens side of a document. Shared with the thread reading the server's messages, which may still be
+// handing answers to it after the document was removed
+struct document_tokens {
+    explicit document_tokens(std::uint64_t id) noexcept : document_id{id} {}
+
+    const std::uint64_t document_id;
+    semantic_tokens_worker worker{};
+    std::atomic_int version{}; // last version sent to the server, older diagnostics are dropped on arrival
+};
+
+// A document bound to an editor, and what the server was told about it
+struct managed_document {
+    using clock = std::chrono::steady_clock;
+
+    managed_document(std::uint64_t document_id, ImEdit::editor& ed, std::string document_uri, std::string language, edit_scheduler document_scheduler);
+
+    [[nodiscard]] std::size_t memory_usage() const;
+
+    // In large file mode, only the tokens of the visible lines are asked for and the lexer is dropped
+    void set_large_file(bool large);
+
+    const std::uint64_t id;
+    ImEdit::editor* const editor;
+    const std::string uri;
+    const std::string language_id;
+
+    bool is_open{false}; // didOpen was sent to the current server
+    bool mirror_valid{false}; // text matches the editor. Dropped when the document is closed to save memory
+    bool large_file{false}; // see server_options::large_file_bytes
+
+    int version{}; // last version sent to the server
+    text_document text{};
+    std::vector<lsptypes::text_change> pending_changes{}; // not sent yet
+    bool full_sync_pending{false};
+    lsptypes::line_range edited_lines{}; // lines edited since the last whole document tokens were applied
+    lsptypes::line_range requested_lines{}; // lines asked through semanticTokens/range for the current version
+    lsptypes::line_range visible_lines{};
+    int highlighted_version{-1};
+    bool token_update_deferred{false}; // held back by the in-flight requests limit
+    clock::time_point last_visible{};
+    std::shared_ptr<const diagnostic_index> diagnostics{}; // last ones published
+    std::optional<lsptypes::position> cursor{}; // in editor coordinates, see clangd_server::set_cursor
+    clock::time_point cursor_moved{};
+    bool cursor_prefetched{false};
+
+    edit_scheduler scheduler;
+    // C family documents only, highlights edits right away. Kept when the document is closed, it is cheap
+    std::optional<lexical_highlighter> lexer{};
+
+    struct pending_tokens_request {
+        std::string id{};
+        bool is_range{false};
+    };
+    std::vector<pending_tokens_request> pending_token_requests{};
+    std::shared_ptr<document_tokens> tokens;
+
+    // large files only, tokens applied a few lines per frame, see server_options::large_file_tokens_per_frame
+    struct partial_tokens {
+        token_store tokens{};
+        unsigned int next_line{};
+        int version{};
+    };
+    std::optional<partial_tokens> tokens_to_apply{};
+    token_decorations decorations{}; // of the tokens applied to the editor
+};
+
+// Owns the documents of every editor bound to a server, and picks the ones to close when too many are open
+class document_manager {
+public:
+    managed_document& add(ImEdit::editor& editor, std::string uri, std::string language_id, edit_scheduler scheduler);
+    void remove(const ImEdit::editor& editor);
+
+    [[nodiscard]] managed_document* find(const ImEdit::editor& editor) const noexcept;
+    [[nodiscard]] managed_document* find(std::uint64_t id) const noexcept;
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return _documents.size();
+    }
+
+    template <typename FuncT>
+    void for_each(FuncT&& func) const {
+        for (const std::unique_ptr<managed_document>& document : _documents) {
+            func(*document);
+        }
+    }
+
+    // Open documents to close, least recently visible first, so that at most max_open stay open and their memory
+    // fits in memory_budget. Documents visible since keep_after are never picked, even if the budgets are exceeded
+    [[nodiscard]] std::vector<managed_document*> eviction_candidates(std::size_t max_open, std::size_t memory_budget,
+                                                                     managed_document::clock::time_point keep_after) const;
+
+private:
+    std::vector<std::unique_ptr<managed_document>> _documents{};
+    std::uint64_t _next_id{1};
+};
+
+
+#endif //IMEDIT_LS_DOCUMENT_MANAGER_H
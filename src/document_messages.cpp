@@ -0,0 +1,116 @@
+#include "document_messages.h"
+
+#include <string>
+
+namespace {
+    // bytes added by escaping the character in a JSON string
+    unsigned int escape_overhead(char c) noexcept {
+        switch (c) {
+            case '"':
+            case '\\':
+            case '\b':
+            case '\f':
+            case '\n':
+            case '\r':
+            case '\t':
+                return 1;
+            default:
+                return static_cast<unsigned char>(c) < 0x20u ? 5 : 0;
+        }
+    }
+
+    std::string escape_sequence(char c) {
+        switch (c) {
+            case '"':
+                return "\\\"";
+            case '\\':
+                return "\\\\";
+            case '\b':
+                return "\\b";
+            case '\f':
+                return "\\f";
+            case '\n':
+                return "\\n";
+            case '\r':
+                return "\\r";
+            case '\t':
+                return "\\t";
+            default: {
+                constexpr std::string_view digits = "0123456789abcdef";
+                auto byte = static_cast<unsigned char>(c);
+                return std::string{"\\u00"} + digits[byte >> 4u] + digits[byte & 0xFu];
+            }
+        }
+    }
+
+    void put(std::streambuf& out, std::string_view data) {
+        out.sputn(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    // writes str as the content of a JSON string, unescaped runs in one go
+    void put_escaped(std::streambuf& out, std::string_view str) {
+        std::size_t run_start = 0;
+        for (std::size_t i = 0 ; i < str.size() ; ++i) {
+            if (escape_overhead(str[i]) != 0) {
+                put(out, str.substr(run_start, i - run_start));
+                put(out, escape_sequence(str[i]));
+                run_start = i + 1;
+            }
+        }
+        put(out, str.substr(run_start));
+    }
+
+    void append_escaped(std::string& str, std::string_view value) {
+        for (char c : value) {
+            if (escape_overhead(c) != 0) {
+                str += escape_sequence(c);
+            } else {
+                str += c;
+            }
+        }
+    }
+
+    // size of the text once escaped, without building it
+    std::size_t escaped_size(const text_rope& text) {
+        // the '\n' between lines take two bytes each
+        std::size_t size = text.byte_size() + (text.line_count() > 0 ? text.line_count() - 1 : 0);
+        text.for_each_line(0, text.line_count(), [&size](std::string_view line) {
+            for (char c : line) {
+                size += escape_overhead(c);
+            }
+        });
+        return size;
+    }
+
+    // head and tail surround the text, which is a JSON string's content
+    void write_message(std::streambuf& out, std::string_view head, const text_rope& text, std::string_view tail) {
+        std::size_t body_size = head.size() + escaped_size(text) + tail.size();
+        put(out, "Content-Length: " + std::to_string(body_size) + "\r\n\r\n");
+        put(out, head);
+        bool first = true;
+        text.for_each_line(0, text.line_count(), [&out, &first](std::string_view line) {
+            if (!first) {
+                put(out, "\\n");
+            }
+            put_escaped(out, line);
+            first = false;
+        });
+        put(out, tail);
+    }
+}
+
+void write_did_open(std::streambuf& out, std::string_view uri, std::string_view language_id, int version, const text_rope& text) {
+    std::string head = R"({"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":")";
+    append_escaped(head, uri);
+    head += R"(","languageId":")";
+    append_escaped(head, language_id);
+    head += R"(","version":)" + std::to_string(version) + R"(,"text":")";
+    write_message(out, head, text, R"("}}})");
+}
+
+void write_full_did_change(std::streambuf& out, std::string_view uri, int version, const text_rope& text) {
+    std::string head = R"({"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":")";
+    append_escaped(head, uri);
+    head += R"(","version":)" + std::to_string(version) + R"(},"contentChanges":[{"text":")";
+    write_message(out, head, text, R"("}]}})");
+}
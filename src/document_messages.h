@@ -0,0 +1,18 @@
+#ifndef IMEDIT_LS_DOCUMENT_MESSAGES_H
+#define IMEDIT_LS_DOCUMENT_MESSAGES_H
+
+#include <streambuf>
+#include <string_view>
+
+#include "text_rope.h"
+
+// Notifications carrying the whole text of a document, framed and written to out straight from a rope snapshot,
+// a few lines at a time: neither the text nor its JSON are ever assembled in memory. uri is sent as is.
+
+void write_did_open(std::streambuf& out, std::string_view uri, std::string_view language_id, int version, const text_rope& text);
+
+// didChange replacing the whole text
+void write_full_did_change(std::streambuf& out, std::string_view uri, int version, const text_rope& text);
+
+
+#endif //IMEDIT_LS_DOCUMENT_MESSAGES_H
@@ -0,0 +1,53 @@
+#ifndef IMEDIT_LS_EDIT_SCHEDULER_H
+#define IMEDIT_LS_EDIT_SCHEDULER_H
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
+// Decides when buffered edits should be sent to the server: once no edit happened for 'debounce',
+// or once the oldest buffered edit is 'max_delay' old, so that long typing bursts still get feedback
+class edit_scheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    edit_scheduler(clock::duration debounce, clock::duration max_delay) noexcept
+        : _debounce{debounce}, _max_delay{max_delay} {}
+
+    void edit_happened(clock::time_point now) noexcept {
+        if (!_first_edit) {
+            _first_edit = now;
+        }
+        _last_edit = now;
+    }
+
+    [[nodiscard]] bool has_pending_edits() const noexcept {
+        return _first_edit.has_value();
+    }
+
+    [[nodiscard]] std::optional<clock::time_point> flush_deadline() const noexcept {
+        if (!_first_edit) {
+            return {};
+        }
+        return std::min(_last_edit + _debounce, *_first_edit + _max_delay);
+    }
+
+    [[nodiscard]] bool flush_due(clock::time_point now) const noexcept {
+        auto deadline = flush_deadline();
+        return deadline && *deadline <= now;
+    }
+
+    void flushed() noexcept {
+        _first_edit.reset();
+    }
+
+private:
+    clock::duration _debounce;
+    clock::duration _max_delay;
+
+    std::optional<clock::time_point> _first_edit{};
+    clock::time_point _last_edit{};
+};
+
+
+#endif //IMEDIT_LS_EDIT_SCHEDULER_H
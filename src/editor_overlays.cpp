@@ -0,0 +1,149 @@
+#include "editor_overlays.h"
+#include "clangd_server.h"
+
+#include <imedit/editor.h>
+#include <imgui.h>
+
+#include <algorithm>
+#include <string_view>
+
+namespace {
+    constexpr ImGuiWindowFlags popup_flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize
+                                             | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav
+                                             | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoMove;
+
+    void text(std::string_view str) {
+        ImGui::TextUnformatted(str.data(), str.data() + str.size());
+    }
+
+    ImU32 severity_colour(lsptypes::diagnostic_severity severity) noexcept {
+        switch (severity) {
+            case lsptypes::diagnostic_severity::error:
+                return ImColor(240, 70, 70, 255);
+            case lsptypes::diagnostic_severity::warning:
+                return ImColor(230, 180, 40, 255);
+            case lsptypes::diagnostic_severity::information:
+                return ImColor(80, 160, 240, 255);
+            case lsptypes::diagnostic_severity::hint:
+                break;
+        }
+        return ImColor(150, 150, 150, 255);
+    }
+
+    // zigzag from x_first to x_last, right above baseline
+    void draw_squiggle(ImDrawList& draw_list, float x_first, float x_last, float baseline, ImU32 colour) {
+        constexpr float step = 3;
+        constexpr float height = 2;
+        bool up = true;
+        for (float x = x_first ; x < x_last ; x += step) {
+            const float next = std::min(x + step, x_last);
+            draw_list.AddLine({x, up ? baseline : baseline - height}, {next, up ? baseline - height : baseline}, colour);
+            up = !up;
+        }
+    }
+}
+
+void show_completion_popup(clangd_server& server, const editor_geometry& geometry, std::size_t max_shown) {
+    const completion_cache& completions = server.completions();
+    const std::vector<std::uint32_t>& matches = completions.matches();
+    if (matches.empty()) {
+        return;
+    }
+
+    const std::size_t shown = std::min(matches.size(), max_shown);
+    server.completion_items_shown(0, shown);
+
+    const lsptypes::position anchor = completions.anchor();
+    ImGui::SetNextWindowPos(geometry.glyph_position(anchor.line + 1, anchor.character));
+    if (ImGui::Begin("##completions", nullptr, popup_flags)) {
+        for (std::size_t i = 0 ; i < shown ; ++i) {
+            const lsptypes::completion_item& item = completions.item(matches[i]);
+            text(item.label);
+            if (!item.detail.empty()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("%s", item.detail.c_str());
+            }
+        }
+
+        const lsptypes::completion_item& best = completions.item(matches.front());
+        if (!best.documentation.empty()) {
+            ImGui::Separator();
+            ImGui::PushTextWrapPos(geometry.glyph_width * 80);
+            text(best.documentation);
+            ImGui::PopTextWrapPos();
+        }
+    }
+    ImGui::End();
+}
+
+void draw_diagnostics(const clangd_server& server, const ImEdit::editor& editor, const editor_geometry& geometry,
+                      lsptypes::line_range lines, std::vector<lsptypes::diagnostic_mark>& marks) {
+    server.visible_diagnostics(editor, lines, marks);
+    if (marks.empty()) {
+        return;
+    }
+
+    ImDrawList& draw_list = *ImGui::GetWindowDrawList();
+    const float margin_left = ImGui::GetWindowPos().x;
+    const float margin_right = std::max(margin_left, geometry.origin.x - 2);
+    const ImVec2 mouse = ImGui::GetIO().MousePos;
+    const lsptypes::diagnostic* hovered = nullptr;
+    for (const lsptypes::diagnostic_mark& mark : marks) {
+        const ImU32 colour = severity_colour(mark.severity);
+        // empty ranges are widened to a glyph, so that they can be seen
+        const ImVec2 first = geometry.glyph_position(mark.line, mark.first);
+        const ImVec2 last = geometry.glyph_position(mark.line, std::max(mark.last, mark.first + 1));
+        const float bottom = first.y + geometry.line_height;
+
+        draw_squiggle(draw_list, first.x, last.x, bottom - 1, colour);
+        draw_list.AddRectFilled({margin_left, first.y}, {margin_right, bottom}, colour);
+        if (mouse.x >= first.x && mouse.x < last.x && mouse.y >= first.y && mouse.y < bottom) {
+            hovered = mark.source;
+        }
+    }
+
+    if (hovered != nullptr && ImGui::IsWindowHovered()) {
+        ImGui::BeginTooltip();
+        ImGui::PushTextWrapPos(geometry.glyph_width * 80);
+        text(hovered->message);
+        ImGui::PopTextWrapPos();
+        ImGui::EndTooltip();
+    }
+}
+
+void draw_token_decorations(const clangd_server& server, const ImEdit::editor& editor, const editor_geometry& geometry,
+                            lsptypes::line_range lines, std::vector<lsptypes::decoration_mark>& marks) {
+    server.visible_decorations(editor, lines, marks);
+    if (marks.empty()) {
+        return;
+    }
+
+    ImDrawList& draw_list = *ImGui::GetWindowDrawList();
+    const ImU32 colour = ImColor(200, 200, 200, 200);
+    for (const lsptypes::decoration_mark& mark : marks) {
+        const ImVec2 first = geometry.glyph_position(mark.line, mark.first);
+        const ImVec2 last = geometry.glyph_position(mark.line, mark.last);
+        const float y = mark.decoration == lsptypes::token_decoration::deprecated
+                ? first.y + geometry.line_height / 2
+                : first.y + geometry.line_height - 2;
+        draw_list.AddLine({first.x, y}, {last.x, y}, colour);
+    }
+}
+
+void show_hover_tooltip(clangd_server& server, ImEdit::editor& editor, const editor_geometry& geometry) {
+    const std::optional<ImEdit::coordinates> position = geometry.glyph_at(ImGui::GetIO().MousePos);
+    if (!position || position->line >= editor_line_count(editor) || position->char_index >= editor._lines[position->line].size()) {
+        return;
+    }
+
+    // asked on the first call, shown by the first one after the answer came
+    const lsptypes::symbol_answer* answer = server.query_symbol(editor, *position, lsptypes::symbol_query::hover);
+    if (answer == nullptr || answer->text.empty()) {
+        return;
+    }
+    ImGui::BeginTooltip();
+    ImGui::PushTextWrapPos(geometry.glyph_width * 80);
+    text(answer->text);
+    ImGui::PopTextWrapPos();
+    ImGui::EndTooltip();
+}
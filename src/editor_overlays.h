@@ -0,0 +1,39 @@
+#ifndef IMEDIT_LS_EDITOR_OVERLAYS_H
+#define IMEDIT_LS_EDITOR_OVERLAYS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "diagnostics.h"
+#include "editor_text.h"
+#include "token_store.h"
+
+namespace ImEdit {
+    class editor;
+}
+
+class clangd_server;
+
+// Overlays drawn over an editor from what its server sent, in windows of their own. geometry is the editor's, as
+// taken for its last render
+
+// Lists the best matches of the word being completed under it, with the details of the first one. The server is
+// asked for the details of the matches shown
+void show_completion_popup(clangd_server& server, const editor_geometry& geometry, std::size_t max_shown = 12);
+
+// Underlines the parts of the given lines the diagnostics are about, coloured by severity, and marks these lines in
+// the window's left padding. The message of the diagnostic under the mouse is shown in a tooltip. To be called in the
+// editor's window, right after rendering it. marks is scratch space, kept from one frame to the next
+void draw_diagnostics(const clangd_server& server, const ImEdit::editor& editor, const editor_geometry& geometry,
+                      lsptypes::line_range lines, std::vector<lsptypes::diagnostic_mark>& marks);
+
+// Strikes through the deprecated symbols of the given lines and underlines the static ones. To be called in the
+// editor's window, right after rendering it. marks is scratch space, kept from one frame to the next
+void draw_token_decorations(const clangd_server& server, const ImEdit::editor& editor, const editor_geometry& geometry,
+                            lsptypes::line_range lines, std::vector<lsptypes::decoration_mark>& marks);
+
+// Shows the hover of the symbol under the mouse in a tooltip, once the server answered about it
+void show_hover_tooltip(clangd_server& server, ImEdit::editor& editor, const editor_geometry& geometry);
+
+
+#endif //IMEDIT_LS_EDITOR_OVERLAYS_H
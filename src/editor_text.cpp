@@ -0,0 +1,84 @@
+#include "editor_text.h"
+
+#include <imedit/editor.h>
+#include <imgui.h>
+
+#include <algorithm>
+
+std::string to_utf8(const ImEdit::line& line) {
+    std::string str;
+    str.reserve(line.size());
+    for (const auto& glyph : line) {
+        str.append(glyph.cp.begin(), glyph.cp.end());
+    }
+    return str;
+}
+
+std::string to_utf8(const ImEdit::line& line, std::size_t first, std::size_t last) {
+    std::string str;
+    last = std::min(last, line.size());
+    for (std::size_t i = first ; i < last ; ++i) {
+        str.append(line[i].cp.begin(), line[i].cp.end());
+    }
+    return str;
+}
+
+unsigned int glyph_index(const ImEdit::line& line, unsigned int character, lsptypes::encoding enc) noexcept {
+    unsigned int units = 0;
+    for (std::size_t i = 0 ; i < line.size() ; ++i) {
+        if (units >= character) {
+            return static_cast<unsigned int>(i);
+        }
+        units += lsptypes::encoded_length(line[i].cp, enc);
+    }
+    return static_cast<unsigned int>(line.size());
+}
+
+unsigned int editor_line_count(const ImEdit::editor& ed) {
+    return static_cast<unsigned int>(ed._lines.size());
+}
+
+std::vector<std::string> editor_lines(const ImEdit::editor& ed, unsigned int first_line, unsigned int count) {
+    std::vector<std::string> lines;
+    lines.reserve(count);
+    for (unsigned int i = first_line ; i < first_line + count && i < ed._lines.size() ; ++i) {
+        lines.emplace_back(to_utf8(ed._lines[i]));
+    }
+    return lines;
+}
+
+std::vector<std::string> editor_lines(const ImEdit::editor& ed) {
+    return editor_lines(ed, 0, editor_line_count(ed));
+}
+
+lsptypes::line_range editor_visible_lines(const ImEdit::editor& ed) {
+    const float line_height = ImGui::GetTextLineHeightWithSpacing();
+    auto first = static_cast<unsigned int>(ImGui::GetScrollY() / line_height);
+    auto count = static_cast<unsigned int>(ed._height / line_height) + 1;
+    return {first, first + count};
+}
+
+std::optional<ImEdit::coordinates> editor_cursor(const ImEdit::editor& ed) {
+    if (ed._cursors.empty()) {
+        return {};
+    }
+    return ed._cursors.front().coord;
+}
+
+std::optional<ImEdit::coordinates> editor_geometry::glyph_at(ImVec2 point) const noexcept {
+    if (point.x < origin.x || point.y < origin.y || line_height <= 0 || glyph_width <= 0) {
+        return {};
+    }
+    ImEdit::coordinates coords{};
+    coords.line = static_cast<unsigned int>((point.y - origin.y) / line_height);
+    coords.char_index = static_cast<unsigned int>((point.x - origin.x) / glyph_width);
+    return coords;
+}
+
+editor_geometry current_editor_geometry() {
+    return {
+            .origin = ImGui::GetCursorScreenPos(),
+            .line_height = ImGui::GetTextLineHeightWithSpacing(),
+            .glyph_width = ImGui::CalcTextSize(" ").x
+    };
+}
@@ -0,0 +1,61 @@
+#ifndef IMEDIT_LS_EDITOR_TEXT_H
+#define IMEDIT_LS_EDITOR_TEXT_H
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <imedit/simple_types.h>
+#include <imgui.h>
+
+#include "semantic_tokens.h"
+#include "text_document.h"
+
+namespace ImEdit {
+    class editor;
+}
+
+// Helpers reading the editor's content line per line, in utf-8
+
+[[nodiscard]] std::string to_utf8(const ImEdit::line& line);
+
+// glyphs [first, last) of the line
+[[nodiscard]] std::string to_utf8(const ImEdit::line& line, std::size_t first, std::size_t last);
+
+// Index of the glyph at the given position of the line, counted in code units of the given encoding. The size of
+// the line if past its end
+[[nodiscard]] unsigned int glyph_index(const ImEdit::line& line, unsigned int character, lsptypes::encoding enc) noexcept;
+
+[[nodiscard]] unsigned int editor_line_count(const ImEdit::editor& ed);
+
+[[nodiscard]] std::vector<std::string> editor_lines(const ImEdit::editor& ed, unsigned int first_line, unsigned int count);
+
+[[nodiscard]] std::vector<std::string> editor_lines(const ImEdit::editor& ed);
+
+// Lines of the editor shown in the current ImGui window, to be called right after rendering the editor
+[[nodiscard]] lsptypes::line_range editor_visible_lines(const ImEdit::editor& ed);
+
+// position of the main cursor, empty if the editor has none
+[[nodiscard]] std::optional<ImEdit::coordinates> editor_cursor(const ImEdit::editor& ed);
+
+// Where the editor draws its glyphs in the current ImGui window, in screen coordinates. Like editor_visible_lines,
+// it counts on the lines being drawn from the window's cursor with the monospace font of the window
+struct editor_geometry {
+    ImVec2 origin{}; // top left corner of the first glyph of the first line
+    float line_height{};
+    float glyph_width{};
+
+    // top left corner of the glyph
+    [[nodiscard]] ImVec2 glyph_position(unsigned int line, unsigned int glyph) const noexcept {
+        return {origin.x + static_cast<float>(glyph) * glyph_width, origin.y + static_cast<float>(line) * line_height};
+    }
+
+    // glyph under the point, which may be past the end of its line or of the document
+    [[nodiscard]] std::optional<ImEdit::coordinates> glyph_at(ImVec2 point) const noexcept;
+};
+
+// to be called right before rendering the editor
+[[nodiscard]] editor_geometry current_editor_geometry();
+
+
+#endif //IMEDIT_LS_EDITOR_TEXT_H
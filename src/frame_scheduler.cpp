@@ -0,0 +1,33 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+void frame_scheduler::wake() {
+    // one pending event is enough to get a frame
+    if (!_wake_pending.exchange(true) && _waker) {
+        _waker();
+    }
+}
+
+std::optional<frame_scheduler::clock::duration> frame_scheduler::wait_time(clock::time_point now) const noexcept {
+    if (_frames_left > 0 || _wake_pending) {
+        return clock::duration::zero();
+    }
+    if (_deadline == clock::time_point::max()) {
+        return {};
+    }
+    return std::max(_deadline - now, clock::duration::zero());
+}
+
+void frame_scheduler::woke_up(bool got_events) noexcept {
+    // cleared before the frame, so that messages coming during it get another one
+    _wake_pending = false;
+    _frames_left = std::max({_frames_left, got_events ? _settle_frames : 0u, 1u});
+}
+
+void frame_scheduler::frame_done() noexcept {
+    ++_frame_count;
+    --_frames_left;
+    _deadline = std::exchange(_next_deadline, clock::time_point::max());
+}
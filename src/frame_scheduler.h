@@ -0,0 +1,59 @@
+#ifndef IMEDIT_LS_FRAME_SCHEDULER_H
+#define IMEDIT_LS_FRAME_SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+// Decides when the render loop draws: after input, after messages from the language servers, and at the deadlines
+// of their timers or of animations. In between, the loop blocks on the window's event queue and draws nothing.
+class frame_scheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // settle_frames are drawn after each input, as ImGui needs a frame or two to show its effects
+    explicit frame_scheduler(unsigned int settle_frames = 2) noexcept : _settle_frames{settle_frames} {}
+
+    // Called by wake to interrupt the wait for events, pushing an event to the window's queue for instance. Must be
+    // set before wake is called from any other thread
+    void set_waker(std::function<void()> waker) {
+        _waker = std::move(waker);
+    }
+
+    // From any thread: a frame is needed as soon as possible. Wake-ups are coalesced until the loop wakes up
+    void wake();
+
+    // a frame is needed at deadline, during the current frame: deadlines are given again every frame
+    void schedule(clock::time_point deadline) noexcept {
+        _next_deadline = std::min(_next_deadline, deadline);
+    }
+
+    // How long the loop may wait for events before drawing, empty if it may wait for as long as none comes
+    [[nodiscard]] std::optional<clock::duration> wait_time(clock::time_point now) const noexcept;
+
+    // The loop stopped waiting, because events came if got_events. A frame is drawn after each wake-up
+    void woke_up(bool got_events) noexcept;
+
+    // to be called once the frame was drawn
+    void frame_done() noexcept;
+
+    [[nodiscard]] std::uint64_t frame_count() const noexcept {
+        return _frame_count;
+    }
+
+private:
+    unsigned int _settle_frames;
+    std::function<void()> _waker{};
+    std::atomic_bool _wake_pending{false};
+
+    unsigned int _frames_left{1}; // drawn without waiting
+    clock::time_point _deadline{clock::time_point::max()}; // scheduled during the last frame
+    clock::time_point _next_deadline{clock::time_point::max()}; // scheduled during the current frame
+    std::uint64_t _frame_count{};
+};
+
+
+#endif //IMEDIT_LS_FRAME_SCHEDULER_H
@@ -0,0 +1,188 @@
+#include "fuzzy_matcher.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    constexpr std::size_t npos = std::string_view::npos;
+
+    constexpr int match_score = 16;
+    constexpr int consecutive_bonus = 8;
+    constexpr int exact_case_bonus = 1;
+    constexpr int gap_start_penalty = 3;
+    constexpr int gap_extension_penalty = 1;
+    constexpr int leading_penalty = 2; // per character skipped before the first match
+    constexpr std::size_t max_leading_penalized = 8;
+    constexpr int whole_match_bonus = 32;
+
+    // letters and digits get a bit each, everything else shares the last one
+    std::uint64_t char_bit(char c) noexcept {
+        if (c >= 'a' && c <= 'z') {
+            return std::uint64_t{1} << (c - 'a');
+        }
+        if (c >= '0' && c <= '9') {
+            return std::uint64_t{1} << (26 + c - '0');
+        }
+        if (c == '_') {
+            return std::uint64_t{1} << 36;
+        }
+        return std::uint64_t{1} << 63;
+    }
+
+    std::uint64_t char_set(std::string_view folded) noexcept {
+        std::uint64_t chars = 0;
+        for (char c : folded) {
+            chars |= char_bit(c);
+        }
+        return chars;
+    }
+
+    std::string fold_ascii(std::string_view text) {
+        std::string folded(text.size(), '\0');
+        std::size_t i = 0;
+#if defined(__SSE2__)
+        // bytes past 0x7F are negative, they never compare greater than 'A' - 1
+        const __m128i a_minus_one = _mm_set1_epi8('A' - 1);
+        const __m128i z_plus_one = _mm_set1_epi8('Z' + 1);
+        const __m128i case_bit = _mm_set1_epi8(0x20);
+        for (; i + 16 <= text.size() ; i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chunk, a_minus_one), _mm_cmplt_epi8(chunk, z_plus_one));
+            chunk = _mm_or_si128(chunk, _mm_and_si128(upper, case_bit));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(folded.data() + i), chunk);
+        }
+#endif
+        for (; i < text.size() ; ++i) {
+            char c = text[i];
+            folded[i] = c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+        return folded;
+    }
+
+    // position of the first c in text at or after from, npos if none
+    std::size_t find_char(std::string_view text, std::size_t from, char c) noexcept {
+#if defined(__SSE2__)
+        const __m128i needle = _mm_set1_epi8(c);
+        for (; from + 16 <= text.size() ; from += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + from));
+            auto found = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+            if (found != 0) {
+                return from + static_cast<std::size_t>(std::countr_zero(found));
+            }
+        }
+#endif
+        for (; from < text.size() ; ++from) {
+            if (text[from] == c) {
+                return from;
+            }
+        }
+        return npos;
+    }
+
+    bool is_lower(char c) noexcept {
+        return c >= 'a' && c <= 'z';
+    }
+
+    bool is_upper(char c) noexcept {
+        return c >= 'A' && c <= 'Z';
+    }
+
+    bool is_digit(char c) noexcept {
+        return c >= '0' && c <= '9';
+    }
+
+    bool is_alnum(char c) noexcept {
+        return is_lower(c) || is_upper(c) || is_digit(c) || static_cast<unsigned char>(c) >= 0x80;
+    }
+
+    // matches starting a word of the candidate are worth more: first character, after a separator, camelCase hump
+    int boundary_bonus(std::string_view text, std::size_t i) noexcept {
+        if (i == 0) {
+            return 10;
+        }
+        char previous = text[i - 1];
+        char current = text[i];
+        if (!is_alnum(previous)) {
+            return 9;
+        }
+        if (is_lower(previous) && is_upper(current)) {
+            return 8;
+        }
+        if (!is_digit(previous) && is_digit(current)) {
+            return 6;
+        }
+        return 0;
+    }
+}
+
+fuzzy_candidate::fuzzy_candidate(std::string_view text)
+    : _text{text}
+    , _folded{fold_ascii(text)}
+    , _chars{char_set(_folded)}
+{}
+
+fuzzy_matcher::fuzzy_matcher(std::string_view pattern)
+    : _pattern{pattern}
+    , _folded{fold_ascii(pattern)}
+    , _chars{char_set(_folded)}
+{}
+
+std::optional<int> fuzzy_matcher::score(const fuzzy_candidate& candidate) const noexcept {
+    if ((_chars & ~candidate._chars) != 0) {
+        return {};
+    }
+    if (_folded.empty()) {
+        return 0;
+    }
+
+    const std::string_view folded = candidate._folded;
+    const std::string_view text = candidate._text;
+
+    // leftmost match, to find where the shortest one ends
+    std::size_t end = 0;
+    for (char c : _folded) {
+        end = find_char(folded, end, c);
+        if (end == npos) {
+            return {};
+        }
+        ++end;
+    }
+
+    // then backward from there, to find where it starts
+    std::size_t start = end;
+    for (auto c = _folded.rbegin() ; c != _folded.rend() ; ++c) {
+        do {
+            --start;
+        } while (folded[start] != *c);
+    }
+
+    int score = -leading_penalty * static_cast<int>(std::min(start, max_leading_penalized));
+    int consecutive = 0;
+    bool in_gap = false;
+    std::size_t p = 0;
+    for (std::size_t i = start ; i < end ; ++i) {
+        if (p < _folded.size() && folded[i] == _folded[p]) {
+            int bonus = boundary_bonus(text, i);
+            score += match_score + (consecutive > 0 ? std::max(bonus, consecutive_bonus) : bonus);
+            if (text[i] == _pattern[p]) {
+                score += exact_case_bonus;
+            }
+            ++consecutive;
+            in_gap = false;
+            ++p;
+        } else {
+            score -= in_gap ? gap_extension_penalty : gap_start_penalty;
+            consecutive = 0;
+            in_gap = true;
+        }
+    }
+
+    if (_folded.size() == folded.size()) {
+        score += whole_match_bonus;
+    }
+    return score;
+}
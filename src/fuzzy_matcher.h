@@ -0,0 +1,46 @@
+#ifndef IMEDIT_LS_FUZZY_MATCHER_H
+#define IMEDIT_LS_FUZZY_MATCHER_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// A string fuzzy patterns are matched against, prepared once for the many patterns typed while it is a candidate
+class fuzzy_candidate {
+public:
+    explicit fuzzy_candidate(std::string_view text);
+
+    [[nodiscard]] const std::string& text() const noexcept {
+        return _text;
+    }
+
+private:
+    friend class fuzzy_matcher;
+
+    std::string _text;
+    std::string _folded; // ascii lowercase
+    std::uint64_t _chars{}; // set of the characters of _folded, see char_bit
+};
+
+// Case insensitive subsequence matching, ranking word starts and consecutive characters first
+class fuzzy_matcher {
+public:
+    explicit fuzzy_matcher(std::string_view pattern);
+
+    // Higher is better, empty if the pattern is not a subsequence of the candidate. Candidates missing any
+    // character of the pattern are rejected with a single mask test
+    [[nodiscard]] std::optional<int> score(const fuzzy_candidate& candidate) const noexcept;
+
+    [[nodiscard]] const std::string& pattern() const noexcept {
+        return _pattern;
+    }
+
+private:
+    std::string _pattern;
+    std::string _folded;
+    std::uint64_t _chars{};
+};
+
+
+#endif //IMEDIT_LS_FUZZY_MATCHER_H
@@ -0,0 +1,117 @@
+#include "lexical_highlighter.h"
+#include "editor_text.h"
+
+#include <imedit/editor.h>
+
+#include <algorithm>
+
+void lexical_highlighter::lines_replaced(ImEdit::editor& ed, unsigned int first_line, unsigned int old_line_count,
+                                         unsigned int new_line_count, lsptypes::line_range visible_lines) {
+    const auto line_count = static_cast<unsigned int>(_lines.size());
+    if (first_line >= line_count || first_line + old_line_count > line_count || new_line_count == 0
+        || editor_line_count(ed) != line_count - old_line_count + new_line_count) {
+        reset(ed, visible_lines);
+        return;
+    }
+
+    // the state the line following the edit used to start in, if known
+    const unsigned int next_line = first_line + old_line_count;
+    const bool old_state_known = next_line < _valid_until && next_line < line_count;
+    const lsptypes::lexer_state old_next_state = old_state_known ? _lines[next_line].state : lsptypes::lexer_state::code;
+
+    const unsigned int old_valid_until = _valid_until;
+
+    // the first line still starts in the same state
+    const lsptypes::lexer_state first_state = _lines[first_line].state;
+    auto first = _lines.erase(_lines.begin() + first_line, _lines.begin() + first_line + old_line_count);
+    _lines.insert(first, new_line_count, line_info{});
+    _lines[first_line].state = first_state;
+    _valid_until = std::min(_valid_until, first_line + 1);
+
+    const unsigned int new_next_line = first_line + new_line_count;
+    highlight(ed, {first_line, new_next_line});
+    if (new_next_line >= _lines.size()) {
+        return;
+    }
+
+    if (old_state_known && state_at(ed, new_next_line) == old_next_state) {
+        // the states known past the edit still hold, they only moved along with their lines
+        _valid_until = std::max(_valid_until, old_valid_until - old_line_count + new_line_count);
+        return;
+    }
+
+    // a comment or string was opened or closed: the following lines change too
+    highlight(ed, {new_next_line, std::max(new_next_line, visible_lines.last)});
+    for (unsigned int line = std::max(new_next_line, visible_lines.last) ; line < _lines.size() ; ++line) {
+        _lines[line].highlighted = false;
+    }
+}
+
+void lexical_highlighter::reset(ImEdit::editor& ed, lsptypes::line_range visible_lines) {
+    _lines.assign(editor_line_count(ed), line_info{});
+    _valid_until = 1;
+    highlight(ed, visible_lines);
+}
+
+void lexical_highlighter::highlight_new_lines(ImEdit::editor& ed, lsptypes::line_range lines) {
+    check_line_count(ed);
+    const auto last = std::min(lines.last, static_cast<unsigned int>(_lines.size()));
+    for (unsigned int line = lines.first ; line < last ; ++line) {
+        if (!_lines[line].highlighted) {
+            highlight(ed, {line, line + 1});
+        }
+    }
+}
+
+void lexical_highlighter::line_tokens(const ImEdit::editor& ed, unsigned int line, std::vector<ImEdit::token_view>& tokens) {
+    check_line_count(ed);
+    tokens.clear();
+    if (line >= _lines.size()) {
+        return;
+    }
+    lexed(line, lex_cpp_line(ed._lines[line], state_at(ed, line), &tokens));
+    _lines[line].highlighted = true;
+}
+
+void lexical_highlighter::check_line_count(const ImEdit::editor& ed) {
+    if (_lines.size() != editor_line_count(ed)) {
+        _lines.assign(editor_line_count(ed), line_info{});
+        _valid_until = 1;
+    }
+}
+
+void lexical_highlighter::highlight(ImEdit::editor& ed, lsptypes::line_range lines) {
+    lines.last = std::min(lines.last, static_cast<unsigned int>(_lines.size()));
+    if (lines.empty()) {
+        return;
+    }
+
+    lsptypes::lexer_state state = state_at(ed, lines.first);
+    for (unsigned int line = lines.first ; line < lines.last ; ++line) {
+        _tokens.clear();
+        state = lex_cpp_line(ed._lines[line], state, &_tokens);
+        lexed(line, state);
+
+        ed.clear_tokens(line);
+        for (const ImEdit::token_view& token : _tokens) {
+            ed.add_token(line, token);
+        }
+        _lines[line].highlighted = true;
+    }
+}
+
+lsptypes::lexer_state lexical_highlighter::state_at(const ImEdit::editor& ed, unsigned int line) {
+    // only the states are needed on the way
+    while (_valid_until <= line) {
+        const unsigned int previous = _valid_until - 1;
+        lexed(previous, lex_cpp_line(ed._lines[previous], _lines[previous].state, nullptr));
+    }
+    return _lines[line].state;
+}
+
+void lexical_highlighter::lexed(unsigned int line, lsptypes::lexer_state next_state) noexcept {
+    if (line + 1 == _valid_until && _valid_until < _lines.size()) {
+        _lines[_valid_until].state = next_state;
+        ++_valid_until;
+    }
+}
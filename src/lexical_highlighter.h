@@ -0,0 +1,57 @@
+#ifndef IMEDIT_LS_LEXICAL_HIGHLIGHTER_H
+#define IMEDIT_LS_LEXICAL_HIGHLIGHTER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <imedit/simple_types.h>
+
+#include "cpp_lexer.h"
+#include "semantic_tokens.h"
+
+namespace ImEdit {
+    class editor;
+}
+
+// Highlights a document with the built-in lexer while its semantic tokens are on their way. The lexer state at
+// the start of each line is kept, so that edited and newly shown lines are lexed on their own.
+class lexical_highlighter {
+public:
+    // Mirrors the replacement of old_line_count lines by new_line_count lines of the editor, starting at first_line,
+    // and highlights the new lines. Visible lines after them are highlighted again if the edit changed their state.
+    void lines_replaced(ImEdit::editor& ed, unsigned int first_line, unsigned int old_line_count, unsigned int new_line_count,
+                        lsptypes::line_range visible_lines);
+
+    // The whole content of the editor changed
+    void reset(ImEdit::editor& ed, lsptypes::line_range visible_lines);
+
+    // Highlights the given lines that were never highlighted, lexically or semantically
+    void highlight_new_lines(ImEdit::editor& ed, lsptypes::line_range lines);
+
+    // Lexer tokens of the line, for semantic tokens to be merged with. The line counts as highlighted afterward
+    void line_tokens(const ImEdit::editor& ed, unsigned int line, std::vector<ImEdit::token_view>& tokens);
+
+    [[nodiscard]] std::size_t memory_usage() const noexcept {
+        return _lines.capacity() * sizeof(line_info) + _tokens.capacity() * sizeof(ImEdit::token_view);
+    }
+
+private:
+    struct line_info {
+        lsptypes::lexer_state state{lsptypes::lexer_state::code}; // at the start of the line
+        bool highlighted{false};
+    };
+
+    // starts over if the editor's line count does not match ours
+    void check_line_count(const ImEdit::editor& ed);
+    void highlight(ImEdit::editor& ed, lsptypes::line_range lines);
+    [[nodiscard]] lsptypes::lexer_state state_at(const ImEdit::editor& ed, unsigned int line);
+    // state the line after line starts in, as found by lexing line
+    void lexed(unsigned int line, lsptypes::lexer_state next_state) noexcept;
+
+    std::vector<line_info> _lines{};
+    unsigned int _valid_until{1}; // states of the lines before are up to date, the first line always starts in code
+    std::vector<ImEdit::token_view> _tokens{};
+};
+
+
+#endif //IMEDIT_LS_LEXICAL_HIGHLIGHTER_H
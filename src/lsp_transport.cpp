@@ -0,0 +1,409 @@
+#include "lsp_transport.h"
+#include "traffic_recorder.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+    constexpr std::string_view content_length_header = "Content-Length:";
+    constexpr std::string_view header_end = "\r\n\r\n";
+    constexpr std::size_t max_key_length = 16;
+
+    // body chunks at least this big are written directly from the caller's memory instead of being copied
+    constexpr std::size_t direct_write_threshold = 16 * 1024;
+
+    bool is_blank(char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    std::size_t parse_content_length(std::string_view header) noexcept {
+        std::size_t content_length = 0;
+        while (!header.empty()) {
+            auto line_end = header.find("\r\n");
+            std::string_view line = header.substr(0, line_end);
+            if (line.starts_with(content_length_header)) {
+                line.remove_prefix(content_length_header.size());
+                while (!line.empty() && is_blank(line.front())) {
+                    line.remove_prefix(1);
+                }
+                std::from_chars(line.data(), line.data() + line.size(), content_length);
+            }
+            if (line_end == std::string_view::npos) {
+                break;
+            }
+            header.remove_prefix(line_end + 2);
+        }
+        return content_length;
+    }
+}
+
+lsptypes::request_id_scanner::feed_result lsptypes::request_id_scanner::feed(std::string_view data) noexcept {
+    std::size_t i = 0;
+    while (i < data.size() && _state == state::header) {
+        feed_header(data[i++]);
+    }
+
+    while (i < data.size() && _state == state::body) {
+        std::size_t body_left = _content_length - _body_read;
+        std::size_t available = std::min(body_left, data.size() - i);
+
+        if (_has_id && _has_method) {
+            // nothing more to learn from this message
+            i += available;
+            _body_read += available;
+        } else if (_in_string && !_reading_key && !_reading_id && !_reading_method && !_escaped) {
+            // skip string contents in one go, they are the bulk of large messages
+            std::string_view chunk = data.substr(i, available);
+            auto special = chunk.find_first_of("\"\\");
+            std::size_t skipped = special == std::string_view::npos ? chunk.size() : special;
+            i += skipped;
+            _body_read += skipped;
+            if (skipped == chunk.size()) {
+                continue;
+            }
+            feed_body(data[i++]);
+            ++_body_read;
+        } else {
+            feed_body(data[i++]);
+            ++_body_read;
+        }
+
+        if (_body_read == _content_length) {
+            bool was_request = _has_method && _has_id;
+            if (was_request) {
+                _last_id = _id;
+                _last_method = _method;
+            }
+            reset_message();
+            return {.consumed = i, .message_ended = true, .was_request = was_request};
+        }
+    }
+    return {.consumed = i};
+}
+
+void lsptypes::request_id_scanner::feed_header(char c) noexcept {
+    if (c != '\n') {
+        _header_line += c;
+        return;
+    }
+
+    if (!_header_line.empty() && _header_line.back() == '\r') {
+        _header_line.pop_back();
+    }
+    if (_header_line.empty()) {
+        _state = state::body;
+        if (_content_length == 0) {
+            reset_message();
+        }
+    } else {
+        _content_length = std::max(_content_length, parse_content_length(_header_line));
+    }
+    _header_line.clear();
+}
+
+void lsptypes::request_id_scanner::feed_body(char c) noexcept {
+    if (_in_string) {
+        if (_reading_key && _key.size() < max_key_length) {
+            _key += c;
+        } else if (_reading_id) {
+            _id += c;
+        } else if (_reading_method) {
+            _method += c;
+        }
+
+        if (_escaped) {
+            _escaped = false;
+        } else if (c == '\\') {
+            _escaped = true;
+        } else if (c == '"') {
+            _in_string = false;
+            if (_reading_key) {
+                _key.pop_back();
+                _reading_key = false;
+            } else if (_reading_method) {
+                _method.pop_back();
+                _reading_method = false;
+                _has_method = true;
+            }
+        }
+        return;
+    }
+
+    switch (c) {
+        case '"':
+            _in_string = true;
+            if (_depth == 1 && _expecting_key) {
+                _reading_key = true;
+                _key.clear();
+            } else if (_reading_id) {
+                _id += c;
+            }
+            break;
+        case '{':
+        case '[':
+            ++_depth;
+            _expecting_key = _depth == 1 && c == '{';
+            break;
+        case '}':
+        case ']':
+            if (_depth == 1 && _reading_id) {
+                _reading_id = false;
+                _has_id = true;
+            }
+            --_depth;
+            break;
+        case ':':
+            if (_depth == 1) {
+                _expecting_key = false;
+                if (_key == "id") {
+                    _reading_id = true;
+                    _id.clear();
+                } else if (_key == "method") {
+                    _reading_method = true;
+                    _method.clear();
+                }
+            }
+            break;
+        case ',':
+            if (_depth == 1) {
+                if (_reading_id) {
+                    _reading_id = false;
+                    _has_id = true;
+                }
+                _expecting_key = true;
+            }
+            break;
+        default:
+            if (_reading_id && !is_blank(c)) {
+                _id += c;
+            }
+            break;
+    }
+}
+
+void lsptypes::request_id_scanner::reset_message() noexcept {
+    _state = state::header;
+    _content_length = 0;
+    _body_read = 0;
+    _depth = 0;
+    _in_string = false;
+    _escaped = false;
+    _reading_key = false;
+    _expecting_key = false;
+    _reading_id = false;
+    _reading_method = false;
+    _has_method = false;
+    _has_id = false;
+    _key.clear();
+    _id.clear();
+    _method.clear();
+}
+
+bool fd_input_buffer::has_buffered_message() noexcept {
+    return gptr() < egptr() || showmanyc() > 0;
+}
+
+fd_input_buffer::int_type fd_input_buffer::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    std::size_t offset = _next_message;
+    while (true) {
+        if (std::size_t size = complete_message_size(offset) ; size != 0) {
+            expose_message(offset, size);
+            return traits_type::to_int_type(*gptr());
+        }
+
+        // keep the beginning of the partial message at the front, so that the buffer never needs more
+        // room than the largest message
+        if (offset != 0) {
+            std::memmove(_buffer.data(), _buffer.data() + offset, _data_end - offset);
+            _data_end -= offset;
+            offset = 0;
+        }
+
+        _next_message = 0;
+
+        std::size_t needed = announced_message_size(0);
+        if (needed > _buffer.size()) {
+            _buffer.resize(needed);
+        } else if (_data_end == _buffer.size()) {
+            _buffer.resize(_buffer.size() * 2);
+        }
+        setg(_buffer.data(), _buffer.data(), _buffer.data());
+
+        ssize_t read_count = read(_fd, _buffer.data() + _data_end, _buffer.size() - _data_end);
+        if (read_count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (read_count <= 0) {
+            return traits_type::eof();
+        }
+        _data_end += static_cast<std::size_t>(read_count);
+        _bytes_read.fetch_add(static_cast<std::uint64_t>(read_count), std::memory_order_relaxed);
+    }
+}
+
+std::streamsize fd_input_buffer::showmanyc() {
+    return static_cast<std::streamsize>(complete_message_size(_next_message));
+}
+
+void fd_input_buffer::expose_message(std::size_t offset, std::size_t size) {
+    char* message = _buffer.data() + offset;
+    _next_message = offset + size;
+
+    std::string_view framed(message, size);
+    std::string_view body = framed.substr(framed.find(header_end) + header_end.size());
+    if (_recorder != nullptr) {
+        // as the server sent it, before any filtering
+        _recorder->record(lsptypes::record_kind::server_message, body);
+    }
+    if (_filter) {
+        if (auto replacement = _filter(body) ; replacement) {
+            _replacement = "Content-Length: " + std::to_string(replacement->size()) + "\r\n\r\n" + *replacement;
+            setg(_replacement.data(), _replacement.data(), _replacement.data() + _replacement.size());
+            return;
+        }
+    }
+    setg(message, message, message + size);
+}
+
+std::size_t fd_input_buffer::complete_message_size(std::size_t offset) const noexcept {
+    std::size_t size = announced_message_size(offset);
+    return (size != 0 && _data_end - offset >= size) ? size : 0;
+}
+
+std::size_t fd_input_buffer::announced_message_size(std::size_t offset) const noexcept {
+    std::string_view data(_buffer.data() + offset, _data_end - offset);
+    auto header_size = data.find(header_end);
+    if (header_size == std::string_view::npos) {
+        return 0;
+    }
+    return header_size + header_end.size() + parse_content_length(data.substr(0, header_size));
+}
+
+std::string fd_output_buffer::last_request_id() const {
+    std::lock_guard lock(_last_request_id_mutex);
+    return _last_request_id;
+}
+
+fd_output_buffer::int_type fd_output_buffer::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return traits_type::not_eof(ch);
+    }
+    char c = traits_type::to_char_type(ch);
+    return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+}
+
+std::streamsize fd_output_buffer::xsputn(const char_type* s, std::streamsize count) {
+    // held from the first byte of a message to its last, by the thread writing it
+    _message_mutex.lock();
+    ++_message_locks;
+
+    bool written = write_parts(std::string_view(s, static_cast<std::size_t>(count)));
+    if (!written) {
+        // the pipe is gone, what follows is not part of the broken message
+        _scanner = {};
+        _recorded_message.clear();
+    }
+    if (_scanner.between_messages()) {
+        for (; _message_locks > 0 ; --_message_locks) {
+            _message_mutex.unlock();
+        }
+    }
+    return written ? count : 0;
+}
+
+bool fd_output_buffer::write_parts(std::string_view data) {
+    while (!data.empty()) {
+        auto result = _scanner.feed(data);
+        std::string_view part = data.substr(0, result.consumed);
+        data.remove_prefix(result.consumed);
+
+        if (result.was_request) {
+            // recorded before the request leaves, so that its answer can never be read before its id is known
+            if (_observer) {
+                _observer(_scanner.last_id(), _scanner.last_method());
+            }
+            std::lock_guard lock(_last_request_id_mutex);
+            _last_request_id = _scanner.last_id();
+        }
+
+        if (_recorder != nullptr) {
+            record_part(part, result.message_ended);
+        }
+
+        if (part.size() >= direct_write_threshold) {
+            if (!write_out(part)) {
+                return false;
+            }
+        } else {
+            _pending.insert(_pending.end(), part.begin(), part.end());
+            // messages written in many small parts go out as they come rather than piling up
+            if ((result.message_ended || _pending.size() >= direct_write_threshold) && !write_out()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void fd_output_buffer::record_part(std::string_view part, bool message_ended) {
+    // recordings are a debugging aid, the copy only happens while recording
+    _recorded_message.append(part);
+    if (message_ended) {
+        std::string_view framed = _recorded_message;
+        auto body_start = framed.find(header_end);
+        if (body_start != std::string_view::npos) {
+            _recorder->record(lsptypes::record_kind::client_message, framed.substr(body_start + header_end.size()));
+        }
+        _recorded_message.clear();
+    }
+}
+
+int fd_output_buffer::sync() {
+    std::lock_guard lock(_message_mutex);
+    return write_out() ? 0 : -1;
+}
+
+bool fd_output_buffer::write_out(std::string_view extra) {
+    std::size_t pending_size = _pending.size();
+    std::size_t total = pending_size + extra.size();
+    std::size_t written = 0;
+
+    while (written < total) {
+        std::array<iovec, 2> iov{};
+        int iov_count = 0;
+        if (written < pending_size) {
+            iov[0] = {.iov_base = _pending.data() + written, .iov_len = pending_size - written};
+            ++iov_count;
+        }
+        std::size_t extra_offset = written > pending_size ? written - pending_size : 0;
+        if (extra_offset < extra.size()) {
+            iov[static_cast<std::size_t>(iov_count)] = {.iov_base = const_cast<char*>(extra.data() + extra_offset), .iov_len = extra.size() - extra_offset};
+            ++iov_count;
+        }
+
+        ssize_t count = writev(_fd, iov.data(), iov_count);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            _pending.clear();
+            return false;
+        }
+        written += static_cast<std::size_t>(count);
+        _bytes_written.fetch_add(static_cast<std::uint64_t>(count), std::memory_order_relaxed);
+    }
+
+    _pending.clear();
+    return true;
+}
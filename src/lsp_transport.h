@@ -0,0 +1,184 @@
+#ifndef IMEDIT_LS_LSP_TRANSPORT_H
+#define IMEDIT_LS_LSP_TRANSPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class traffic_recorder;
+
+namespace lsptypes {
+    // Streaming scanner over outgoing "Content-Length" framed JSON-RPC messages, extracting the id and method of
+    // requests without buffering their content
+    class request_id_scanner {
+    public:
+        struct feed_result {
+            std::size_t consumed{};
+            bool message_ended{false};
+            bool was_request{false};
+        };
+
+        // Consumes data up to the end of the current message
+        feed_result feed(std::string_view data) noexcept;
+
+        [[nodiscard]] const std::string& last_id() const noexcept {
+            return _last_id;
+        }
+
+        [[nodiscard]] const std::string& last_method() const noexcept {
+            return _last_method;
+        }
+
+        // true if no message was started since the last one ended
+        [[nodiscard]] bool between_messages() const noexcept {
+            return _state == state::header && _header_line.empty() && _content_length == 0;
+        }
+
+    private:
+        void feed_header(char c) noexcept;
+        void feed_body(char c) noexcept;
+        void reset_message() noexcept;
+
+        enum class state {
+            header,
+            body
+        } _state{state::header};
+
+        std::size_t _content_length{};
+        std::size_t _body_read{};
+        std::string _header_line{};
+
+        unsigned int _depth{};
+        bool _in_string{false};
+        bool _escaped{false};
+        bool _reading_key{false};
+        bool _expecting_key{false};
+        bool _reading_id{false};
+        bool _reading_method{false};
+        bool _has_method{false};
+        bool _has_id{false};
+        std::string _key{};
+        std::string _id{};
+        std::string _method{};
+        std::string _last_id{};
+        std::string _last_method{};
+    };
+}
+
+// Read side of the transport: reads the server's output straight from the pipe into a reusable buffer, and
+// exposes it one complete "Content-Length" framed message at a time, without copying it
+class fd_input_buffer : public std::streambuf {
+public:
+    // Given the body of a message, returns the body to hand over instead, if any
+    using message_filter = std::function<std::optional<std::string>(std::string_view body)>;
+
+    explicit fd_input_buffer(int fd) noexcept : _fd{fd} {}
+
+    // must be set before the first read
+    void set_message_filter(message_filter filter) {
+        _filter = std::move(filter);
+    }
+
+    // messages read are recorded if not null, must be set before the first read
+    void set_recorder(traffic_recorder* recorder) noexcept {
+        _recorder = recorder;
+    }
+
+    // true if a complete message is already buffered, in which case reading it won't block
+    [[nodiscard]] bool has_buffered_message() noexcept;
+
+    // bytes read from the pipe so far, readable from any thread
+    [[nodiscard]] std::uint64_t bytes_read() const noexcept {
+        return _bytes_read.load(std::memory_order_relaxed);
+    }
+
+protected:
+    int_type underflow() override;
+    std::streamsize showmanyc() override;
+
+private:
+    // size of the message starting at _buffer[offset], 0 if it is not complete yet
+    [[nodiscard]] std::size_t complete_message_size(std::size_t offset) const noexcept;
+    // size of the message starting at _buffer[offset] once complete, 0 if its header is not complete yet
+    [[nodiscard]] std::size_t announced_message_size(std::size_t offset) const noexcept;
+
+    // exposes the message of the given size starting at _buffer[offset], or its replacement
+    void expose_message(std::size_t offset, std::size_t size);
+
+    int _fd;
+    std::vector<char> _buffer = std::vector<char>(64 * 1024);
+    std::size_t _data_end{}; // end of the bytes read from the pipe
+    std::size_t _next_message{}; // start of the first message not exposed yet
+    std::string _replacement{};
+    message_filter _filter{};
+    traffic_recorder* _recorder{};
+    std::atomic_uint64_t _bytes_read{};
+};
+
+// Write side of the transport: assembles header and body of each message and hands them to the kernel with a
+// single writev once the message is complete. Large body chunks are not copied, but written along with the
+// pending header directly from the caller's buffer. A message may be written in many parts, see
+// document_messages.h: other threads wait for it to be complete before writing theirs.
+class fd_output_buffer : public std::streambuf {
+public:
+    // Called with the raw JSON id and the method of each request, before it is written
+    using request_observer = std::function<void(std::string_view id, std::string_view method)>;
+
+    explicit fd_output_buffer(int fd) noexcept : _fd{fd} {}
+
+    // must be set before the first write
+    void set_request_observer(request_observer observer) {
+        _observer = std::move(observer);
+    }
+
+    // messages written are recorded if not null, must be set before the first write
+    void set_recorder(traffic_recorder* recorder) noexcept {
+        _recorder = recorder;
+    }
+
+    // raw JSON value of the "id" field of the last request written ("12", "\"abc\""...)
+    [[nodiscard]] std::string last_request_id() const;
+
+    // bytes written to the pipe so far, readable from any thread
+    [[nodiscard]] std::uint64_t bytes_written() const noexcept {
+        return _bytes_written.load(std::memory_order_relaxed);
+    }
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type* s, std::streamsize count) override;
+    int sync() override;
+
+private:
+    // feeds data to the scanner and writes it out as messages complete, returns false on error
+    bool write_parts(std::string_view data);
+
+    // writes _pending followed by extra, returns false on error
+    bool write_out(std::string_view extra = {});
+
+    void record_part(std::string_view part, bool message_ended);
+
+    int _fd;
+    std::vector<char> _pending{};
+    lsptypes::request_id_scanner _scanner{};
+    request_observer _observer{};
+    traffic_recorder* _recorder{};
+    std::string _recorded_message{}; // framed, up to the current part
+
+    std::recursive_mutex _message_mutex{}; // locked once per write of the current message
+    unsigned int _message_locks{};
+
+    mutable std::mutex _last_request_id_mutex{};
+    std::string _last_request_id{};
+    std::atomic_uint64_t _bytes_written{};
+};
+
+
+#endif //IMEDIT_LS_LSP_TRANSPORT_H
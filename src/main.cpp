@@ -4,26 +4,73 @@
 #include <imgui_app.h>
 
 #include "imedit/editor.h"
-#include "clangd_server.h"
+#include "editor_overlays.h"
+#include "editor_text.h"
+#include "frame_scheduler.h"
+#include "server_pool.h"
+#include "telemetry_window.h"
 
 #include <lsp/messages.h>
 #include <lsp/connection.h>
 #include <lsp/messagehandler.h>
 
+#include <SDL.h>
 #include <unistd.h>
-#include <ext/stdio_filebuf.h>
 
-int main(int, char*[])
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace {
+    // the editor's cursor blinks while it has the focus
+    constexpr auto cursor_blink_interval = std::chrono::milliseconds{500};
+    // the symbol under the mouse is asked about once the mouse rested for this long
+    constexpr auto hover_delay = std::chrono::milliseconds{300};
+
+    // Blocks until an event comes, or until the scheduler's next deadline
+    void wait_for_events(frame_scheduler& frames) {
+        auto timeout = frames.wait_time(frame_scheduler::clock::now());
+        int got_events;
+        if (!timeout) {
+            got_events = SDL_WaitEvent(nullptr);
+        } else if (*timeout == frame_scheduler::clock::duration::zero()) {
+            got_events = SDL_PollEvent(nullptr);
+        } else {
+            // rounded up, waking up early would only draw a frame for nothing
+            auto ms = std::chrono::ceil<std::chrono::milliseconds>(*timeout);
+            got_events = SDL_WaitEventTimeout(nullptr, static_cast<int>(ms.count()));
+        }
+        // the events are left in the queue for the backend
+        frames.woke_up(got_events == 1);
+    }
+}
+
+int main(int argc, char* argv[])
 {
-    clangd_server ls("/usr/bin/clangd");
+    // nothing is drawn until there is input, a message from the server or a timer is due
+    frame_scheduler frames;
+
+    // ImEdit_LS [language server [arguments...]]
+    lsptypes::server_options options;
+    if (argc > 2) {
+        options.server_arguments.assign(argv + 2, argv + argc);
+    }
+    // IMEDIT_LS_RECORD=file.lsprec records the traffic with the server, see tools/lsp_replay
+    if (const char* recording_path = std::getenv("IMEDIT_LS_RECORD") ; recording_path != nullptr) {
+        options.traffic_recording = recording_path;
+    }
+    options.message_listener = [&frames] {
+        frames.wake();
+    };
 
     ImEdit::editor editor("test.cpp");
     editor._style.token_style[ImEdit::token_type::constant] = ImColor(174, 129, 255, 255);
     editor._style.token_style[ImEdit::token_type::preprocessor] = ImColor(149, 117, 234, 255);
     editor._style.token_style[ImEdit::token_type::operators] = ImColor(249, 38, 114, 255);
 
-    ls.setup_editor(editor);
-
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
 
@@ -31,26 +78,134 @@ int main(int, char*[])
     window->InitCreateWindow(window, "ImEdit testing", ImVec2(1440, 900));
     window->InitBackends(window);
 
-    editor._width = 600;
-    editor._height = 250;
-
-    while (window->NewFrame(window))
+    // SDL is up: server messages may wake the loop from now on
+    const Uint32 wake_event = SDL_RegisterEvents(1);
+    frames.set_waker([wake_event] {
+        SDL_Event event{};
+        event.type = wake_event;
+        SDL_PushEvent(&event);
+    });
     {
-
-        ImGui::NewFrame();
-
-        ImGui::ShowDemoWindow();
-
-        ls.update(editor);
-
-        if (ImGui::Begin("Editor")) {
-            editor.render();
+        // the servers are destroyed before SDL quits: their threads push wake-up events until they are joined
+        server_pool servers;
+        servers.register_language("cpp", argc > 1 ? argv[1] : "/usr/bin/clangd", std::move(options));
+        servers.add_editor(editor, "/tmp/test.cpp", "cpp", "/tmp");
+
+        editor._width = 600;
+        editor._height = 250;
+
+        lsptypes::line_range visible_lines{};
+        editor_geometry geometry{};
+        std::vector<lsptypes::diagnostic_mark> diagnostic_marks{};
+        std::vector<lsptypes::decoration_mark> decoration_marks{};
+        std::optional<ImEdit::coordinates> last_cursor{};
+        frame_scheduler::clock::time_point mouse_moved{};
+        bool completing = false;
+        bool show_telemetry = false;
+        while (true)
+        {
+            wait_for_events(frames);
+            if (!window->NewFrame(window)) {
+                break;
+            }
+
+            ImGui::NewFrame();
+
+            servers.show(editor, visible_lines);
+            servers.poll();
+
+            // the telemetry panel is opened from the menu or with F12
+            if (ImGui::IsKeyPressed(ImGuiKey_F12, false)) {
+                show_telemetry = !show_telemetry;
+            }
+            if (ImGui::BeginMainMenuBar()) {
+                if (ImGui::BeginMenu("View")) {
+                    ImGui::MenuItem("Telemetry", "F12", &show_telemetry);
+                    ImGui::EndMenu();
+                }
+                ImGui::EndMainMenuBar();
+            }
+
+            bool editor_focused = false;
+            bool editor_hovered = false;
+            if (ImGui::Begin("Editor")) {
+                geometry = current_editor_geometry();
+                editor.render();
+                visible_lines = editor_visible_lines(editor);
+                editor_focused = ImGui::IsWindowFocused();
+                editor_hovered = ImGui::IsWindowHovered();
+                if (const clangd_server* ls = servers.server_of(editor) ; ls != nullptr) {
+                    draw_token_decorations(*ls, editor, geometry, visible_lines, decoration_marks);
+                    draw_diagnostics(*ls, editor, geometry, visible_lines, diagnostic_marks);
+                }
+            }
+            ImGui::End();
+
+            const auto now = frame_scheduler::clock::now();
+            if (const ImVec2 delta = ImGui::GetIO().MouseDelta ; delta.x * delta.x + delta.y * delta.y > 0) {
+                mouse_moved = now;
+            }
+
+            clangd_server* ls = servers.server_of(editor);
+            const std::optional<ImEdit::coordinates> cursor = editor_cursor(editor);
+            const bool was_completing = completing;
+            if (ls != nullptr && editor_focused && cursor) {
+                // ctrl+space starts completing the word at the cursor, which is completed again as the cursor moves
+                const bool moved = !last_cursor || last_cursor->line != cursor->line || last_cursor->char_index != cursor->char_index;
+                if (ImGui::GetIO().KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_Space)) {
+                    completing = true;
+                    ls->complete(editor, *cursor);
+                } else if (completing && moved) {
+                    ls->complete(editor, *cursor);
+                }
+                if (ImGui::IsKeyPressed(ImGuiKey_Escape)) {
+                    completing = false;
+                }
+            } else {
+                completing = false;
+            }
+            last_cursor = cursor;
+
+            if (ls != nullptr) {
+                if (cursor) {
+                    // the symbol under the cursor is prefetched once it rests
+                    ls->set_cursor(editor, *cursor);
+                }
+                if (editor_hovered && !completing) {
+                    if (now - mouse_moved >= hover_delay) {
+                        show_hover_tooltip(*ls, editor, geometry);
+                    } else {
+                        frames.schedule(mouse_moved + hover_delay);
+                    }
+                }
+                if (completing) {
+                    show_completion_popup(*ls, geometry);
+                } else if (was_completing) {
+                    ls->end_completion();
+                }
+                if (show_telemetry) {
+                    show_telemetry_window(ls->telemetry(), &show_telemetry);
+                }
+            }
+
+            // the servers' timers, and the cursor's blinking
+            frames.schedule(servers.next_poll());
+            if (editor_focused) {
+                frames.schedule(now + cursor_blink_interval);
+            }
+
+            ImGui::Render();
+            window->ClearColor = window->ClearColor;
+            window->Render(window);
+            frames.frame_done();
         }
-        ImGui::End();
 
-        ImGui::Render();
-        window->ClearColor = window->ClearColor;
-        window->Render(window);
+        // IMEDIT_LS_TELEMETRY=file.json dumps the telemetry on exit
+        const clangd_server* ls = servers.server_of(editor);
+        if (const char* telemetry_path = std::getenv("IMEDIT_LS_TELEMETRY") ; telemetry_path != nullptr && ls != nullptr) {
+            std::ofstream(telemetry_path) << lsptypes::to_json(ls->telemetry()) << '\n';
+        }
+        servers.remove_editor(editor);
     }
 
     window->ShutdownBackends(window);
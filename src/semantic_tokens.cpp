@@ -0,0 +1,103 @@
+#include "semantic_tokens.h"
+
+#include <limits>
+#include <utility>
+
+namespace {
+    constexpr auto tok_size = semantic_tokens_cache::ints_per_token;
+
+    bool same_token(const std::vector<std::uint32_t>& lhs, std::size_t lhs_idx, const std::vector<std::uint32_t>& rhs, std::size_t rhs_idx) noexcept {
+        return std::equal(lhs.begin() + static_cast<std::ptrdiff_t>(lhs_idx * tok_size),
+                          lhs.begin() + static_cast<std::ptrdiff_t>((lhs_idx + 1) * tok_size),
+                          rhs.begin() + static_cast<std::ptrdiff_t>(rhs_idx * tok_size));
+    }
+}
+
+void semantic_tokens_cache::clear() noexcept {
+    _result_id.clear();
+    _data.clear();
+    _token_lines.clear();
+}
+
+lsptypes::line_range semantic_tokens_cache::replace(std::string result_id, std::vector<std::uint32_t> data) {
+    data.resize(data.size() - data.size() % tok_size);
+
+    std::vector<std::uint32_t> old_data = std::exchange(_data, std::move(data));
+    std::vector<unsigned int> old_token_lines = std::move(_token_lines);
+    _result_id = std::move(result_id);
+    return update_token_lines(old_data, old_token_lines);
+}
+
+std::optional<lsptypes::line_range> semantic_tokens_cache::apply_edits(std::string result_id, std::vector<lsptypes::semantic_tokens_edit> edits) {
+    // edits are expressed relatively to the original array: apply them from the last one to the first one
+    std::sort(edits.begin(), edits.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.start > rhs.start;
+    });
+
+    std::vector<std::uint32_t> data = _data;
+    for (auto& edit : edits) {
+        if (edit.start > data.size() || edit.delete_count > data.size() - edit.start) {
+            clear();
+            return {};
+        }
+        auto pos = data.begin() + edit.start;
+        pos = data.erase(pos, pos + edit.delete_count);
+        data.insert(pos, edit.data.begin(), edit.data.end());
+    }
+
+    if (data.size() % tok_size != 0) {
+        clear();
+        return {};
+    }
+    return replace(std::move(result_id), std::move(data));
+}
+
+lsptypes::line_range semantic_tokens_cache::update_token_lines(const std::vector<std::uint32_t>& old_data, const std::vector<unsigned int>& old_token_lines) {
+    const std::size_t new_count = _data.size() / tok_size;
+    const std::size_t old_count = old_token_lines.size();
+
+    _token_lines.resize(new_count);
+    unsigned int line = 0;
+    for (std::size_t i = 0 ; i < new_count ; ++i) {
+        line += _data[i * tok_size];
+        _token_lines[i] = line;
+    }
+
+    // Tokens shared at the beginning are at the same place. Tokens shared at the end are on the same lines,
+    // only shifted by the lines that were inserted or removed in between.
+    std::size_t prefix = 0;
+    while (prefix < old_count && prefix < new_count && same_token(old_data, prefix, _data, prefix)) {
+        ++prefix;
+    }
+    std::size_t suffix = 0;
+    while (suffix < old_count - prefix && suffix < new_count - prefix
+           && same_token(old_data, old_count - suffix - 1, _data, new_count - suffix - 1)) {
+        ++suffix;
+    }
+    // the suffix must start on a line boundary, as the first token of a line is positioned absolutely
+    while (suffix > 0 && _data[(new_count - suffix) * tok_size] == 0) {
+        --suffix;
+    }
+
+    if (prefix == old_count && prefix == new_count) {
+        return {};
+    }
+
+    constexpr unsigned int no_line = std::numeric_limits<unsigned int>::max();
+    unsigned int first = no_line;
+    if (prefix < new_count) {
+        first = _token_lines[prefix];
+    }
+    if (prefix < old_count) {
+        first = std::min(first, old_token_lines[prefix]);
+    }
+
+    unsigned int last;
+    if (suffix > 0) {
+        last = _token_lines[new_count - suffix];
+    } else {
+        last = std::max(new_count == 0 ? 0 : _token_lines.back() + 1, old_count == 0 ? 0 : old_token_lines.back() + 1);
+    }
+
+    return {std::min(first, last), last};
+}
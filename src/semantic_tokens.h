@@ -0,0 +1,90 @@
+#ifndef IMEDIT_LS_SEMANTIC_TOKENS_H
+#define IMEDIT_LS_SEMANTIC_TOKENS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lsptypes {
+    // [first, last)
+    struct line_range {
+        unsigned int first{};
+        unsigned int last{};
+
+        [[nodiscard]] bool empty() const noexcept {
+            return first >= last;
+        }
+
+        [[nodiscard]] line_range merged_with(line_range other) const noexcept {
+            if (empty()) {
+                return other;
+            }
+            if (other.empty()) {
+                return *this;
+            }
+            return {std::min(first, other.first), std::max(last, other.last)};
+        }
+    };
+
+    struct semantic_tokens_edit {
+        unsigned int start{};
+        unsigned int delete_count{};
+        std::vector<std::uint32_t> data{};
+    };
+}
+
+// Last semantic tokens received for a document, kept in the server's delta-encoded format so that
+// semanticTokens/full/delta answers can be applied to it
+class semantic_tokens_cache {
+public:
+    static constexpr unsigned int ints_per_token = 5;
+
+    [[nodiscard]] const std::string& result_id() const noexcept {
+        return _result_id;
+    }
+
+    [[nodiscard]] const std::vector<std::uint32_t>& data() const noexcept {
+        return _data;
+    }
+
+    void clear() noexcept;
+
+    [[nodiscard]] std::size_t byte_size() const noexcept {
+        return _result_id.size() + _data.size() * sizeof(std::uint32_t) + _token_lines.size() * sizeof(unsigned int);
+    }
+
+    // Both return the lines, in the new tokens' coordinates, whose tokens changed
+    lsptypes::line_range replace(std::string result_id, std::vector<std::uint32_t> data);
+    // Returns an empty optional if the edits do not fit the cached array, in which case the cache is cleared
+    [[nodiscard]] std::optional<lsptypes::line_range> apply_edits(std::string result_id, std::vector<lsptypes::semantic_tokens_edit> edits);
+
+    // Calls func(line, char_idx, length, type, modifiers) for each token within the given lines
+    template <typename FuncT>
+    void for_each_token(lsptypes::line_range lines, FuncT&& func) const {
+        auto token = static_cast<std::size_t>(std::lower_bound(_token_lines.begin(), _token_lines.end(), lines.first) - _token_lines.begin());
+        unsigned int char_idx = 0;
+        for (; token < _token_lines.size() && _token_lines[token] < lines.last ; ++token) {
+            const std::uint32_t* tok = &_data[token * ints_per_token];
+            // char indices are relative to the previous token when on the same line.
+            // lower_bound always lands on the first token of a line, so char_idx is never stale here
+            if (tok[0] != 0 || token == 0) {
+                char_idx = tok[1];
+            } else {
+                char_idx += tok[1];
+            }
+            func(_token_lines[token], char_idx, tok[2], tok[3], tok[4]);
+        }
+    }
+
+private:
+    lsptypes::line_range update_token_lines(const std::vector<std::uint32_t>& old_data, const std::vector<unsigned int>& old_token_lines);
+
+    std::string _result_id{};
+    std::vector<std::uint32_t> _data{};
+    std::vector<unsigned int> _token_lines{}; // absolute line of each token
+};
+
+
+#endif //IMEDIT_LS_SEMANTIC_TOKENS_H
@@ -0,0 +1,516 @@
+#include "semantic_tokens_decoder.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    constexpr auto npos = std::string_view::npos;
+
+    constexpr std::array<std::string_view, 3> semantic_tokens_methods{
+        "textDocument/semanticTokens/full",
+        "textDocument/semanticTokens/full/delta",
+        "textDocument/semanticTokens/range",
+    };
+
+    bool is_blank(char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    std::size_t skip_blanks(std::string_view json, std::size_t pos) noexcept {
+        while (pos < json.size() && is_blank(json[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    // json[pos] is the opening quote. Returns the position following the closing quote.
+    std::size_t skip_string(std::string_view json, std::size_t pos) noexcept {
+        ++pos;
+        while (true) {
+            pos = json.find_first_of("\"\\", pos);
+            if (pos == npos) {
+                return npos;
+            }
+            if (json[pos] == '"') {
+                return pos + 1;
+            }
+            pos += 2;
+        }
+    }
+
+    std::size_t parse_string(std::string_view json, std::size_t pos, std::string& out) {
+        std::size_t end = skip_string(json, pos);
+        if (end == npos) {
+            return npos;
+        }
+
+        out.clear();
+        for (std::size_t i = pos + 1 ; i < end - 1 ; ++i) {
+            if (json[i] != '\\') {
+                out += json[i];
+                continue;
+            }
+            switch (json[++i]) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    unsigned int cp = 0;
+                    if (i + 4 >= end || std::from_chars(json.data() + i + 1, json.data() + i + 5, cp, 16).ec != std::errc{}) {
+                        return npos;
+                    }
+                    i += 4;
+                    if (cp < 0x80) {
+                        out += static_cast<char>(cp);
+                    } else if (cp < 0x800) {
+                        out += static_cast<char>(0xC0 | (cp >> 6));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    } else {
+                        out += static_cast<char>(0xE0 | (cp >> 12));
+                        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (cp & 0x3F));
+                    }
+                    break;
+                }
+                default: out += json[i]; break;
+            }
+        }
+        return end;
+    }
+
+    std::size_t skip_value(std::string_view json, std::size_t pos) noexcept {
+        pos = skip_blanks(json, pos);
+        if (pos >= json.size()) {
+            return npos;
+        }
+
+        if (json[pos] == '"') {
+            return skip_string(json, pos);
+        }
+
+        if (json[pos] == '{' || json[pos] == '[') {
+            unsigned int depth = 0;
+            while (pos < json.size()) {
+                pos = json.find_first_of("\"{}[]", pos);
+                if (pos == npos) {
+                    return npos;
+                }
+                switch (json[pos]) {
+                    case '"':
+                        pos = skip_string(json, pos);
+                        if (pos == npos) {
+                            return npos;
+                        }
+                        continue;
+                    case '{':
+                    case '[':
+                        ++depth;
+                        break;
+                    default:
+                        if (--depth == 0) {
+                            return pos + 1;
+                        }
+                        break;
+                }
+                ++pos;
+            }
+            return npos;
+        }
+
+        // number, true, false or null
+        while (pos < json.size() && json[pos] != ',' && json[pos] != '}' && json[pos] != ']' && !is_blank(json[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    // Calls func(key, value_pos) for each member of the object starting at json[pos], func returns the position
+    // following the value (or npos on error). Returns the position following the object.
+    template <typename FuncT>
+    std::size_t for_each_member(std::string_view json, std::size_t pos, FuncT&& func) {
+        pos = skip_blanks(json, pos);
+        if (pos >= json.size() || json[pos] != '{') {
+            return npos;
+        }
+        pos = skip_blanks(json, pos + 1);
+        if (pos < json.size() && json[pos] == '}') {
+            return pos + 1;
+        }
+
+        while (pos < json.size()) {
+            if (json[pos] != '"') {
+                return npos;
+            }
+            std::size_t key_end = skip_string(json, pos);
+            if (key_end == npos) {
+                return npos;
+            }
+            std::string_view key = json.substr(pos + 1, key_end - pos - 2);
+
+            pos = skip_blanks(json, key_end);
+            if (pos >= json.size() || json[pos] != ':') {
+                return npos;
+            }
+            pos = func(key, skip_blanks(json, pos + 1));
+            if (pos == npos) {
+                return npos;
+            }
+
+            pos = skip_blanks(json, pos);
+            if (pos >= json.size()) {
+                return npos;
+            }
+            if (json[pos] == '}') {
+                return pos + 1;
+            }
+            if (json[pos] != ',') {
+                return npos;
+            }
+            pos = skip_blanks(json, pos + 1);
+        }
+        return npos;
+    }
+
+#if defined(__SSE2__)
+    constexpr std::array<std::uint64_t, 10> powers_of_ten{
+        1, 10, 100, 1'000, 10'000, 100'000, 1'000'000, 10'000'000, 100'000'000, 1'000'000'000
+    };
+
+    // Value of the count digits (8 at most) ending at last, which are preceded by 8 - count readable bytes
+    std::uint64_t eight_digits(const char* last, unsigned int count) noexcept {
+        std::uint64_t bytes{};
+        std::memcpy(&bytes, last - 7, sizeof(bytes));
+        // little endian: the last digit is the most significant byte, the bytes before the run are cleared
+        const std::uint64_t mask = count >= 8 ? ~std::uint64_t{0} : ~std::uint64_t{0} << (8 * (8 - count));
+        bytes = (bytes & mask) - (0x3030303030303030 & mask);
+        // pairs of digits, then groups of 4, then the 8 digits
+        bytes = (bytes * 10) + (bytes >> 8);
+        return (((bytes & 0x000000FF000000FF) * (100 + (1'000'000ull << 32)))
+                + (((bytes >> 16) & 0x000000FF000000FF) * (1 + (10'000ull << 32)))) >> 32;
+    }
+#endif
+
+    std::size_t parse_uint(std::string_view json, std::size_t pos, unsigned int& value) noexcept {
+        auto [ptr, ec] = std::from_chars(json.data() + pos, json.data() + json.size(), value);
+        if (ec != std::errc{}) {
+            return npos;
+        }
+        return static_cast<std::size_t>(ptr - json.data());
+    }
+
+    std::size_t parse_edits(std::string_view json, std::size_t pos, std::vector<lsptypes::semantic_tokens_edit>& edits) {
+        if (pos >= json.size() || json[pos] != '[') {
+            return npos;
+        }
+        pos = skip_blanks(json, pos + 1);
+        if (pos < json.size() && json[pos] == ']') {
+            return pos + 1;
+        }
+
+        while (pos < json.size()) {
+            lsptypes::semantic_tokens_edit& edit = edits.emplace_back();
+            pos = for_each_member(json, pos, [&json, &edit](std::string_view key, std::size_t value_pos) {
+                if (key == "start") {
+                    return parse_uint(json, value_pos, edit.start);
+                }
+                if (key == "deleteCount") {
+                    return parse_uint(json, value_pos, edit.delete_count);
+                }
+                if (key == "data") {
+                    return lsptypes::parse_uint_array(json, value_pos, edit.data);
+                }
+                return skip_value(json, value_pos);
+            });
+            if (pos == npos) {
+                return npos;
+            }
+
+            pos = skip_blanks(json, pos);
+            if (pos < json.size() && json[pos] == ']') {
+                return pos + 1;
+            }
+            if (pos >= json.size() || json[pos] != ',') {
+                return npos;
+            }
+            pos = skip_blanks(json, pos + 1);
+        }
+        return npos;
+    }
+}
+
+std::size_t lsptypes::parse_uint_array(std::string_view json, std::size_t pos, std::vector<std::uint32_t>& out) {
+    if (pos >= json.size() || json[pos] != '[') {
+        return npos;
+    }
+    ++pos;
+
+    std::uint32_t value = 0;
+    bool in_number = false;
+
+    // false when the number does not fit in 32 bits
+    auto consume = [&](char c) {
+        if (c >= '0' && c <= '9') {
+            const auto digit = static_cast<std::uint32_t>(c - '0');
+            if (value > (std::numeric_limits<std::uint32_t>::max() - digit) / 10) {
+                return false;
+            }
+            value = value * 10 + digit;
+            in_number = true;
+        } else if (in_number) {
+            out.push_back(value);
+            value = 0;
+            in_number = false;
+        }
+        return true;
+    };
+
+#if defined(__SSE2__)
+    // 16 characters at a time: the digit and separator masks give the runs of digits, each run is converted with
+    // multiply-adds on 8 bytes (at most 2 per run) and pushed. A run reaching the end of the block is carried over
+    // to the next one in value, as consume does
+    const __m128i zero_minus_one = _mm_set1_epi8('0' - 1);
+    const __m128i nine_plus_one = _mm_set1_epi8('9' + 1);
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i closing = _mm_set1_epi8(']');
+
+    // the block is copied after 16 bytes of padding, so that the 8 bytes ending at any of its digits can be loaded
+    alignas(16) std::array<char, 32> block{};
+    while (pos + 16 <= json.size()) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(json.data() + pos));
+        __m128i digits = _mm_and_si128(_mm_cmpgt_epi8(chunk, zero_minus_one), _mm_cmplt_epi8(chunk, nine_plus_one));
+        __m128i separators = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, comma), _mm_cmpeq_epi8(chunk, space)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_or_si128(_mm_cmpeq_epi8(chunk, carriage_return), _mm_cmpeq_epi8(chunk, tab)))
+        );
+
+        auto digit_mask = static_cast<unsigned int>(_mm_movemask_epi8(digits));
+        auto valid_mask = digit_mask | static_cast<unsigned int>(_mm_movemask_epi8(separators));
+        auto closing_mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, closing)));
+
+        unsigned int length = 16;
+        if (closing_mask != 0) {
+            length = static_cast<unsigned int>(__builtin_ctz(closing_mask));
+        }
+        const unsigned int expected_mask = (1u << length) - 1;
+        if ((valid_mask & expected_mask) != expected_mask) {
+            return npos;
+        }
+        digit_mask &= expected_mask;
+
+        if (in_number && (digit_mask & 1u) == 0) {
+            out.push_back(value);
+            value = 0;
+            in_number = false;
+        }
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(block.data() + 16), chunk);
+        unsigned int starts = digit_mask & ~(digit_mask << 1);
+        unsigned int ends = digit_mask & ~(digit_mask >> 1);
+        while (starts != 0) {
+            const auto first = static_cast<unsigned int>(__builtin_ctz(starts));
+            const auto last = static_cast<unsigned int>(__builtin_ctz(ends));
+            starts &= starts - 1;
+            ends &= ends - 1;
+
+            const unsigned int count = last - first + 1;
+            const char* run_end = block.data() + 16 + last;
+            std::uint64_t number = count <= 8
+                    ? eight_digits(run_end, count)
+                    : eight_digits(run_end - 8, count - 8) * 100'000'000 + eight_digits(run_end, 8);
+            if (first == 0 && in_number && value != 0) {
+                // 10 more digits after a non zero value always overflow, fewer fit in 64 bits
+                if (count > 9) {
+                    return npos;
+                }
+                number += value * powers_of_ten[count];
+            }
+            if (number > std::numeric_limits<std::uint32_t>::max()) {
+                return npos;
+            }
+            value = static_cast<std::uint32_t>(number);
+            in_number = true;
+            if (last != 15) {
+                out.push_back(value);
+                value = 0;
+                in_number = false;
+            }
+        }
+
+        pos += length;
+        if (closing_mask != 0) {
+            return pos + 1;
+        }
+    }
+#endif
+
+    for (; pos < json.size() ; ++pos) {
+        char c = json[pos];
+        if (c == ']') {
+            consume(c);
+            return pos + 1;
+        }
+        if ((c < '0' || c > '9') && c != ',' && !is_blank(c)) {
+            return npos;
+        }
+        if (!consume(c)) {
+            return npos;
+        }
+    }
+    return npos;
+}
+
+std::optional<lsptypes::semantic_tokens_payload> lsptypes::decode_semantic_tokens(std::string_view result) {
+    semantic_tokens_payload payload;
+
+    std::size_t pos = skip_blanks(result, 0);
+    if (result.substr(pos, 4) == "null") {
+        payload.is_null = true;
+        return payload;
+    }
+
+    pos = for_each_member(result, pos, [&result, &payload](std::string_view key, std::size_t value_pos) {
+        if (key == "resultId") {
+            return parse_string(result, value_pos, payload.result_id);
+        }
+        if (key == "data") {
+            // mostly small numbers: about 3 characters per integer
+            payload.data.reserve((result.size() - value_pos) / 3);
+            return parse_uint_array(result, value_pos, payload.data);
+        }
+        if (key == "edits") {
+            payload.is_delta = true;
+            return parse_edits(result, value_pos, payload.edits);
+        }
+        return skip_value(result, value_pos);
+    });
+
+    if (pos == npos) {
+        return {};
+    }
+    return payload;
+}
+
+std::optional<lsptypes::response_header> lsptypes::scan_response(std::string_view message_body) {
+    std::string_view id{};
+    std::optional<bool> is_error{};
+    bool is_request = false;
+    for_each_member(message_body, 0, [&](std::string_view key, std::size_t value_pos) {
+        if (key == "method") {
+            is_request = true;
+            return npos;
+        }
+        if (key == "result" || key == "error") {
+            is_error = key == "error";
+            if (!id.empty()) {
+                // the rest is the bulk of the message
+                return npos;
+            }
+        }
+
+        std::size_t value_end = skip_value(message_body, value_pos);
+        if (key == "id" && value_end != npos) {
+            id = message_body.substr(value_pos, value_end - value_pos);
+            if (is_error) {
+                return npos;
+            }
+        }
+        return value_end;
+    });
+
+    if (is_request || id.empty() || !is_error) {
+        return {};
+    }
+    return response_header{.id = id, .is_error = *is_error};
+}
+
+void semantic_tokens_interceptor::request_sent(std::string_view id, std::string_view method) {
+    if (std::find(semantic_tokens_methods.begin(), semantic_tokens_methods.end(), method) == semantic_tokens_methods.end()) {
+        return;
+    }
+    std::lock_guard lock(_mutex);
+    _awaited_ids.emplace(id);
+}
+
+std::optional<std::string> semantic_tokens_interceptor::intercept(std::string_view message_body) {
+    {
+        std::lock_guard lock(_mutex);
+        if (_awaited_ids.empty()) {
+            return {};
+        }
+    }
+
+    std::string_view id{};
+    std::size_t result_pos = npos;
+    std::size_t error_pos = npos;
+    bool is_response = true;
+    std::size_t end = for_each_member(message_body, 0, [&](std::string_view key, std::size_t value_pos) {
+        std::size_t value_end = skip_value(message_body, value_pos);
+        if (value_end == npos) {
+            return npos;
+        }
+        if (key == "id") {
+            id = message_body.substr(value_pos, value_end - value_pos);
+        } else if (key == "result") {
+            result_pos = value_pos;
+        } else if (key == "error") {
+            error_pos = value_pos;
+        } else if (key == "method") {
+            is_response = false;
+        }
+        return value_end;
+    });
+
+    if (end == npos || id.empty()) {
+        return {};
+    }
+
+    std::string id_str(id);
+    {
+        std::lock_guard lock(_mutex);
+        if (!is_response || _awaited_ids.erase(id_str) == 0) {
+            return {};
+        }
+    }
+
+    std::optional<lsptypes::semantic_tokens_payload> payload;
+    if (result_pos != npos) {
+        payload = lsptypes::decode_semantic_tokens(message_body.substr(result_pos));
+    }
+    if (!payload) {
+        // still reported as answered, with nothing in it. lsp-framework gets the original message
+        if (error_pos != npos) {
+            std::cerr << "semantic tokens request " << id_str << " failed: " << message_body.substr(error_pos, skip_value(message_body, error_pos) - error_pos) << '\n';
+        } else {
+            std::cerr << "could not decode the answer to semantic tokens request " << id_str << '\n';
+        }
+        _handler(id_str, {.is_null = true});
+        return {};
+    }
+
+    _handler(id_str, std::move(*payload));
+    return R"({"jsonrpc":"2.0","id":)" + id_str + R"(,"result":null})";
+}
+
+void semantic_tokens_interceptor::forget(const std::string& id) {
+    std::lock_guard lock(_mutex);
+    _awaited_ids.erase(id);
+}
+
+void semantic_tokens_interceptor::reset() {
+    std::lock_guard lock(_mutex);
+    _awaited_ids.clear();
+}
@@ -0,0 +1,71 @@
+#ifndef IMEDIT_LS_SEMANTIC_TOKENS_DECODER_H
+#define IMEDIT_LS_SEMANTIC_TOKENS_DECODER_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "semantic_tokens.h"
+
+namespace lsptypes {
+    // Answer to a semanticTokens/full, semanticTokens/full/delta or semanticTokens/range request
+    struct semantic_tokens_payload {
+        bool is_null{false};
+        bool is_delta{false};
+        std::string result_id{};
+        std::vector<std::uint32_t> data{}; // when !is_delta
+        std::vector<semantic_tokens_edit> edits{}; // when is_delta
+    };
+
+    // Decodes the "result" of a semantic tokens response straight into integer arrays.
+    // Returns an empty optional if 'result' isn't valid semantic tokens JSON.
+    [[nodiscard]] std::optional<semantic_tokens_payload> decode_semantic_tokens(std::string_view result);
+
+    // Parses a JSON array of unsigned integers starting at json[pos] ('['), appending them to out.
+    // Returns the position following the closing ']', or npos on malformed input and values that overflow 32 bits.
+    [[nodiscard]] std::size_t parse_uint_array(std::string_view json, std::size_t pos, std::vector<std::uint32_t>& out);
+
+    struct response_header {
+        std::string_view id{}; // raw JSON value
+        bool is_error{false};
+    };
+
+    // Id of the response whose body is given, empty for requests, notifications and malformed messages.
+    // Members following "result" or "error" are not scanned when "id" precedes them, as it does with most servers.
+    [[nodiscard]] std::optional<response_header> scan_response(std::string_view message_body);
+}
+
+// Takes semantic tokens answers out of the incoming message stream before lsp::Connection parses them: their
+// data is decoded here, and the message handed over to lsp-framework is replaced by a null result, so that
+// no generic JSON node is ever created for them.
+class semantic_tokens_interceptor {
+public:
+    // Called from the transport's thread with the id and the decoded answer of each awaited response, before
+    // lsp-framework gets it. Failed or undecodable answers are reported as null.
+    using payload_handler = std::function<void(const std::string& id, lsptypes::semantic_tokens_payload payload)>;
+
+    explicit semantic_tokens_interceptor(payload_handler handler) : _handler{std::move(handler)} {}
+
+    // called from the transport for every request written
+    void request_sent(std::string_view id, std::string_view method);
+
+    // called from the transport for every message read, returns the replacement body for intercepted messages
+    [[nodiscard]] std::optional<std::string> intercept(std::string_view message_body);
+
+    void forget(const std::string& id);
+    // forgets every awaited answer, for a new server
+    void reset();
+
+private:
+    payload_handler _handler;
+    std::mutex _mutex{};
+    std::unordered_set<std::string> _awaited_ids{};
+};
+
+
+#endif //IMEDIT_LS_SEMANTIC_TOKENS_DECODER_H
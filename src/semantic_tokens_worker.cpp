@@ -0,0 +1,110 @@
+#include "semantic_tokens_worker.h"
+
+#include <utility>
+
+std::string semantic_tokens_worker::result_id() const {
+    std::lock_guard lock(_mutex);
+    return _result_id;
+}
+
+std::optional<lsptypes::token_batch> semantic_tokens_worker::request_sent(const std::string& id, lsptypes::tokens_request request) {
+    std::optional<lsptypes::semantic_tokens_payload> early_answer;
+    {
+        std::lock_guard lock(_mutex);
+        if (auto node = _unclaimed.extract(id) ; !node.empty()) {
+            early_answer = std::move(node.mapped());
+        }
+        // requests are registered as soon as they are sent: anything else left here was for a forgotten request
+        _unclaimed.clear();
+        _requests.insert_or_assign(id, std::move(request));
+    }
+
+    if (!early_answer) {
+        return {};
+    }
+    return process(id, std::move(*early_answer));
+}
+
+std::optional<lsptypes::token_batch> semantic_tokens_worker::process(const std::string& id, lsptypes::semantic_tokens_payload payload) {
+    lsptypes::tokens_request request;
+    {
+        std::lock_guard lock(_mutex);
+        auto node = _requests.extract(id);
+        if (node.empty()) {
+            _unclaimed.insert_or_assign(id, std::move(payload));
+            return {};
+        }
+        request = std::move(node.mapped());
+    }
+
+    return make_batch(request, std::move(payload));
+}
+
+void semantic_tokens_worker::forget(const std::string& id) {
+    std::lock_guard lock(_mutex);
+    _requests.erase(id);
+    _unclaimed.erase(id);
+}
+
+void semantic_tokens_worker::reset() {
+    {
+        std::lock_guard lock(_cache_mutex);
+        _cache = {};
+    }
+    std::lock_guard lock(_mutex);
+    _result_id.clear();
+    _requests.clear();
+    _unclaimed.clear();
+}
+
+std::size_t semantic_tokens_worker::cache_size() const {
+    std::lock_guard lock(_cache_mutex);
+    return _cache.byte_size();
+}
+
+lsptypes::token_batch semantic_tokens_worker::make_batch(const lsptypes::tokens_request& request, lsptypes::semantic_tokens_payload payload) {
+    lsptypes::token_batch batch{
+        .version = request.version,
+        .is_range = request.type == lsptypes::tokens_request::kind::range
+    };
+    if (payload.is_null) {
+        return batch;
+    }
+
+    bool up_to_date = request.version == _document_version;
+
+    if (batch.is_range) {
+        batch.changed_lines = request.lines;
+        if (up_to_date) {
+            // range answers are encoded like full ones, but only hold the tokens of the requested lines
+            semantic_tokens_cache range_tokens;
+            range_tokens.replace({}, std::move(payload.data));
+            batch.tokens = token_store::build(range_tokens, request.lines, *_token_styles);
+        }
+        return batch;
+    }
+
+    std::lock_guard cache_lock(_cache_mutex);
+    std::optional<lsptypes::line_range> changed_lines;
+    if (!payload.is_delta) {
+        changed_lines = _cache.replace(std::move(payload.result_id), std::move(payload.data));
+    } else if (_cache.result_id() == request.previous_result_id) {
+        changed_lines = _cache.apply_edits(std::move(payload.result_id), std::move(payload.edits));
+    } else {
+        // the cache moved on since the request was sent, the edits apply to tokens we no longer have
+        _cache.clear();
+    }
+
+    if (changed_lines) {
+        batch.changed_lines = changed_lines->merged_with(request.lines);
+        if (up_to_date) {
+            batch.tokens = token_store::build(_cache, batch.changed_lines, *_token_styles);
+        }
+    } else {
+        batch.out_of_sync = true;
+    }
+
+    std::lock_guard lock(_mutex);
+    _result_id = _cache.result_id();
+    return batch;
+}
@@ -0,0 +1,93 @@
+#ifndef IMEDIT_LS_SEMANTIC_TOKENS_WORKER_H
+#define IMEDIT_LS_SEMANTIC_TOKENS_WORKER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <imedit/simple_types.h>
+
+#include "semantic_tokens.h"
+#include "semantic_tokens_decoder.h"
+#include "token_store.h"
+#include "token_styles.h"
+
+namespace lsptypes {
+    struct tokens_request {
+        enum class kind {
+            full,
+            delta,
+            range
+        } type{kind::full};
+
+        int version{}; // document version the request was sent for
+        // range requests: the requested lines. Others: lines to refresh even if their tokens did not change
+        line_range lines{};
+        std::string previous_result_id{}; // delta requests only
+    };
+
+    struct token_batch {
+        int version{};
+        bool is_range{false};
+        // a delta did not fit the cached tokens, which were dropped
+        bool out_of_sync{false};
+        line_range changed_lines{};
+        // only built if the batch was still up-to-date when decoded
+        token_store tokens{};
+    };
+}
+
+// Owns the semantic tokens cache of a document, and turns the answers to semantic tokens requests into
+// token_stores from the thread reading the server's messages, so that the render loop only has to hand them
+// to the editor.
+// Answers can arrive before their request is registered: they are then kept, and processed on registration.
+class semantic_tokens_worker {
+public:
+    // must be set before any token is requested
+    void set_token_styles(std::shared_ptr<const token_style_table> token_styles) {
+        _token_styles = std::move(token_styles);
+    }
+
+    // answers to requests sent for older versions only update the cache
+    void set_document_version(int version) noexcept {
+        _document_version = version;
+    }
+
+    [[nodiscard]] std::string result_id() const;
+
+    // Registers the request sent with the given id. Must be called right after sending, from the thread sending
+    // token requests. Returns the batch for its answer if it was already received.
+    [[nodiscard]] std::optional<lsptypes::token_batch> request_sent(const std::string& id, lsptypes::tokens_request request);
+
+    // Returns the batch for the answer, or nothing if its request is not registered
+    [[nodiscard]] std::optional<lsptypes::token_batch> process(const std::string& id, lsptypes::semantic_tokens_payload payload);
+
+    void forget(const std::string& id);
+
+    // Forgets every request and the cached tokens, for a new server or a closed document
+    void reset();
+
+    // memory held by the cached tokens
+    [[nodiscard]] std::size_t cache_size() const;
+
+private:
+    lsptypes::token_batch make_batch(const lsptypes::tokens_request& request, lsptypes::semantic_tokens_payload payload);
+
+    std::shared_ptr<const token_style_table> _token_styles{std::make_shared<const token_style_table>()};
+    std::atomic_int _document_version{};
+
+    mutable std::mutex _cache_mutex{};
+    semantic_tokens_cache _cache{};
+
+    mutable std::mutex _mutex{};
+    std::string _result_id{};
+    std::unordered_map<std::string, lsptypes::tokens_request> _requests{};
+    std::unordered_map<std::string, lsptypes::semantic_tokens_payload> _unclaimed{};
+};
+
+
+#endif //IMEDIT_LS_SEMANTIC_TOKENS_WORKER_H
@@ -0,0 +1,79 @@
+#include "server_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+void server_pool::register_language(std::string language_id, std::filesystem::path path_to_language_server, lsptypes::server_options options) {
+    _languages.insert_or_assign(std::move(language_id), language_server{std::move(path_to_language_server), std::move(options)});
+}
+
+clangd_server& server_pool::add_editor(ImEdit::editor& editor, std::string uri, const std::string& language_id, const std::string& workspace_root) {
+    remove_editor(editor);
+
+    auto language = _languages.find(language_id);
+    if (language == _languages.end()) {
+        throw std::runtime_error("No language server registered for \"" + language_id + "\"");
+    }
+
+    server_key key{language_id, workspace_root};
+    auto it = _servers.find(key);
+    if (it == _servers.end()) {
+        lsptypes::server_options options = language->second.options;
+        options.workspace_root = workspace_root;
+        it = _servers.emplace(std::move(key), std::make_unique<clangd_server>(language->second.path, std::move(options))).first;
+    }
+
+    clangd_server& server = *it->second;
+    server.add_editor(editor, std::move(uri), language_id);
+    _editors[&editor] = &server;
+    return server;
+}
+
+void server_pool::remove_editor(ImEdit::editor& editor) {
+    auto it = _editors.find(&editor);
+    if (it == _editors.end()) {
+        return;
+    }
+
+    // a server left without editors is stopped by the next poll
+    it->second->remove_editor(editor);
+    _editors.erase(it);
+}
+
+void server_pool::show(ImEdit::editor& editor, lsptypes::line_range visible_lines) {
+    if (auto it = _editors.find(&editor) ; it != _editors.end()) {
+        it->second->show(editor, visible_lines);
+    }
+}
+
+void server_pool::poll() {
+    std::erase_if(_servers, [](const auto& entry) {
+        clangd_server& server = *entry.second;
+        if (server.document_count() != 0) {
+            return false;
+        }
+
+        // stopped over the next polls rather than waited for, then dropped once its process is gone: the
+        // destructor would block until then
+        server.stop();
+        return server.state() == lsptypes::server_state::stopped || server.state() == lsptypes::server_state::failed;
+    });
+
+    for (const auto& entry : _servers) {
+        entry.second->poll();
+    }
+}
+
+clangd_server::clock::time_point server_pool::next_poll() const {
+    auto next = clangd_server::clock::time_point::max();
+    for (const auto& entry : _servers) {
+        next = std::min(next, entry.second->next_poll());
+    }
+    return next;
+}
+
+clangd_server* server_pool::server_of(const ImEdit::editor& editor) const noexcept {
+    auto it = _editors.find(&editor);
+    return it == _editors.end() ? nullptr : it->second;
+}
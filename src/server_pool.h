@@ -0,0 +1,62 @@
+#ifndef IMEDIT_LS_SERVER_POOL_H
+#define IMEDIT_LS_SERVER_POOL_H
+
+#include <compare>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "clangd_server.h"
+
+// Language servers of several languages and workspaces, each in its own process with its own reader thread, and
+// the editors bound to them. A server is started when its first editor is added, and stopped once its last one
+// is removed. All of them are drained from the render loop by poll, a slow one only delaying its own documents.
+class server_pool {
+public:
+    // documents of language_id are handled by the server at path_to_language_server
+    void register_language(std::string language_id, std::filesystem::path path_to_language_server, lsptypes::server_options options = {});
+
+    // Binds the editor to the server of its language and workspace, starting it if needed. Throws if the language
+    // was not registered
+    clangd_server& add_editor(ImEdit::editor& editor, std::string uri, const std::string& language_id, const std::string& workspace_root);
+    void remove_editor(ImEdit::editor& editor);
+
+    // To be called every frame for each shown editor
+    void show(ImEdit::editor& editor, lsptypes::line_range visible_lines);
+    // To be called once per frame, after the editors were shown
+    void poll();
+
+    // earliest clangd_server::next_poll of the servers
+    [[nodiscard]] clangd_server::clock::time_point next_poll() const;
+
+    [[nodiscard]] clangd_server* server_of(const ImEdit::editor& editor) const noexcept;
+
+    template <typename FuncT>
+    void for_each_server(FuncT&& func) const {
+        for (const auto& [key, server] : _servers) {
+            func(key.language_id, key.workspace_root, *server);
+        }
+    }
+
+private:
+    struct language_server {
+        std::filesystem::path path;
+        lsptypes::server_options options;
+    };
+
+    struct server_key {
+        std::string language_id;
+        std::string workspace_root;
+
+        auto operator<=>(const server_key&) const = default;
+    };
+
+    std::unordered_map<std::string, language_server> _languages{};
+    std::map<server_key, std::unique_ptr<clangd_server>> _servers{};
+    std::unordered_map<const ImEdit::editor*, clangd_server*> _editors{};
+};
+
+
+#endif //IMEDIT_LS_SERVER_POOL_H
@@ -0,0 +1,56 @@
+#ifndef IMEDIT_LS_SERVER_RESULTS_H
+#define IMEDIT_LS_SERVER_RESULTS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <lsp/messages.h>
+
+#include "completion_cache.h"
+#include "diagnostics.h"
+#include "semantic_tokens_worker.h"
+#include "symbol_cache.h"
+
+namespace lsptypes {
+    struct tokens_result {
+        std::uint64_t document{}; // id of the managed_document the tokens are for
+        std::string id{};
+        token_batch batch{};
+    };
+
+    struct diagnostics_result {
+        std::uint64_t document{};
+        std::shared_ptr<const diagnostic_index> diagnostics{};
+    };
+
+    struct completion_result {
+        std::string id{}; // of the list request
+        bool failed{false}; // cancelled, or the server could not complete
+        bool incomplete{false};
+        std::vector<completion_item> items{};
+        std::vector<lsp::CompletionItem> server_items{}; // sent back as is to completionItem/resolve
+    };
+
+    struct completion_resolve_result {
+        std::uint64_t list{}; // the item belongs to, see clangd_server::completion_session
+        std::uint32_t item{};
+        bool failed{false};
+        completion_item resolved{};
+        lsp::CompletionItem server_item{};
+    };
+
+    struct symbol_result {
+        std::string id{}; // of the symbol request
+        bool failed{false};
+        symbol_answer answer{};
+    };
+
+    // Results handed over from the thread reading the server's messages to the render loop, ready to be applied
+    using server_result = std::variant<tokens_result, diagnostics_result, completion_result, completion_resolve_result, symbol_result>;
+}
+
+
+#endif //IMEDIT_LS_SERVER_RESULTS_H
@@ -0,0 +1,62 @@
+#ifndef IMEDIT_LS_SPSC_QUEUE_H
+#define IMEDIT_LS_SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread
+template <typename T, std::size_t Capacity>
+class spsc_queue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer only. Returns false, leaving value untouched, if the queue is full
+    bool try_push(T& value) {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _producer_cached_head == Capacity) {
+            _producer_cached_head = _head.load(std::memory_order_acquire);
+            if (tail - _producer_cached_head == Capacity) {
+                return false;
+            }
+        }
+
+        _slots[tail & index_mask].emplace(std::move(value));
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    std::optional<T> try_pop() {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _consumer_cached_tail) {
+            _consumer_cached_tail = _tail.load(std::memory_order_acquire);
+            if (head == _consumer_cached_tail) {
+                return {};
+            }
+        }
+
+        std::optional<T>& slot = _slots[head & index_mask];
+        std::optional<T> value = std::move(slot);
+        slot.reset();
+        _head.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+private:
+    static constexpr std::size_t index_mask = Capacity - 1;
+    static constexpr std::size_t cache_line = 64;
+
+    // each side only reads the other side's index when its cached copy says the queue is full/empty
+    alignas(cache_line) std::atomic_size_t _head{};
+    std::size_t _consumer_cached_tail{};
+
+    alignas(cache_line) std::atomic_size_t _tail{};
+    std::size_t _producer_cached_head{};
+
+    alignas(cache_line) std::array<std::optional<T>, Capacity> _slots{};
+};
+
+
+#endif //IMEDIT_LS_SPSC_QUEUE_H
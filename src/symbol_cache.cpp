@@ -0,0 +1,113 @@
+#include "symbol_cache.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+    auto line_key(std::uint64_t document, const lsptypes::symbol_range& range) noexcept {
+        return std::make_tuple(document, range.line, range.first);
+    }
+
+    // documents are opened with bare paths, which the server may give back as file uris
+    bool same_uri(std::string_view location_uri, std::string_view uri) noexcept {
+        if (location_uri.starts_with("file://") && !uri.starts_with("file://")) {
+            location_uri.remove_prefix(7);
+        }
+        return location_uri == uri;
+    }
+}
+
+const lsptypes::symbol_answer* symbol_cache::find(std::uint64_t document, lsptypes::symbol_query query, lsptypes::position pos) noexcept {
+    auto it = std::lower_bound(_entries.begin(), _entries.end(), std::make_tuple(document, pos.line), [](const entry& e, const auto& key) {
+        return std::make_tuple(e.document, e.range.line) < key;
+    });
+    for (; it != _entries.end() && it->document == document && it->range.line == pos.line ; ++it) {
+        if (it->query == query && it->range.contains(pos)) {
+            it->last_used = ++_uses;
+            return &it->answer;
+        }
+    }
+    return nullptr;
+}
+
+std::uint64_t symbol_cache::generation(std::uint64_t document) const noexcept {
+    auto it = _generations.find(document);
+    return it == _generations.end() ? 0 : it->second;
+}
+
+void symbol_cache::store(std::uint64_t document, std::uint64_t generation, lsptypes::symbol_query query, lsptypes::symbol_range range,
+                         lsptypes::symbol_answer answer) {
+    if (generation != this->generation(document) || _max_entries == 0) {
+        return;
+    }
+
+    if (_entries.size() >= _max_entries) {
+        _entries.erase(std::min_element(_entries.begin(), _entries.end(), [](const entry& lhs, const entry& rhs) {
+            return lhs.last_used < rhs.last_used;
+        }));
+    }
+
+    auto it = std::upper_bound(_entries.begin(), _entries.end(), line_key(document, range), [](const auto& key, const entry& e) {
+        return key < line_key(e.document, e.range);
+    });
+    _entries.insert(it, entry{
+            .document = document,
+            .query = query,
+            .range = range,
+            .answer = std::move(answer),
+            .last_used = ++_uses
+    });
+}
+
+void symbol_cache::lines_replaced(std::uint64_t document, std::string_view uri, unsigned int first_line, unsigned int old_line_count,
+                                  unsigned int new_line_count) {
+    ++_generations[document];
+
+    const unsigned int old_end = first_line + old_line_count;
+    auto touched = [first_line, old_end](unsigned int first, unsigned int last) {
+        return first < old_end && last >= first_line;
+    };
+    auto shifted = [old_line_count, new_line_count](unsigned int line) {
+        return line - old_line_count + new_line_count;
+    };
+
+    std::erase_if(_entries, [&](const entry& e) {
+        if (e.document != document) {
+            return false;
+        }
+        return touched(e.range.line, e.range.line) || std::ranges::any_of(e.answer.locations, [&](const lsptypes::location& location) {
+            return same_uri(location.uri, uri) && touched(location.start.line, location.end.line);
+        });
+    });
+
+    // the others move along with their lines, which keeps the entries sorted
+    for (entry& e : _entries) {
+        if (e.document != document) {
+            continue;
+        }
+        if (e.range.line >= old_end) {
+            e.range.line = shifted(e.range.line);
+        }
+        for (lsptypes::location& location : e.answer.locations) {
+            if (same_uri(location.uri, uri) && location.start.line >= old_end) {
+                location.start.line = shifted(location.start.line);
+                location.end.line = shifted(location.end.line);
+            }
+        }
+    }
+}
+
+void symbol_cache::forget(std::uint64_t document) {
+    ++_generations[document];
+    std::erase_if(_entries, [document](const entry& e) {
+        return e.document == document;
+    });
+}
+
+void symbol_cache::clear() {
+    _entries.clear();
+    // answers still on their way are not stored either
+    for (auto& [document, generation] : _generations) {
+        ++generation;
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef IMEDIT_LS_SYMBOL_CACHE_H
+#define IMEDIT_LS_SYMBOL_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "text_document.h"
+
+namespace lsptypes {
+    enum class symbol_query : std::uint8_t {
+        hover,
+        definition,
+        declaration,
+        type_definition,
+        implementation,
+        signature_help
+    };
+
+    // in the server's coordinates
+    struct location {
+        std::string uri{};
+        position start{};
+        position end{};
+    };
+
+    struct symbol_answer {
+        std::string text{}; // hover contents, or the active signature and its documentation
+        std::vector<location> locations{};
+    };
+
+    // glyphs [first, last) of the line, in editor coordinates
+    struct symbol_range {
+        unsigned int line{};
+        unsigned int first{};
+        unsigned int last{};
+
+        // the position just past the symbol counts, as the cursor is there right after typing it
+        [[nodiscard]] bool contains(position pos) const noexcept {
+            return pos.line == line && first <= pos.character && pos.character <= last;
+        }
+    };
+}
+
+// Answers of the server about symbols, kept for the symbol's range of the document. Edits only drop the answers
+// about the lines they touched: the others are moved along with their lines
+class symbol_cache {
+public:
+    explicit symbol_cache(std::size_t max_entries) noexcept : _max_entries{max_entries} {}
+
+    // nullptr if not known
+    [[nodiscard]] const lsptypes::symbol_answer* find(std::uint64_t document, lsptypes::symbol_query query, lsptypes::position pos) noexcept;
+
+    // Edits done to the document so far. Answers to requests sent before the last edit are not stored, as their
+    // range may have moved
+    [[nodiscard]] std::uint64_t generation(std::uint64_t document) const noexcept;
+    void store(std::uint64_t document, std::uint64_t generation, lsptypes::symbol_query query, lsptypes::symbol_range range,
+               lsptypes::symbol_answer answer);
+
+    // old_line_count lines starting at first_line were replaced by new_line_count lines, in the document at uri
+    void lines_replaced(std::uint64_t document, std::string_view uri, unsigned int first_line, unsigned int old_line_count,
+                        unsigned int new_line_count);
+    void forget(std::uint64_t document);
+    void clear();
+
+    [[nodiscard]] std::size_t size() const noexcept {
+        return _entries.size();
+    }
+
+private:
+    struct entry {
+        std::uint64_t document{};
+        lsptypes::symbol_query query{};
+        lsptypes::symbol_range range{};
+        lsptypes::symbol_answer answer{};
+        std::uint64_t last_used{};
+    };
+
+    std::size_t _max_entries;
+    std::vector<entry> _entries{}; // sorted by document, line then first glyph
+    std::unordered_map<std::uint64_t, std::uint64_t> _generations{};
+    std::uint64_t _uses{};
+};
+
+
+#endif //IMEDIT_LS_SYMBOL_CACHE_H
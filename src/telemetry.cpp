@@ -0,0 +1,229 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+    constexpr std::array<std::string_view, static_cast<std::size_t>(lsptypes::lsp_method::count)> method_names{
+        "initialize",
+        "shutdown",
+        "textDocument/semanticTokens/full",
+        "textDocument/semanticTokens/full/delta",
+        "textDocument/semanticTokens/range",
+        "textDocument/completion",
+        "completionItem/resolve",
+        "textDocument/hover",
+        "textDocument/definition",
+        "other",
+    };
+
+    std::uint64_t to_us(lsp_telemetry::clock::duration duration) noexcept {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        return us < 0 ? 0 : static_cast<std::uint64_t>(us);
+    }
+
+    void append_histogram(std::string& out, const lsptypes::histogram_snapshot& histogram) {
+        out += "{\"count\":" + std::to_string(histogram.count);
+        out += ",\"mean\":" + std::to_string(histogram.mean());
+        out += ",\"p50\":" + std::to_string(histogram.percentile(50));
+        out += ",\"p90\":" + std::to_string(histogram.percentile(90));
+        out += ",\"p99\":" + std::to_string(histogram.percentile(99));
+        out += ",\"max\":" + std::to_string(histogram.max);
+        out += '}';
+    }
+}
+
+std::uint64_t lsptypes::histogram_snapshot::percentile(double p) const noexcept {
+    if (count == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<std::uint64_t>(std::ceil(p / 100 * static_cast<double>(count)));
+    rank = std::clamp<std::uint64_t>(rank, 1, count);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0 ; i < bucket_count ; ++i) {
+        if (seen + buckets[i] >= rank) {
+            if (i == 0) {
+                return 0;
+            }
+            // values are assumed evenly spread over the bucket
+            auto lower_bound = static_cast<double>(std::uint64_t{1} << (i - 1));
+            double fraction = static_cast<double>(rank - seen) / static_cast<double>(buckets[i]);
+            return std::min(static_cast<std::uint64_t>(lower_bound + fraction * lower_bound), max);
+        }
+        seen += buckets[i];
+    }
+    // buckets and count are read one after the other, and may be slightly out of step
+    return max;
+}
+
+void lsptypes::log2_histogram::record(std::uint64_t value) noexcept {
+    auto bucket = std::min<std::size_t>(static_cast<std::size_t>(std::bit_width(value)), histogram_snapshot::bucket_count - 1);
+    _buckets[bucket].add(1);
+    _count.add(1);
+    _sum.add(value);
+    if (value > _max.load(std::memory_order_relaxed)) {
+        _max.store(value, std::memory_order_relaxed);
+    }
+}
+
+lsptypes::histogram_snapshot lsptypes::log2_histogram::snapshot() const noexcept {
+    histogram_snapshot snapshot;
+    for (std::size_t i = 0 ; i < histogram_snapshot::bucket_count ; ++i) {
+        snapshot.buckets[i] = _buckets[i].value();
+    }
+    snapshot.count = _count.value();
+    snapshot.sum = _sum.value();
+    snapshot.max = _max.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+lsptypes::lsp_method lsptypes::lsp_method_from_name(std::string_view name) noexcept {
+    auto it = std::find(method_names.begin(), method_names.end() - 1, name);
+    return static_cast<lsp_method>(it - method_names.begin());
+}
+
+std::string_view lsptypes::lsp_method_name(lsp_method method) noexcept {
+    return method_names[std::min(static_cast<std::size_t>(method), method_names.size() - 1)];
+}
+
+std::string lsptypes::to_json(const telemetry_snapshot& snapshot) {
+    std::string out = "{\"bytes_sent\":" + std::to_string(snapshot.bytes_sent);
+    out += ",\"bytes_received\":" + std::to_string(snapshot.bytes_received);
+    out += ",\"in_flight\":" + std::to_string(snapshot.in_flight);
+    out += ",\"cancelled\":" + std::to_string(snapshot.cancelled);
+    out += ",\"restarts\":" + std::to_string(snapshot.restarts);
+    out += ",\"untracked_answers\":" + std::to_string(snapshot.untracked_answers);
+    out += ",\"pending_token_requests\":" + std::to_string(snapshot.pending_token_requests);
+    out += ",\"token_decode_us\":";
+    append_histogram(out, snapshot.token_decode_us);
+    out += ",\"tokens_applied\":";
+    append_histogram(out, snapshot.tokens_applied);
+    out += ",\"results_per_frame\":";
+    append_histogram(out, snapshot.results_per_frame);
+
+    out += ",\"methods\":{";
+    bool first = true;
+    for (const method_snapshot& method : snapshot.methods) {
+        if (method.sent == 0 && method.answered == 0) {
+            continue;
+        }
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+
+        // method names never need escaping
+        out += '"';
+        out += lsp_method_name(method.method);
+        out += "\":{\"sent\":" + std::to_string(method.sent);
+        out += ",\"answered\":" + std::to_string(method.answered);
+        out += ",\"errors\":" + std::to_string(method.errors);
+        out += ",\"latency_us\":";
+        append_histogram(out, method.latency_us);
+        out += '}';
+    }
+    out += "}}";
+    return out;
+}
+
+std::uint64_t lsp_telemetry::request_key(std::string_view id) noexcept {
+    // FNV-1a, 0 is kept for free slots
+    std::uint64_t hash = 14695981039346656037ull;
+    for (char c : id) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+void lsp_telemetry::request_sent(std::string_view id, std::string_view method, clock::time_point now) noexcept {
+    lsptypes::lsp_method m = lsptypes::lsp_method_from_name(method);
+    _methods[static_cast<std::size_t>(m)].sent.add(1);
+
+    std::uint64_t key = request_key(id);
+    in_flight_request& slot = _in_flight[key % in_flight_table_size];
+    slot.method.store(m, std::memory_order_relaxed);
+    slot.sent_at.store(now.time_since_epoch().count(), std::memory_order_relaxed);
+    slot.key.store(key, std::memory_order_release);
+}
+
+void lsp_telemetry::request_cancelled() noexcept {
+    _cancelled.add(1);
+}
+
+void lsp_telemetry::server_restarted() noexcept {
+    _restarts.add(1);
+    _abandoned_requests.add(snapshot().in_flight);
+    for (in_flight_request& slot : _in_flight) {
+        slot.key.store(0, std::memory_order_relaxed);
+    }
+}
+
+void lsp_telemetry::response_received(std::string_view id, bool is_error, clock::time_point now) noexcept {
+    std::uint64_t key = request_key(id);
+    in_flight_request& slot = _in_flight[key % in_flight_table_size];
+    if (slot.key.load(std::memory_order_acquire) != key) {
+        _untracked_answers.add(1);
+        return;
+    }
+
+    lsptypes::lsp_method method = slot.method.load(std::memory_order_relaxed);
+    clock::time_point sent_at{clock::duration{slot.sent_at.load(std::memory_order_relaxed)}};
+    if (!slot.key.compare_exchange_strong(key, 0, std::memory_order_relaxed)) {
+        // reused by a new request in the meantime
+        _untracked_answers.add(1);
+        return;
+    }
+
+    method_counters& counters = _methods[static_cast<std::size_t>(method)];
+    counters.answered.add(1);
+    if (is_error) {
+        counters.errors.add(1);
+    }
+    counters.latency_us.record(to_us(now - sent_at));
+}
+
+void lsp_telemetry::tokens_decoded(clock::duration duration) noexcept {
+    _token_decode_us.record(to_us(duration));
+}
+
+void lsp_telemetry::tokens_applied(std::size_t token_count) noexcept {
+    _tokens_applied.record(token_count);
+}
+
+void lsp_telemetry::results_processed(std::size_t result_count, std::size_t pending_token_requests) noexcept {
+    if (result_count != 0) {
+        _results_per_frame.record(result_count);
+    }
+    _pending_token_requests.store(pending_token_requests, std::memory_order_relaxed);
+}
+
+lsptypes::telemetry_snapshot lsp_telemetry::snapshot() const noexcept {
+    lsptypes::telemetry_snapshot snapshot;
+    std::uint64_t sent = 0;
+    std::uint64_t answered = 0;
+    for (std::size_t i = 0 ; i < _methods.size() ; ++i) {
+        const method_counters& counters = _methods[i];
+        lsptypes::method_snapshot& method = snapshot.methods[i];
+        method.method = static_cast<lsptypes::lsp_method>(i);
+        method.sent = counters.sent.value();
+        method.answered = counters.answered.value();
+        method.errors = counters.errors.value();
+        method.latency_us = counters.latency_us.snapshot();
+        sent += method.sent;
+        answered += method.answered;
+    }
+
+    snapshot.cancelled = _cancelled.value();
+    snapshot.untracked_answers = _untracked_answers.value();
+    // answers may be counted before the matching sends are visible to this thread
+    answered += snapshot.untracked_answers + _abandoned_requests.value();
+    snapshot.in_flight = sent - std::min(sent, answered);
+    snapshot.restarts = _restarts.value();
+    snapshot.pending_token_requests = _pending_token_requests.load(std::memory_order_relaxed);
+    snapshot.token_decode_us = _token_decode_us.snapshot();
+    snapshot.tokens_applied = _tokens_applied.snapshot();
+    snapshot.results_per_frame = _results_per_frame.snapshot();
+    return snapshot;
+}
@@ -0,0 +1,158 @@
+#ifndef IMEDIT_LS_TELEMETRY_H
+#define IMEDIT_LS_TELEMETRY_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace lsptypes {
+    // Counter written by a single thread and read by any: plain loads and stores, no read-modify-write
+    class single_writer_counter {
+    public:
+        void add(std::uint64_t n) noexcept {
+            _value.store(_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] std::uint64_t value() const noexcept {
+            return _value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic_uint64_t _value{};
+    };
+
+    struct histogram_snapshot {
+        static constexpr std::size_t bucket_count = 40;
+
+        std::array<std::uint64_t, bucket_count> buckets{}; // bucket i counts values in [2^(i-1), 2^i), bucket 0 counts 0
+        std::uint64_t count{};
+        std::uint64_t sum{};
+        std::uint64_t max{};
+
+        // pth percentile (p in [0, 100]), interpolated within its bucket
+        [[nodiscard]] std::uint64_t percentile(double p) const noexcept;
+        [[nodiscard]] double mean() const noexcept {
+            return count == 0 ? 0 : static_cast<double>(sum) / static_cast<double>(count);
+        }
+    };
+
+    // Histogram with power of two buckets, written by a single thread and read by any
+    class log2_histogram {
+    public:
+        void record(std::uint64_t value) noexcept;
+
+        [[nodiscard]] histogram_snapshot snapshot() const noexcept;
+
+    private:
+        std::array<single_writer_counter, histogram_snapshot::bucket_count> _buckets{};
+        single_writer_counter _count{};
+        single_writer_counter _sum{};
+        std::atomic_uint64_t _max{};
+    };
+
+    // LSP methods with their own statistics
+    enum class lsp_method : std::uint8_t {
+        initialize,
+        shutdown,
+        semantic_tokens_full,
+        semantic_tokens_delta,
+        semantic_tokens_range,
+        completion,
+        completion_resolve,
+        hover,
+        definition,
+        other,
+        count
+    };
+
+    [[nodiscard]] lsp_method lsp_method_from_name(std::string_view name) noexcept;
+    [[nodiscard]] std::string_view lsp_method_name(lsp_method method) noexcept;
+
+    struct method_snapshot {
+        lsp_method method{};
+        std::uint64_t sent{};
+        std::uint64_t answered{};
+        std::uint64_t errors{};
+        histogram_snapshot latency_us{};
+    };
+
+    struct telemetry_snapshot {
+        std::array<method_snapshot, static_cast<std::size_t>(lsp_method::count)> methods{};
+        std::uint64_t bytes_sent{};
+        std::uint64_t bytes_received{};
+        std::uint64_t in_flight{}; // requests sent and not answered yet
+        std::uint64_t cancelled{};
+        std::uint64_t restarts{};
+        std::uint64_t untracked_answers{}; // answers whose request had been evicted from the in-flight table
+        std::uint64_t pending_token_requests{};
+        histogram_snapshot token_decode_us{};
+        histogram_snapshot tokens_applied{};
+        histogram_snapshot results_per_frame{};
+    };
+
+    // Writes the snapshot as a single JSON object
+    [[nodiscard]] std::string to_json(const telemetry_snapshot& snapshot);
+}
+
+// Client side instrumentation of the language server connection. Each kind of event is only ever recorded from
+// one thread, so recording is a few relaxed stores, and snapshots can be taken from any thread at any time.
+class lsp_telemetry {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // from the thread writing to the server
+    void request_sent(std::string_view id, std::string_view method, clock::time_point now) noexcept;
+    void request_cancelled() noexcept;
+    // also forgets the requests in flight, their answers will never come. The reader thread must be stopped
+    void server_restarted() noexcept;
+
+    // from the thread reading the server's messages
+    void response_received(std::string_view id, bool is_error, clock::time_point now) noexcept;
+    void tokens_decoded(clock::duration duration) noexcept;
+
+    // from the render loop
+    void tokens_applied(std::size_t token_count) noexcept;
+    void results_processed(std::size_t result_count, std::size_t pending_token_requests) noexcept;
+
+    // bytes are counted by the transport and filled in by the caller
+    [[nodiscard]] lsptypes::telemetry_snapshot snapshot() const noexcept;
+
+private:
+    // requests are found back by id hash in a fixed table, a request not answered yet is evicted by any later one
+    // landing in its slot
+    static constexpr std::size_t in_flight_table_size = 512;
+
+    struct in_flight_request {
+        std::atomic_uint64_t key{}; // 0 when free
+        std::atomic<clock::rep> sent_at{};
+        std::atomic<lsptypes::lsp_method> method{};
+    };
+
+    struct method_counters {
+        lsptypes::single_writer_counter sent{};
+        lsptypes::single_writer_counter answered{};
+        lsptypes::single_writer_counter errors{};
+        lsptypes::log2_histogram latency_us{};
+    };
+
+    [[nodiscard]] static std::uint64_t request_key(std::string_view id) noexcept;
+
+    std::array<in_flight_request, in_flight_table_size> _in_flight{};
+    std::array<method_counters, static_cast<std::size_t>(lsptypes::lsp_method::count)> _methods{};
+
+    lsptypes::single_writer_counter _cancelled{};
+    lsptypes::single_writer_counter _restarts{};
+    lsptypes::single_writer_counter _abandoned_requests{}; // in flight when the server was restarted
+    lsptypes::single_writer_counter _untracked_answers{};
+    std::atomic_uint64_t _pending_token_requests{};
+    lsptypes::log2_histogram _token_decode_us{};
+    lsptypes::log2_histogram _tokens_applied{};
+    lsptypes::log2_histogram _results_per_frame{};
+};
+
+
+#endif //IMEDIT_LS_TELEMETRY_H
@@ -0,0 +1,82 @@
+#include "telemetry_window.h"
+
+#include <imgui.h>
+
+namespace {
+    double to_ms(std::uint64_t us) noexcept {
+        return static_cast<double>(us) / 1000.;
+    }
+
+    void histogram_row(const char* name, const lsptypes::histogram_snapshot& histogram, double scale) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(name);
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(histogram.count));
+        for (double p : {50., 90., 99.}) {
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", static_cast<double>(histogram.percentile(p)) * scale);
+        }
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", static_cast<double>(histogram.max) * scale);
+    }
+}
+
+void show_telemetry_window(const lsptypes::telemetry_snapshot& snapshot, bool* open) {
+    if (!ImGui::Begin("LSP telemetry", open)) {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("sent: %.1f KiB, received: %.1f KiB", static_cast<double>(snapshot.bytes_sent) / 1024.,
+                static_cast<double>(snapshot.bytes_received) / 1024.);
+    ImGui::Text("in flight: %llu, cancelled: %llu, pending token requests: %llu",
+                static_cast<unsigned long long>(snapshot.in_flight), static_cast<unsigned long long>(snapshot.cancelled),
+                static_cast<unsigned long long>(snapshot.pending_token_requests));
+    ImGui::Text("server restarts: %llu", static_cast<unsigned long long>(snapshot.restarts));
+
+    constexpr ImGuiTableFlags table_flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+
+    ImGui::SeparatorText("Latency per method (ms)");
+    if (ImGui::BeginTable("methods", 7, table_flags)) {
+        for (const char* header : {"method", "sent", "answered", "errors", "p50", "p99", "max"}) {
+            ImGui::TableSetupColumn(header);
+        }
+        ImGui::TableHeadersRow();
+
+        for (const lsptypes::method_snapshot& method : snapshot.methods) {
+            if (method.sent == 0 && method.answered == 0) {
+                continue;
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            std::string_view name = lsptypes::lsp_method_name(method.method);
+            ImGui::TextUnformatted(name.data(), name.data() + name.size());
+            for (std::uint64_t count : {method.sent, method.answered, method.errors}) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(count));
+            }
+            for (double p : {50., 99.}) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", to_ms(method.latency_us.percentile(p)));
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", to_ms(method.latency_us.max));
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText("Client side");
+    if (ImGui::BeginTable("client", 6, table_flags)) {
+        for (const char* header : {"", "count", "p50", "p90", "p99", "max"}) {
+            ImGui::TableSetupColumn(header);
+        }
+        ImGui::TableHeadersRow();
+        histogram_row("token decoding (ms)", snapshot.token_decode_us, 1. / 1000.);
+        histogram_row("tokens per update", snapshot.tokens_applied, 1.);
+        histogram_row("results per frame", snapshot.results_per_frame, 1.);
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
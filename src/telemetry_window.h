@@ -0,0 +1,10 @@
+#ifndef IMEDIT_LS_TELEMETRY_WINDOW_H
+#define IMEDIT_LS_TELEMETRY_WINDOW_H
+
+#include "telemetry.h"
+
+// Draws the snapshot in its own ImGui window. 'open' works as with ImGui::Begin
+void show_telemetry_window(const lsptypes::telemetry_snapshot& snapshot, bool* open = nullptr);
+
+
+#endif //IMEDIT_LS_TELEMETRY_WINDOW_H
@@ -0,0 +1,132 @@
+#include "text_document.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+    bool is_continuation_byte(char c) noexcept {
+        return (static_cast<unsigned char>(c) & 0xC0u) == 0x80u;
+    }
+
+    std::string join_lines(const text_rope& rope, unsigned int first_line, unsigned int last_line) {
+        std::string str;
+        rope.for_each_line(first_line, last_line, [&str, first = true](std::string_view line) mutable {
+            if (!first) {
+                str += '\n';
+            }
+            str += line;
+            first = false;
+        });
+        return str;
+    }
+
+    std::string join_lines(const std::vector<std::string>& lines) {
+        std::string str;
+        for (auto it = lines.begin() ; it != lines.end() ; ++it) {
+            if (it != lines.begin()) {
+                str += '\n';
+            }
+            str += *it;
+        }
+        return str;
+    }
+
+    lsptypes::position offset_to_position(std::string_view str, std::size_t offset, unsigned int first_line, lsptypes::encoding enc) {
+        std::string_view head = str.substr(0, offset);
+        auto line_start = head.rfind('\n');
+        line_start = line_start == std::string_view::npos ? 0 : line_start + 1;
+
+        return {
+            .line = first_line + static_cast<unsigned int>(std::count(head.begin(), head.end(), '\n')),
+            .character = lsptypes::encoded_length(head.substr(line_start), enc)
+        };
+    }
+}
+
+unsigned int lsptypes::encoded_length(std::string_view str, encoding enc) noexcept {
+    if (enc == encoding::utf8) {
+        return static_cast<unsigned int>(str.size());
+    }
+
+    unsigned int length = 0;
+    for (char c : str) {
+        auto byte = static_cast<unsigned char>(c);
+        if (is_continuation_byte(c)) {
+            continue;
+        }
+        // codepoints outside of the BMP (4 bytes in utf-8) need a surrogate pair in utf-16
+        length += (enc == encoding::utf16 && byte >= 0xF0u) ? 2 : 1;
+    }
+    return length;
+}
+
+std::size_t lsptypes::encoded_prefix_size(std::string_view str, unsigned int length, encoding enc) noexcept {
+    if (enc == encoding::utf8) {
+        return std::min(static_cast<std::size_t>(length), str.size());
+    }
+
+    std::size_t size = 0;
+    while (size < str.size() && length > 0) {
+        auto byte = static_cast<unsigned char>(str[size]);
+        unsigned int units = (enc == encoding::utf16 && byte >= 0xF0u) ? 2 : 1;
+        // a position between the two halves of a surrogate pair is past the codepoint
+        length = length > units ? length - units : 0;
+        ++size;
+        while (size < str.size() && is_continuation_byte(str[size])) {
+            ++size;
+        }
+    }
+    return size;
+}
+
+text_document::text_document() : _rope({std::string{}}) {}
+
+std::string text_document::text() const {
+    return join_lines(_rope, 0, _rope.line_count());
+}
+
+std::size_t text_document::offset_of(lsptypes::position pos, lsptypes::encoding enc) const noexcept {
+    if (pos.line >= _rope.line_count()) {
+        return _rope.byte_size();
+    }
+    return _rope.line_offset(pos.line) + lsptypes::encoded_prefix_size(_rope.line(pos.line), pos.character, enc);
+}
+
+void text_document::assign(std::vector<std::string> lines) {
+    if (lines.empty()) {
+        lines.emplace_back();
+    }
+    _rope = text_rope(std::move(lines));
+}
+
+lsptypes::text_change text_document::replace_lines(unsigned int first_line, unsigned int old_line_count,
+                                                   std::vector<std::string> new_lines, lsptypes::encoding enc) {
+    assert(old_line_count > 0 && !new_lines.empty());
+    assert(first_line + old_line_count <= _rope.line_count());
+
+    std::string old_text = join_lines(_rope, first_line, first_line + old_line_count);
+    std::string new_text = join_lines(new_lines);
+
+    auto [old_mismatch, new_mismatch] = std::mismatch(old_text.begin(), old_text.end(), new_text.begin(), new_text.end());
+    std::size_t prefix = static_cast<std::size_t>(old_mismatch - old_text.begin());
+    while (prefix > 0 && prefix < old_text.size() && is_continuation_byte(old_text[prefix])) {
+        --prefix;
+    }
+
+    std::size_t max_suffix = std::min(old_text.size(), new_text.size()) - prefix;
+    auto [old_rmismatch, new_rmismatch] = std::mismatch(old_text.rbegin(), old_text.rbegin() + static_cast<std::ptrdiff_t>(max_suffix), new_text.rbegin());
+    std::size_t suffix = static_cast<std::size_t>(old_rmismatch - old_text.rbegin());
+    while (suffix > 0 && is_continuation_byte(old_text[old_text.size() - suffix])) {
+        --suffix;
+    }
+
+    lsptypes::text_change change{
+        .start = offset_to_position(old_text, prefix, first_line, enc),
+        .end = offset_to_position(old_text, old_text.size() - suffix, first_line, enc),
+        .text = new_text.substr(prefix, new_text.size() - prefix - suffix)
+    };
+
+    _rope = _rope.replaced(first_line, old_line_count, std::move(new_lines));
+
+    return change;
+}
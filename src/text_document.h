@@ -0,0 +1,78 @@
+#ifndef IMEDIT_LS_TEXT_DOCUMENT_H
+#define IMEDIT_LS_TEXT_DOCUMENT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "text_rope.h"
+
+namespace lsptypes {
+    enum class encoding {
+        utf8,
+        utf16,
+        utf32
+    };
+
+    struct position {
+        unsigned int line{};
+        unsigned int character{};
+    };
+
+    // A single ranged edit, with positions expressed in the encoding negotiated with the server
+    struct text_change {
+        position start{};
+        position end{};
+        std::string text{};
+    };
+
+    // Number of code units needed to represent the utf-8 string 'str' in the given encoding
+    [[nodiscard]] unsigned int encoded_length(std::string_view str, encoding enc) noexcept;
+
+    // Number of bytes of the utf-8 string 'str' taken by its first 'length' code units in the given encoding, the
+    // size of str if it is shorter
+    [[nodiscard]] std::size_t encoded_prefix_size(std::string_view str, unsigned int length, encoding enc) noexcept;
+}
+
+// Mirror of the text as the language server knows it. Lines are stored in utf-8, without their '\n', in a
+// persistent rope: snapshots are free, and edits cost the size of the edited lines rather than that of the text.
+class text_document {
+public:
+    text_document();
+
+    [[nodiscard]] unsigned int line_count() const noexcept {
+        return _rope.line_count();
+    }
+
+    [[nodiscard]] const std::string& line(unsigned int idx) const noexcept {
+        return _rope.line(idx);
+    }
+
+    [[nodiscard]] std::string text() const;
+
+    // size of text(), without building it
+    [[nodiscard]] std::size_t byte_size() const noexcept {
+        return _rope.byte_size();
+    }
+
+    // Immutable copy of the text, unaffected by the later edits
+    [[nodiscard]] const text_rope& snapshot() const noexcept {
+        return _rope;
+    }
+
+    // offset in text() of a position in the given encoding, in O(log n)
+    [[nodiscard]] std::size_t offset_of(lsptypes::position pos, lsptypes::encoding enc) const noexcept;
+
+    void assign(std::vector<std::string> lines);
+
+    // Replaces the lines [first_line, first_line + old_line_count) with new_lines, and returns the smallest
+    // change turning the old text into the new one
+    lsptypes::text_change replace_lines(unsigned int first_line, unsigned int old_line_count,
+                                        std::vector<std::string> new_lines, lsptypes::encoding enc);
+
+private:
+    text_rope _rope;
+};
+
+
+#endif //IMEDIT_LS_TEXT_DOCUMENT_H
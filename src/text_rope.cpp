@@ -0,0 +1,163 @@
+#include "text_rope.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace {
+    // leaves are built half full, so that typing a few lines does not split them right away
+    constexpr std::size_t max_leaf_lines = 64;
+    constexpr std::size_t built_leaf_lines = max_leaf_lines / 2;
+}
+
+struct text_rope::tree {
+    static int height(const node_ptr& n) noexcept {
+        return n ? n->height : -1;
+    }
+
+    static node_ptr leaf(std::vector<std::string> lines) {
+        auto n = std::make_shared<node>();
+        n->line_count = static_cast<unsigned int>(lines.size());
+        for (const std::string& line : lines) {
+            n->line_bytes += line.size();
+        }
+        n->lines = std::move(lines);
+        return n;
+    }
+
+    static node_ptr branch(node_ptr left, node_ptr right) {
+        auto n = std::make_shared<node>();
+        n->line_count = left->line_count + right->line_count;
+        n->line_bytes = left->line_bytes + right->line_bytes;
+        n->height = std::max(left->height, right->height) + 1;
+        n->left = std::move(left);
+        n->right = std::move(right);
+        return n;
+    }
+
+    // branch of subtrees whose heights differ by 2 at most, rotated back to a difference of 1
+    static node_ptr balanced(node_ptr left, node_ptr right) {
+        if (height(left) > height(right) + 1) {
+            if (height(left->left) >= height(left->right)) {
+                return branch(left->left, branch(left->right, std::move(right)));
+            }
+            return branch(branch(left->left, left->right->left), branch(left->right->right, std::move(right)));
+        }
+        if (height(right) > height(left) + 1) {
+            if (height(right->right) >= height(right->left)) {
+                return branch(branch(std::move(left), right->left), right->right);
+            }
+            return branch(branch(std::move(left), right->left->left), branch(right->left->right, right->right));
+        }
+        return branch(std::move(left), std::move(right));
+    }
+
+    // the lines of lhs followed by those of rhs
+    static node_ptr join(const node_ptr& lhs, const node_ptr& rhs) {
+        if (!lhs || lhs->line_count == 0) {
+            return rhs;
+        }
+        if (!rhs || rhs->line_count == 0) {
+            return lhs;
+        }
+        if (!lhs->left && !rhs->left && lhs->line_count + rhs->line_count <= max_leaf_lines) {
+            // small neighbours are merged, which keeps the leaves full as edits split them
+            std::vector<std::string> lines;
+            lines.reserve(lhs->line_count + rhs->line_count);
+            lines.insert(lines.end(), lhs->lines.begin(), lhs->lines.end());
+            lines.insert(lines.end(), rhs->lines.begin(), rhs->lines.end());
+            return leaf(std::move(lines));
+        }
+        if (lhs->height > rhs->height + 1) {
+            return balanced(lhs->left, join(lhs->right, rhs));
+        }
+        if (rhs->height > lhs->height + 1) {
+            return balanced(join(lhs, rhs->left), rhs->right);
+        }
+        return branch(lhs, rhs);
+    }
+
+    // {the first count lines of n, the others}
+    static std::pair<node_ptr, node_ptr> split(const node_ptr& n, unsigned int count) {
+        if (count == 0) {
+            return {nullptr, n};
+        }
+        if (count >= n->line_count) {
+            return {n, nullptr};
+        }
+        if (!n->left) {
+            auto middle = n->lines.begin() + count;
+            return {leaf({n->lines.begin(), middle}), leaf({middle, n->lines.end()})};
+        }
+        if (count <= n->left->line_count) {
+            auto [first, second] = split(n->left, count);
+            return {std::move(first), join(second, n->right)};
+        }
+        auto [first, second] = split(n->right, count - n->left->line_count);
+        return {join(n->left, first), std::move(second)};
+    }
+
+    static node_ptr build(std::vector<std::string>& lines, std::size_t first, std::size_t last) {
+        if (last - first <= built_leaf_lines) {
+            auto begin = lines.begin() + static_cast<std::ptrdiff_t>(first);
+            auto end = lines.begin() + static_cast<std::ptrdiff_t>(last);
+            return leaf({std::make_move_iterator(begin), std::make_move_iterator(end)});
+        }
+        // halves rounded to whole leaves, the tree is then as balanced as it gets
+        std::size_t leaves = (last - first + built_leaf_lines - 1) / built_leaf_lines;
+        std::size_t middle = first + leaves / 2 * built_leaf_lines;
+        return branch(build(lines, first, middle), build(lines, middle, last));
+    }
+};
+
+text_rope::text_rope(std::vector<std::string> lines) {
+    if (!lines.empty()) {
+        _root = tree::build(lines, 0, lines.size());
+    }
+}
+
+const std::string& text_rope::line(unsigned int idx) const noexcept {
+    assert(idx < line_count());
+    const node* n = _root.get();
+    while (n->left) {
+        if (idx < n->left->line_count) {
+            n = n->left.get();
+        } else {
+            idx -= n->left->line_count;
+            n = n->right.get();
+        }
+    }
+    return n->lines[idx];
+}
+
+std::size_t text_rope::line_offset(unsigned int idx) const noexcept {
+    if (idx >= line_count()) {
+        return byte_size() + 1;
+    }
+
+    // each line before the one looked for is followed by a '\n'
+    std::size_t offset = 0;
+    const node* n = _root.get();
+    while (n->left) {
+        if (idx < n->left->line_count) {
+            n = n->left.get();
+        } else {
+            offset += n->left->line_bytes + n->left->line_count;
+            idx -= n->left->line_count;
+            n = n->right.get();
+        }
+    }
+    for (unsigned int i = 0 ; i < idx ; ++i) {
+        offset += n->lines[i].size() + 1;
+    }
+    return offset;
+}
+
+text_rope text_rope::replaced(unsigned int first_line, unsigned int old_line_count, std::vector<std::string> new_lines) const {
+    assert(first_line + old_line_count <= line_count());
+
+    auto [head, rest] = tree::split(_root, first_line);
+    node_ptr tail = rest ? tree::split(rest, old_line_count).second : nullptr;
+    node_ptr middle = new_lines.empty() ? nullptr : tree::build(new_lines, 0, new_lines.size());
+    return text_rope{tree::join(tree::join(head, middle), tail)};
+}
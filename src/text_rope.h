@@ -0,0 +1,79 @@
+#ifndef IMEDIT_LS_TEXT_ROPE_H
+#define IMEDIT_LS_TEXT_ROPE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Persistent balanced tree of lines, stored in utf-8 without their '\n'. Nodes are never modified: an edit builds
+// the O(log n) nodes on its path and shares the rest with the previous rope, so that copies are immutable snapshots
+// costing a reference count
+class text_rope {
+public:
+    text_rope() noexcept = default;
+    explicit text_rope(std::vector<std::string> lines);
+
+    [[nodiscard]] unsigned int line_count() const noexcept {
+        return _root ? _root->line_count : 0;
+    }
+
+    // size of the text, with a '\n' between lines
+    [[nodiscard]] std::size_t byte_size() const noexcept {
+        return _root ? _root->line_bytes + _root->line_count - 1 : 0;
+    }
+
+    [[nodiscard]] const std::string& line(unsigned int idx) const noexcept;
+
+    // offset of the first byte of the line in the text, byte_size() + 1 past the last line
+    [[nodiscard]] std::size_t line_offset(unsigned int idx) const noexcept;
+
+    // This rope with the lines [first_line, first_line + old_line_count) replaced by new_lines
+    [[nodiscard]] text_rope replaced(unsigned int first_line, unsigned int old_line_count, std::vector<std::string> new_lines) const;
+
+    // Calls func(line) for each of the lines [first_line, last_line)
+    template <typename FuncT>
+    void for_each_line(unsigned int first_line, unsigned int last_line, FuncT&& func) const {
+        if (_root && first_line < last_line) {
+            for_each_line(*_root, first_line, last_line, func);
+        }
+    }
+
+private:
+    struct node {
+        std::shared_ptr<const node> left{};
+        std::shared_ptr<const node> right{};
+        std::vector<std::string> lines{}; // leaves only
+        unsigned int line_count{};
+        std::size_t line_bytes{}; // sum of the sizes of the lines
+        int height{}; // 0 for leaves
+    };
+    using node_ptr = std::shared_ptr<const node>;
+    struct tree; // building, joining and splitting nodes
+
+    explicit text_rope(node_ptr root) noexcept : _root{std::move(root)} {}
+
+    template <typename FuncT>
+    static void for_each_line(const node& n, unsigned int first_line, unsigned int last_line, FuncT& func) {
+        if (!n.left) {
+            for (unsigned int i = first_line ; i < last_line && i < n.line_count ; ++i) {
+                func(std::string_view{n.lines[i]});
+            }
+            return;
+        }
+        const unsigned int left_count = n.left->line_count;
+        if (first_line < left_count) {
+            for_each_line(*n.left, first_line, last_line, func);
+        }
+        if (last_line > left_count) {
+            for_each_line(*n.right, first_line > left_count ? first_line - left_count : 0, last_line - left_count, func);
+        }
+    }
+
+    node_ptr _root{};
+};
+
+
+#endif //IMEDIT_LS_TEXT_ROPE_H
@@ -0,0 +1,124 @@
+#include "token_store.h"
+#include "editor_text.h"
+#include "lexical_highlighter.h"
+
+#include <imedit/editor.h>
+
+#include <algorithm>
+
+namespace {
+    bool line_before(const lsptypes::decoration_mark& mark, unsigned int line) noexcept {
+        return mark.line < line;
+    }
+}
+
+token_store token_store::build(const semantic_tokens_cache& tokens, lsptypes::line_range lines,
+                               const token_style_table& token_styles) {
+    token_store store;
+    if (lines.empty()) {
+        return store;
+    }
+
+    store._lines = lines;
+    std::size_t line_count = lines.last - lines.first;
+    store._line_offsets.reserve(line_count + 1);
+
+    tokens.for_each_token(lines, [&store, &token_styles](unsigned int line, unsigned int char_idx, unsigned int length, unsigned int type, unsigned int modifiers) {
+        std::uint8_t style = token_styles.style(type, modifiers);
+        if (style == token_style_table::no_style) {
+            return;
+        }
+
+        auto token_count = static_cast<std::uint32_t>(store._char_idx.size());
+        while (store._line_offsets.size() <= line - store._lines.first) {
+            store._line_offsets.push_back(token_count);
+        }
+        store._char_idx.push_back(char_idx);
+        store._length.push_back(length);
+        store._type.push_back(token_style_table::editor_type(style));
+        if (auto decoration = token_style_table::decoration(style) ; decoration != lsptypes::token_decoration::none) {
+            store._decorations.push_back({.line = line, .first = char_idx, .last = char_idx + length, .decoration = decoration});
+        }
+    });
+
+    store._line_offsets.resize(line_count + 1, static_cast<std::uint32_t>(store._char_idx.size()));
+    return store;
+}
+
+void token_store::apply(ImEdit::editor& ed, lexical_highlighter* base_tokens) const {
+    std::vector<ImEdit::token_view> base;
+    unsigned int last = std::min(_lines.last, editor_line_count(ed));
+    for (unsigned int line = _lines.first ; line < last ; ++line) {
+        apply_line(ed, line, base_tokens, base);
+    }
+}
+
+unsigned int token_store::apply_some(ImEdit::editor& ed, unsigned int first_line, std::size_t& token_budget,
+                                     lexical_highlighter* base_tokens) const {
+    std::vector<ImEdit::token_view> base;
+    unsigned int last = std::min(_lines.last, editor_line_count(ed));
+    unsigned int line = std::max(first_line, _lines.first);
+    for (bool first = true ; line < last ; ++line, first = false) {
+        std::size_t offset_idx = line - _lines.first;
+        std::size_t line_tokens = _line_offsets[offset_idx + 1] - _line_offsets[offset_idx];
+        if (!first && line_tokens > token_budget) {
+            return line;
+        }
+        apply_line(ed, line, base_tokens, base);
+        token_budget -= std::min(token_budget, line_tokens);
+    }
+    return _lines.last;
+}
+
+void token_store::apply_line(ImEdit::editor& ed, unsigned int line, lexical_highlighter* base_tokens, std::vector<ImEdit::token_view>& base) const {
+    ed.clear_tokens(line);
+    base.clear();
+    if (base_tokens != nullptr) {
+        base_tokens->line_tokens(ed, line, base);
+    }
+
+    // both are sorted by position
+    std::size_t base_idx = 0;
+    std::size_t offset_idx = line - _lines.first;
+    for (std::uint32_t i = _line_offsets[offset_idx] ; i < _line_offsets[offset_idx + 1] ; ++i) {
+        for ( ; base_idx < base.size() && base[base_idx].char_idx + base[base_idx].length <= _char_idx[i] ; ++base_idx) {
+            ed.add_token(line, base[base_idx]);
+        }
+        // overlapped
+        while (base_idx < base.size() && base[base_idx].char_idx < _char_idx[i] + _length[i]) {
+            ++base_idx;
+        }
+
+        ImEdit::token_view token;
+        token.char_idx = _char_idx[i];
+        token.length = _length[i];
+        token.type = _type[i];
+        ed.add_token(line, token);
+    }
+    for ( ; base_idx < base.size() ; ++base_idx) {
+        ed.add_token(line, base[base_idx]);
+    }
+}
+
+void token_decorations::replace(lsptypes::line_range lines, const token_store& tokens) {
+    const std::vector<lsptypes::decoration_mark>& source = tokens.decorations();
+    auto source_first = std::lower_bound(source.begin(), source.end(), lines.first, line_before);
+    auto source_last = std::lower_bound(source_first, source.end(), lines.last, line_before);
+
+    auto first = std::lower_bound(_marks.begin(), _marks.end(), lines.first, line_before);
+    auto last = std::lower_bound(first, _marks.end(), lines.last, line_before);
+    _marks.insert(_marks.erase(first, last), source_first, source_last);
+}
+
+void token_decorations::lines_replaced(unsigned int first_line, unsigned int old_line_count, unsigned int new_line_count) {
+    auto first = std::lower_bound(_marks.begin(), _marks.end(), first_line, line_before);
+    auto last = std::lower_bound(first, _marks.end(), first_line + old_line_count, line_before);
+    for (auto it = last ; it != _marks.end() ; ++it) {
+        it->line = it->line - old_line_count + new_line_count;
+    }
+    _marks.erase(first, last);
+}
+
+std::vector<lsptypes::decoration_mark>::const_iterator token_decorations::lower_bound(unsigned int line) const noexcept {
+    return std::lower_bound(_marks.begin(), _marks.end(), line, line_before);
+}
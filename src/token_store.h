@@ -0,0 +1,98 @@
+#ifndef IMEDIT_LS_TOKEN_STORE_H
+#define IMEDIT_LS_TOKEN_STORE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <imedit/simple_types.h>
+
+#include "semantic_tokens.h"
+#include "token_styles.h"
+
+namespace ImEdit {
+    class editor;
+}
+
+class lexical_highlighter;
+
+namespace lsptypes {
+    // token drawn with a decoration, in editor glyphs [first, last)
+    struct decoration_mark {
+        unsigned int line{};
+        unsigned int first{};
+        unsigned int last{};
+        token_decoration decoration{};
+    };
+}
+
+// Editor-ready tokens of a range of lines: absolute positions and editor token types, stored as flat arrays
+// indexed through per-line offsets
+class token_store {
+public:
+    // Decodes the tokens of the given lines, styled through token_styles. Tokens without a style are dropped.
+    [[nodiscard]] static token_store build(const semantic_tokens_cache& tokens, lsptypes::line_range lines,
+                                           const token_style_table& token_styles);
+
+    [[nodiscard]] lsptypes::line_range lines() const noexcept {
+        return _lines;
+    }
+
+    [[nodiscard]] std::size_t token_count() const noexcept {
+        return _char_idx.size();
+    }
+
+    // tokens of the store with a decoration, by line
+    [[nodiscard]] const std::vector<lsptypes::decoration_mark>& decorations() const noexcept {
+        return _decorations;
+    }
+
+    // Replaces the tokens of the store's lines by the stored ones, along with the lexer tokens they do not overlap
+    // if base_tokens is not null
+    void apply(ImEdit::editor& ed, lexical_highlighter* base_tokens = nullptr) const;
+
+    // Same as apply, for the lines from first_line on until token_budget is spent, which it is decreased by. At
+    // least one line is applied. Returns the line to go on from, lines().last once every line was applied
+    unsigned int apply_some(ImEdit::editor& ed, unsigned int first_line, std::size_t& token_budget,
+                            lexical_highlighter* base_tokens = nullptr) const;
+
+private:
+    void apply_line(ImEdit::editor& ed, unsigned int line, lexical_highlighter* base_tokens, std::vector<ImEdit::token_view>& base) const;
+
+    lsptypes::line_range _lines{};
+    std::vector<std::uint32_t> _line_offsets{}; // first token of each line, followed by the token count
+    std::vector<std::uint32_t> _char_idx{};
+    std::vector<std::uint32_t> _length{};
+    std::vector<ImEdit::token_type::enum_> _type{};
+    std::vector<lsptypes::decoration_mark> _decorations{};
+};
+
+// Decorations of the tokens applied to an editor. They are kept apart from the editor's tokens, which have no room
+// for them, and moved along with the lines on edits as the editor's tokens are
+class token_decorations {
+public:
+    // Replaces the decorations of the lines by those of tokens on them
+    void replace(lsptypes::line_range lines, const token_store& tokens);
+
+    // The decorations of the replaced lines are dropped, those of the following lines are moved
+    void lines_replaced(unsigned int first_line, unsigned int old_line_count, unsigned int new_line_count);
+
+    void clear() noexcept {
+        _marks.clear();
+    }
+
+    // Calls func(mark) for each decoration on the lines, by line
+    template <typename FuncT>
+    void for_each_in(lsptypes::line_range lines, FuncT&& func) const {
+        for (auto it = lower_bound(lines.first) ; it != _marks.end() && it->line < lines.last ; ++it) {
+            func(*it);
+        }
+    }
+
+private:
+    [[nodiscard]] std::vector<lsptypes::decoration_mark>::const_iterator lower_bound(unsigned int line) const noexcept;
+
+    std::vector<lsptypes::decoration_mark> _marks{}; // by line
+};
+
+
+#endif //IMEDIT_LS_TOKEN_STORE_H
@@ -0,0 +1,184 @@
+#include "token_styles.h"
+
+#include <array>
+#include <cstddef>
+
+namespace {
+    using lsptypes::semantic_token_modifier;
+    using lsptypes::semantic_token_type;
+
+    // Finds names back in an array without collision: the hash is seeded with the first seed sending each name
+    // to a slot of its own
+    template <std::size_t N>
+    class perfect_hash {
+    public:
+        static constexpr std::size_t table_size = 128;
+        static_assert(N < table_size && N < 0xFF);
+
+        constexpr explicit perfect_hash(const std::array<std::string_view, N>& names) : _names{names} {
+            while (!try_seed()) {
+                ++_seed;
+            }
+        }
+
+        [[nodiscard]] constexpr std::optional<std::size_t> find(std::string_view name) const noexcept {
+            std::uint8_t entry = _slots[hash(name, _seed) % table_size];
+            if (entry == 0 || _names[entry - 1u] != name) {
+                return {};
+            }
+            return entry - 1u;
+        }
+
+    private:
+        [[nodiscard]] static constexpr std::uint32_t hash(std::string_view name, std::uint32_t seed) noexcept {
+            // FNV-1a
+            std::uint32_t hash = 2166136261u ^ seed;
+            for (char c : name) {
+                hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+            }
+            return hash ^ (hash >> 15);
+        }
+
+        constexpr bool try_seed() noexcept {
+            _slots = {};
+            for (std::size_t i = 0 ; i < N ; ++i) {
+                std::uint8_t& slot = _slots[hash(_names[i], _seed) % table_size];
+                if (slot != 0) {
+                    return false;
+                }
+                slot = static_cast<std::uint8_t>(i + 1);
+            }
+            return true;
+        }
+
+        std::array<std::string_view, N> _names;
+        std::array<std::uint8_t, table_size> _slots{}; // index in _names + 1, 0 if free
+        std::uint32_t _seed{0};
+    };
+
+    constexpr std::array<std::string_view, static_cast<std::size_t>(semantic_token_type::count)> type_names{
+        "namespace", "type", "class", "enum", "interface", "struct", "typeParameter", "parameter", "variable",
+        "property", "enumMember", "event", "function", "method", "macro", "keyword", "modifier", "comment", "string",
+        "number", "regexp", "operator", "decorator", "label", "concept", "bracket", "unknown"
+    };
+
+    constexpr std::array<std::string_view, static_cast<std::size_t>(semantic_token_modifier::count)> modifier_names{
+        "declaration", "definition", "readonly", "static", "deprecated", "abstract", "async", "modification",
+        "documentation", "defaultLibrary", "deduced", "virtual", "dependentName", "usedAsMutableReference",
+        "usedAsMutablePointer", "constructorOrDestructor", "userDefined", "functionScope", "classScope", "fileScope",
+        "globalScope"
+    };
+
+    constexpr perfect_hash<type_names.size()> type_hash{type_names};
+    constexpr perfect_hash<modifier_names.size()> modifier_hash{modifier_names};
+
+    static_assert(type_hash.find("enumMember") == static_cast<std::size_t>(semantic_token_type::enum_member));
+    static_assert(modifier_hash.find("defaultLibrary") == static_cast<std::size_t>(semantic_token_modifier::default_library));
+    static_assert(!type_hash.find("notAType"));
+
+    constexpr std::array<ImEdit::token_type::enum_, static_cast<std::size_t>(semantic_token_type::count)> base_styles{
+        ImEdit::token_type::unknown, // namespace
+        ImEdit::token_type::type, // type
+        ImEdit::token_type::type, // class
+        ImEdit::token_type::type, // enum
+        ImEdit::token_type::type, // interface
+        ImEdit::token_type::type, // struct
+        ImEdit::token_type::type, // typeParameter
+        ImEdit::token_type::variable, // parameter
+        ImEdit::token_type::variable, // variable
+        ImEdit::token_type::variable, // property
+        ImEdit::token_type::constant, // enumMember
+        ImEdit::token_type::unknown, // event
+        ImEdit::token_type::function, // function
+        ImEdit::token_type::function, // method
+        ImEdit::token_type::preprocessor, // macro
+        ImEdit::token_type::keyword, // keyword
+        ImEdit::token_type::keyword, // modifier
+        ImEdit::token_type::comment, // comment
+        ImEdit::token_type::string_literal, // string
+        ImEdit::token_type::num_literal, // number
+        ImEdit::token_type::unknown, // regexp
+        ImEdit::token_type::operator_, // operator
+        ImEdit::token_type::keyword, // decorator
+        ImEdit::token_type::type, // label
+        ImEdit::token_type::type, // concept
+        ImEdit::token_type::opening, // bracket
+        ImEdit::token_type::unknown // unknown
+    };
+
+    // modifiers the styles depend on, the others are left out of the table
+    constexpr std::uint32_t styled_modifiers = 1u << static_cast<unsigned int>(semantic_token_modifier::readonly)
+                                             | 1u << static_cast<unsigned int>(semantic_token_modifier::static_)
+                                             | 1u << static_cast<unsigned int>(semantic_token_modifier::deprecated);
+
+    // bounds the table to 4096 entries per type
+    constexpr unsigned int max_modifier_bits = 12;
+
+    std::uint8_t style_of(semantic_token_type type, std::uint32_t modifiers) noexcept {
+        auto has = [modifiers](semantic_token_modifier modifier) {
+            return (modifiers >> static_cast<unsigned int>(modifier) & 1u) != 0;
+        };
+
+        ImEdit::token_type::enum_ editor_type = base_styles[static_cast<std::size_t>(type)];
+        if (editor_type == ImEdit::token_type::variable && has(semantic_token_modifier::readonly)) {
+            editor_type = ImEdit::token_type::constant;
+        }
+
+        auto decoration = lsptypes::token_decoration::none;
+        if (has(semantic_token_modifier::deprecated)) {
+            decoration = lsptypes::token_decoration::deprecated;
+        } else if (has(semantic_token_modifier::static_)) {
+            decoration = lsptypes::token_decoration::static_member;
+        }
+        return token_style_table::make_style(editor_type, decoration);
+    }
+}
+
+std::optional<lsptypes::semantic_token_type> lsptypes::semantic_token_type_from_name(std::string_view name) noexcept {
+    if (auto index = type_hash.find(name) ; index) {
+        return static_cast<semantic_token_type>(*index);
+    }
+    return {};
+}
+
+std::optional<lsptypes::semantic_token_modifier> lsptypes::semantic_token_modifier_from_name(std::string_view name) noexcept {
+    if (auto index = modifier_hash.find(name) ; index) {
+        return static_cast<semantic_token_modifier>(*index);
+    }
+    return {};
+}
+
+token_style_table::token_style_table(const std::vector<std::string>& token_types, const std::vector<std::string>& token_modifiers) {
+    // our modifier bit of each legend bit
+    std::array<std::uint32_t, max_modifier_bits> legend_modifiers{};
+    for (std::size_t bit = 0 ; bit < token_modifiers.size() && bit < max_modifier_bits ; ++bit) {
+        auto modifier = lsptypes::semantic_token_modifier_from_name(token_modifiers[bit]);
+        if (!modifier) {
+            continue;
+        }
+        legend_modifiers[bit] = 1u << static_cast<unsigned int>(*modifier) & styled_modifiers;
+        if (legend_modifiers[bit] != 0) {
+            _modifier_bits = static_cast<unsigned int>(bit + 1);
+        }
+    }
+    _modifier_mask = (1u << _modifier_bits) - 1;
+
+    _type_count = static_cast<unsigned int>(token_types.size());
+    _styles.assign(std::size_t{_type_count} << _modifier_bits, no_style);
+    for (unsigned int type = 0 ; type < _type_count ; ++type) {
+        auto semantic_type = lsptypes::semantic_token_type_from_name(token_types[type]);
+        if (!semantic_type) {
+            continue;
+        }
+
+        for (unsigned int mask = 0 ; mask <= _modifier_mask ; ++mask) {
+            std::uint32_t modifiers = 0;
+            for (unsigned int bit = 0 ; bit < _modifier_bits ; ++bit) {
+                if ((mask >> bit & 1u) != 0) {
+                    modifiers |= legend_modifiers[bit];
+                }
+            }
+            _styles[(type << _modifier_bits) | mask] = style_of(*semantic_type, modifiers);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef IMEDIT_LS_TOKEN_STYLES_H
+#define IMEDIT_LS_TOKEN_STYLES_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <imedit/simple_types.h>
+
+namespace lsptypes {
+    // Semantic token types of the LSP specification, followed by clangd's own
+    enum class semantic_token_type : std::uint8_t {
+        namespace_,
+        type,
+        class_,
+        enum_,
+        interface,
+        struct_,
+        type_parameter,
+        parameter,
+        variable,
+        property,
+        enum_member,
+        event,
+        function,
+        method,
+        macro,
+        keyword,
+        modifier,
+        comment,
+        string,
+        number,
+        regexp,
+        operator_,
+        decorator,
+        label,
+        concept_,
+        bracket,
+        unknown,
+        count
+    };
+
+    // Semantic token modifiers of the LSP specification, followed by clangd's own
+    enum class semantic_token_modifier : std::uint8_t {
+        declaration,
+        definition,
+        readonly,
+        static_,
+        deprecated,
+        abstract,
+        async,
+        modification,
+        documentation,
+        default_library,
+        deduced,
+        virtual_,
+        dependent_name,
+        used_as_mutable_reference,
+        used_as_mutable_pointer,
+        constructor_or_destructor,
+        user_defined,
+        function_scope,
+        class_scope,
+        file_scope,
+        global_scope,
+        count
+    };
+
+    // Styles the editor's token types have no room for, drawn over the text by draw_token_decorations
+    enum class token_decoration : std::uint8_t {
+        none,
+        static_member, // underlined
+        deprecated // struck through
+    };
+
+    // Both look the name up in a perfect hash table built at compile time
+    [[nodiscard]] std::optional<semantic_token_type> semantic_token_type_from_name(std::string_view name) noexcept;
+    [[nodiscard]] std::optional<semantic_token_modifier> semantic_token_modifier_from_name(std::string_view name) noexcept;
+}
+
+// Style of every (type, modifiers) pair of a server's semantic tokens legend, computed once when the server
+// announces its legend so that styling a token is a single array load. A style packs an editor token type in its low
+// bits and a token_decoration above them
+class token_style_table {
+public:
+    // tokens of types the table knows nothing about are dropped, leaving the lexer's highlighting in place
+    static constexpr std::uint8_t no_style = 0xFF;
+    static constexpr unsigned int decoration_shift = 6;
+
+    [[nodiscard]] static constexpr std::uint8_t make_style(ImEdit::token_type::enum_ type, lsptypes::token_decoration decoration) noexcept {
+        return static_cast<std::uint8_t>(static_cast<unsigned int>(type) | static_cast<unsigned int>(decoration) << decoration_shift);
+    }
+
+    [[nodiscard]] static constexpr ImEdit::token_type::enum_ editor_type(std::uint8_t style) noexcept {
+        return static_cast<ImEdit::token_type::enum_>(style & ((1u << decoration_shift) - 1));
+    }
+
+    [[nodiscard]] static constexpr lsptypes::token_decoration decoration(std::uint8_t style) noexcept {
+        return static_cast<lsptypes::token_decoration>(style >> decoration_shift);
+    }
+
+    token_style_table() = default;
+    token_style_table(const std::vector<std::string>& token_types, const std::vector<std::string>& token_modifiers);
+
+    // see make_style, or no_style
+    [[nodiscard]] std::uint8_t style(unsigned int type, unsigned int modifiers) const noexcept {
+        if (type >= _type_count) {
+            return no_style;
+        }
+        return _styles[(type << _modifier_bits) | (modifiers & _modifier_mask)];
+    }
+
+private:
+    unsigned int _type_count{};
+    unsigned int _modifier_bits{};
+    unsigned int _modifier_mask{};
+    std::vector<std::uint8_t> _styles{}; // _type_count rows of 2^_modifier_bits entries
+};
+
+
+#endif //IMEDIT_LS_TOKEN_STYLES_H
@@ -0,0 +1,69 @@
+#include "traffic_recorder.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+traffic_recorder::traffic_recorder(const std::string& path) {
+    _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (_fd == -1) {
+        throw std::runtime_error("Failed to open the traffic recording " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat file_stat{};
+    if (fstat(_fd, &file_stat) == 0 && file_stat.st_size == 0
+        && write(_fd, lsptypes::recording_magic.data(), lsptypes::recording_magic.size()) != static_cast<ssize_t>(lsptypes::recording_magic.size())) {
+        close(_fd);
+        throw std::runtime_error("Failed to write the traffic recording " + path);
+    }
+}
+
+traffic_recorder::~traffic_recorder() {
+    close(_fd);
+}
+
+void traffic_recorder::record(lsptypes::record_kind kind, std::string_view body) noexcept {
+    std::lock_guard lock(_mutex);
+    if (_fd == -1) {
+        return;
+    }
+
+    auto header = lsptypes::encode_record_header({
+            .timestamp_ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - _start).count()),
+            .size = static_cast<std::uint32_t>(body.size()),
+            .kind = kind
+    });
+
+    // header and body in one go, records are whole in the file unless the disk fills up
+    std::array<iovec, 2> iov{
+        iovec{.iov_base = header.data(), .iov_len = header.size()},
+        iovec{.iov_base = const_cast<char*>(body.data()), .iov_len = body.size()}
+    };
+    std::size_t total = header.size() + body.size();
+    std::size_t written = 0;
+    while (written < total) {
+        ssize_t count = writev(_fd, iov.data(), static_cast<int>(iov.size()));
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            close(_fd);
+            _fd = -1;
+            return;
+        }
+        written += static_cast<std::size_t>(count);
+        // what is left after a short write
+        for (iovec& part : iov) {
+            std::size_t consumed = std::min(part.iov_len, static_cast<std::size_t>(count));
+            part.iov_base = static_cast<char*>(part.iov_base) + consumed;
+            part.iov_len -= consumed;
+            count -= static_cast<ssize_t>(consumed);
+        }
+    }
+}
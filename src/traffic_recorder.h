@@ -0,0 +1,82 @@
+#ifndef IMEDIT_LS_TRAFFIC_RECORDER_H
+#define IMEDIT_LS_TRAFFIC_RECORDER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace lsptypes {
+    // Recordings start with recording_magic, followed by records: a header of record_header_size bytes, then the
+    // body of one message without its framing. Integers are little endian. Read by tools/lsp_replay
+    inline constexpr std::string_view recording_magic{"IMLSREC1"};
+    inline constexpr std::size_t record_header_size = 13;
+
+    enum class record_kind : std::uint8_t {
+        session_start = 0, // a server was started, the records up to the next one are its traffic
+        client_message = 1,
+        server_message = 2
+    };
+
+    struct record_header {
+        std::uint64_t timestamp_ns{}; // since the recorder was created, monotonic
+        std::uint32_t size{}; // of the body following the header
+        record_kind kind{};
+    };
+
+    [[nodiscard]] inline std::array<char, record_header_size> encode_record_header(const record_header& header) noexcept {
+        std::array<char, record_header_size> bytes{};
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            bytes[i] = static_cast<char>((header.timestamp_ns >> (8 * i)) & 0xFFu);
+        }
+        for (std::size_t i = 0 ; i < 4 ; ++i) {
+            bytes[8 + i] = static_cast<char>((header.size >> (8 * i)) & 0xFFu);
+        }
+        bytes[12] = static_cast<char>(header.kind);
+        return bytes;
+    }
+
+    // empty if data is too short or holds an unknown kind
+    [[nodiscard]] inline std::optional<record_header> decode_record_header(std::string_view data) noexcept {
+        if (data.size() < record_header_size || static_cast<unsigned char>(data[12]) > static_cast<unsigned char>(record_kind::server_message)) {
+            return {};
+        }
+        record_header header;
+        for (std::size_t i = 0 ; i < 8 ; ++i) {
+            header.timestamp_ns |= std::uint64_t{static_cast<unsigned char>(data[i])} << (8 * i);
+        }
+        for (std::size_t i = 0 ; i < 4 ; ++i) {
+            header.size |= std::uint32_t{static_cast<unsigned char>(data[8 + i])} << (8 * i);
+        }
+        header.kind = static_cast<record_kind>(data[12]);
+        return header;
+    }
+}
+
+// Appends the messages exchanged with the language servers to a recording, for tools/lsp_replay to play the
+// servers' part later on. Messages are recorded from the threads reading and writing them
+class traffic_recorder {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Appends to the recording at path, created if needed. Throws std::runtime_error if it cannot be opened
+    explicit traffic_recorder(const std::string& path);
+    ~traffic_recorder();
+
+    traffic_recorder(const traffic_recorder&) = delete;
+    traffic_recorder& operator=(const traffic_recorder&) = delete;
+
+    // Recording stops at the first write error
+    void record(lsptypes::record_kind kind, std::string_view body) noexcept;
+
+private:
+    int _fd{-1};
+    const clock::time_point _start{clock::now()};
+    std::mutex _mutex{};
+};
+
+
+#endif //IMEDIT_LS_TRAFFIC_RECORDER_H
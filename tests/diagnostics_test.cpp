@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "diagnostics.h"
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, std::string_view what) {
+        if (!condition) {
+            std::cerr << "failed: " << what << '\n';
+            ++failures;
+        }
+    }
+
+    lsptypes::diagnostic make_diagnostic(unsigned int start_line, unsigned int start_char, unsigned int end_line, unsigned int end_char) {
+        lsptypes::diagnostic diag{};
+        diag.start = {start_line, start_char};
+        diag.end = {end_line, end_char};
+        diag.message = std::to_string(start_line) + ':' + std::to_string(start_char) + '-'
+                       + std::to_string(end_line) + ':' + std::to_string(end_char);
+        return diag;
+    }
+
+    std::vector<std::string> messages_in(const diagnostic_index& index, lsptypes::line_range lines) {
+        std::vector<std::string> messages;
+        index.for_each_in(lines, [&](const lsptypes::diagnostic& diag) {
+            messages.push_back(diag.message);
+        });
+        return messages;
+    }
+
+    void test_line_index() {
+        // a long diagnostic starting early must still be found once shorter ones end
+        diagnostic_index index{1, {
+                make_diagnostic(0, 0, 20, 3),
+                make_diagnostic(2, 4, 2, 8),
+                make_diagnostic(5, 0, 6, 0), // does not cover line 6
+                make_diagnostic(9, 1, 9, 1),
+        }};
+        check(index.size() == 4, "every diagnostic is indexed");
+        check(messages_in(index, {10, 12}) == std::vector<std::string>{"0:0-20:3"}, "diagnostic spanning the lines");
+        check(messages_in(index, {6, 7}) == std::vector<std::string>{"0:0-20:3"}, "range ending at column 0");
+        check(messages_in(index, {2, 6}) == std::vector<std::string>{"0:0-20:3", "2:4-2:8", "5:0-6:0"}, "by start position");
+        check(messages_in(index, {21, 30}).empty(), "lines past the diagnostics");
+        check(messages_in(index, {4, 4}).empty(), "empty range");
+    }
+
+    void test_line_index_against_scan() {
+        std::mt19937 gen{42};
+        std::uniform_int_distribution<unsigned int> line_dist{0, 60};
+        std::uniform_int_distribution<unsigned int> length_dist{0, 8};
+        std::uniform_int_distribution<unsigned int> char_dist{0, 3};
+
+        for (int round = 0 ; round < 200 ; ++round) {
+            std::vector<lsptypes::diagnostic> diagnostics;
+            const unsigned int count = length_dist(gen) * 4;
+            for (unsigned int i = 0 ; i < count ; ++i) {
+                const unsigned int start = line_dist(gen);
+                diagnostics.push_back(make_diagnostic(start, char_dist(gen), start + length_dist(gen), char_dist(gen)));
+            }
+            const diagnostic_index index{1, diagnostics};
+
+            const unsigned int first = line_dist(gen);
+            const lsptypes::line_range lines{first, first + length_dist(gen)};
+            std::vector<std::string> expected;
+            for (const lsptypes::diagnostic& diag : diagnostics) {
+                if (!lines.empty() && diag.start.line < lines.last && diag.last_line() >= lines.first) {
+                    expected.push_back(diag.message);
+                }
+            }
+            // diagnostics starting at the same position come in any order
+            std::vector<std::string> found = messages_in(index, lines);
+            std::sort(expected.begin(), expected.end());
+            std::sort(found.begin(), found.end());
+            check(found == expected, "same diagnostics as a scan, round " + std::to_string(round));
+        }
+    }
+
+    void test_outdated() {
+        const diagnostic_index shown{4, {}};
+        check(!diagnostic_index::outdated(4, 4, nullptr), "diagnostics about the last version sent");
+        check(diagnostic_index::outdated(3, 4, nullptr), "a later version was sent");
+        check(!diagnostic_index::outdated(5, 5, &shown), "later than the shown ones");
+        check(!diagnostic_index::outdated(4, 4, &shown), "same version as the shown ones");
+        check(diagnostic_index::outdated(3, 3, &shown), "earlier than the shown ones");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const std::string_view suite = argc > 1 ? argv[1] : "";
+    if (suite.empty() || suite == "diagnostics") {
+        test_line_index();
+        test_line_index_against_scan();
+        test_outdated();
+    }
+
+    if (failures != 0) {
+        std::cerr << failures << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "recording.h"
+#include "replayer.h"
+
+namespace {
+    constexpr std::string_view usage =
+        "usage: ImEdit_LS_replay [--fast] [--session N] RECORDING\n"
+        "  plays the server's part of a session recorded with server_options::traffic_recording\n"
+        "  --fast     answers as soon as possible instead of at the recorded pace\n"
+        "  --session  session of the recording to play, in the order the servers were started (default: 0)\n";
+
+    struct options {
+        std::string recording{};
+        replay::pace pace{replay::pace::original};
+        std::size_t session{};
+    };
+
+    bool parse_options(int argc, char* argv[], options& opts) {
+        for (int i = 1 ; i < argc ; ++i) {
+            std::string_view arg = argv[i];
+            if (arg == "--fast") {
+                opts.pace = replay::pace::fast;
+            } else if (arg == "--session" && i + 1 < argc) {
+                std::string_view value = argv[++i];
+                auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), opts.session);
+                if (error != std::errc{} || end != value.data() + value.size()) {
+                    return false;
+                }
+            } else if (!arg.starts_with("--") && opts.recording.empty()) {
+                opts.recording = arg;
+            } else {
+                return false;
+            }
+        }
+        return !opts.recording.empty();
+    }
+
+    bool send(const replay::outgoing_message& message) {
+        std::string header = "Content-Length: " + std::to_string(message.size()) + "\r\n\r\n";
+        std::array<iovec, 4> iov{
+            iovec{.iov_base = header.data(), .iov_len = header.size()},
+            iovec{.iov_base = const_cast<char*>(message.head.data()), .iov_len = message.head.size()},
+            iovec{.iov_base = const_cast<char*>(message.middle.data()), .iov_len = message.middle.size()},
+            iovec{.iov_base = const_cast<char*>(message.tail.data()), .iov_len = message.tail.size()}
+        };
+
+        // straight from the mapped recording
+        std::size_t first = 0;
+        while (first < iov.size()) {
+            ssize_t written = ::writev(STDOUT_FILENO, iov.data() + first, static_cast<int>(iov.size() - first));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            auto left = static_cast<std::size_t>(written);
+            for (; first < iov.size() && iov[first].iov_len <= left ; ++first) {
+                left -= iov[first].iov_len;
+            }
+            if (first < iov.size()) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+                iov[first].iov_len -= left;
+            }
+        }
+        return true;
+    }
+
+    // Extracts the first complete message of 'input'. Returns false when more input is needed
+    bool next_message(std::string& input, std::string& body) {
+        auto header_end = input.find("\r\n\r\n");
+        if (header_end == std::string::npos) {
+            return false;
+        }
+
+        std::size_t length{};
+        std::string_view headers{input.data(), header_end};
+        constexpr std::string_view content_length = "Content-Length:";
+        if (auto pos = headers.find(content_length) ; pos != std::string_view::npos) {
+            pos += content_length.size();
+            while (pos < headers.size() && headers[pos] == ' ') {
+                ++pos;
+            }
+            std::from_chars(headers.data() + pos, headers.data() + headers.size(), length);
+        }
+
+        std::size_t body_begin = header_end + 4;
+        if (input.size() < body_begin + length) {
+            return false;
+        }
+        body.assign(input, body_begin, length);
+        input.erase(0, body_begin + length);
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    options opts;
+    if (!parse_options(argc, argv, opts)) {
+        std::cerr << usage;
+        return 2;
+    }
+
+    std::optional<replay::recording> recorded;
+    try {
+        recorded.emplace(opts.recording);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << '\n';
+        return 2;
+    }
+    if (opts.session >= recorded->session_count()) {
+        std::cerr << opts.recording << " holds " << recorded->session_count() << " sessions\n";
+        return 2;
+    }
+
+    replay::replayer replayer{recorded->session(opts.session), opts.pace, replay::clock::now()};
+    std::string input;
+    std::string body;
+    char buffer[64 * 1024];
+    bool input_open = true;
+
+    while (!replayer.exit_requested()) {
+        auto now = replay::clock::now();
+        for (const replay::outgoing_message& message : replayer.take_due(now)) {
+            if (!send(message)) {
+                return 1;
+            }
+        }
+
+        if (!input_open) {
+            // stdin closed: flush what is still scheduled, then leave
+            auto due = replayer.next_due();
+            if (!due) {
+                break;
+            }
+            usleep(static_cast<useconds_t>(std::chrono::duration_cast<std::chrono::microseconds>(*due - now).count()));
+            continue;
+        }
+
+        int timeout = -1;
+        if (auto due = replayer.next_due() ; due) {
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(*due - now).count();
+            timeout = static_cast<int>(std::max<decltype(wait)>(wait, 0));
+        }
+
+        pollfd fd{.fd = STDIN_FILENO, .events = POLLIN, .revents = 0};
+        int ready = ::poll(&fd, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            return 1;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        ssize_t count = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        if (count == 0) {
+            input_open = false;
+            continue;
+        }
+
+        input.append(buffer, static_cast<std::size_t>(count));
+        now = replay::clock::now();
+        while (next_message(input, body)) {
+            replayer.receive(body, now);
+        }
+    }
+
+    // answers already due, such as the one to shutdown, are still sent on exit
+    for (const replay::outgoing_message& message : replayer.take_due(replay::clock::now())) {
+        send(message);
+    }
+
+    // differences with the recorded session make replays diverge, they are worth knowing about when comparing runs
+    std::cerr << "replayed " << replayer.messages_sent() << " messages of the " << replayer.recorded_server_messages()
+              << " recorded, " << replayer.unmatched_requests() << " requests were not in the recording\n";
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "recording.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+replay::recording::recording(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) == -1) {
+        close(fd);
+        throw std::runtime_error("cannot stat " + path + ": " + std::strerror(errno));
+    }
+    _size = static_cast<std::size_t>(file_stat.st_size);
+    if (_size < lsptypes::recording_magic.size()) {
+        close(fd);
+        throw std::runtime_error(path + " is not a recording");
+    }
+
+    // the records are read in place, however big the recording
+    _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (_data == MAP_FAILED) {
+        _data = nullptr;
+        throw std::runtime_error("cannot map " + path + ": " + std::strerror(errno));
+    }
+    madvise(_data, _size, MADV_SEQUENTIAL);
+
+    std::string_view data(static_cast<const char*>(_data), _size);
+    if (!data.starts_with(lsptypes::recording_magic)) {
+        munmap(_data, _size);
+        throw std::runtime_error(path + " is not a recording");
+    }
+    data.remove_prefix(lsptypes::recording_magic.size());
+
+    while (auto header = lsptypes::decode_record_header(data)) {
+        if (data.size() - lsptypes::record_header_size < header->size) {
+            break;
+        }
+        std::string_view body = data.substr(lsptypes::record_header_size, header->size);
+        data.remove_prefix(lsptypes::record_header_size + header->size);
+
+        if (header->kind == lsptypes::record_kind::session_start || _sessions.empty()) {
+            _sessions.push_back({.start_ns = header->timestamp_ns});
+        }
+        if (header->kind != lsptypes::record_kind::session_start) {
+            _sessions.back().records.push_back({.kind = header->kind, .timestamp_ns = header->timestamp_ns, .body = body});
+        }
+    }
+}
+
+replay::recording::~recording() {
+    if (_data != nullptr) {
+        munmap(_data, _size);
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef IMEDIT_LS_REPLAY_RECORDING_H
+#define IMEDIT_LS_REPLAY_RECORDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "traffic_recorder.h"
+
+namespace replay {
+    struct record {
+        lsptypes::record_kind kind{};
+        std::uint64_t timestamp_ns{};
+        std::string_view body{}; // in the mapped file
+    };
+
+    struct session {
+        std::uint64_t start_ns{}; // when the server was started
+        std::vector<record> records{}; // in the order they were recorded
+    };
+
+    // Recording mapped in memory, split in the sessions of the servers it holds the traffic of. A record cut short
+    // by the end of the file, as left by a crash, ends the recording
+    class recording {
+    public:
+        // Throws std::runtime_error if the file cannot be mapped or is not a recording
+        explicit recording(const std::string& path);
+        ~recording();
+
+        recording(const recording&) = delete;
+        recording& operator=(const recording&) = delete;
+
+        [[nodiscard]] std::size_t session_count() const noexcept {
+            return _sessions.size();
+        }
+
+        [[nodiscard]] const replay::session& session(std::size_t idx) const noexcept {
+            return _sessions[idx];
+        }
+
+    private:
+        void* _data{nullptr};
+        std::size_t _size{};
+        std::vector<replay::session> _sessions{};
+    };
+}
+
+
+#endif //IMEDIT_LS_REPLAY_RECORDING_H
@@ -0,0 +1,236 @@
+#include "replayer.h"
+
+#include <algorithm>
+
+namespace {
+    constexpr int content_modified = -32801;
+
+    // top-level members of a message, values as raw JSON
+    struct message_fields {
+        std::optional<std::string_view> id{};
+        std::size_t id_begin{};
+        std::optional<std::string_view> method{};
+    };
+
+    bool is_blank(char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    std::size_t skip_blanks(std::string_view json, std::size_t pos) noexcept {
+        while (pos < json.size() && is_blank(json[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    // position past the string starting at pos
+    std::size_t skip_string(std::string_view json, std::size_t pos) noexcept {
+        ++pos;
+        while (pos < json.size()) {
+            pos = json.find_first_of("\"\\", pos);
+            if (pos == std::string_view::npos) {
+                return json.size();
+            }
+            if (json[pos] == '"') {
+                return pos + 1;
+            }
+            pos += 2;
+        }
+        return json.size();
+    }
+
+    // position past the value starting at pos
+    std::size_t skip_value(std::string_view json, std::size_t pos) noexcept {
+        if (pos >= json.size()) {
+            return pos;
+        }
+        if (json[pos] == '"') {
+            return skip_string(json, pos);
+        }
+        if (json[pos] == '{' || json[pos] == '[') {
+            unsigned int depth = 0;
+            while (pos < json.size()) {
+                char c = json[pos];
+                if (c == '"') {
+                    pos = skip_string(json, pos);
+                    continue;
+                }
+                if (c == '{' || c == '[') {
+                    ++depth;
+                } else if ((c == '}' || c == ']') && --depth == 0) {
+                    return pos + 1;
+                }
+                ++pos;
+            }
+            return pos;
+        }
+        while (pos < json.size() && json[pos] != ',' && json[pos] != '}' && json[pos] != ']' && !is_blank(json[pos])) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    // Looks at the top-level members only: params and results are skipped, however big
+    message_fields scan_message(std::string_view json) noexcept {
+        message_fields fields;
+        std::size_t pos = skip_blanks(json, 0);
+        if (pos >= json.size() || json[pos] != '{') {
+            return fields;
+        }
+        pos = skip_blanks(json, pos + 1);
+
+        while (pos < json.size() && json[pos] == '"') {
+            std::size_t key_end = skip_string(json, pos);
+            std::string_view key = json.substr(pos + 1, key_end - pos - 2);
+            pos = skip_blanks(json, key_end);
+            if (pos >= json.size() || json[pos] != ':') {
+                break;
+            }
+            std::size_t value_begin = skip_blanks(json, pos + 1);
+            std::size_t value_end = skip_value(json, value_begin);
+            std::string_view value = json.substr(value_begin, value_end - value_begin);
+
+            if (key == "id" && value != "null") {
+                fields.id = value;
+                fields.id_begin = value_begin;
+            } else if (key == "method" && value.size() >= 2 && value.front() == '"') {
+                fields.method = value.substr(1, value.size() - 2);
+            }
+
+            pos = skip_blanks(json, value_end);
+            if (pos >= json.size() || json[pos] != ',') {
+                break;
+            }
+            pos = skip_blanks(json, pos + 1);
+        }
+        return fields;
+    }
+}
+
+replay::replayer::replayer(const session& recorded, pace replay_pace, clock::time_point start)
+    : _session{recorded}
+    , _pace{replay_pace}
+{
+    std::unordered_map<std::string_view, std::size_t> requests_by_id;
+    std::size_t client_messages = 0;
+    std::uint64_t last_client_message_ns = recorded.start_ns;
+
+    for (std::size_t idx = 0 ; idx < recorded.records.size() ; ++idx) {
+        const record& rec = recorded.records[idx];
+        message_fields fields = scan_message(rec.body);
+
+        if (rec.kind == lsptypes::record_kind::client_message) {
+            ++client_messages;
+            last_client_message_ns = rec.timestamp_ns;
+            if (fields.id && fields.method) {
+                requests_by_id[*fields.id] = _requests.size();
+                _requests_by_method[*fields.method].push_back(_requests.size());
+                _requests.push_back({.timestamp_ns = rec.timestamp_ns});
+            }
+            continue;
+        }
+
+        ++_recorded_server_messages;
+        if (fields.id && !fields.method) {
+            if (auto request = requests_by_id.find(*fields.id) ; request != requests_by_id.end()) {
+                recorded_request& answered = _requests[request->second];
+                answered.response = idx;
+                answered.response_id_begin = fields.id_begin;
+                answered.response_id_end = fields.id_begin + fields.id->size();
+                continue;
+            }
+        }
+        _triggered.push_back({
+                .record = idx,
+                .client_messages_before = client_messages,
+                .delay_ns = rec.timestamp_ns >= last_client_message_ns ? rec.timestamp_ns - last_client_message_ns : 0
+        });
+    }
+
+    release_triggered(start);
+}
+
+void replay::replayer::receive(std::string_view body, clock::time_point now) {
+    message_fields fields = scan_message(body);
+    ++_client_messages;
+
+    if (fields.method && *fields.method == "exit") {
+        _exit_requested = true;
+    }
+
+    if (fields.id && fields.method) {
+        std::size_t rank = _live_requests_by_method[std::string{*fields.method}]++;
+        auto recorded = _requests_by_method.find(*fields.method);
+        if (recorded == _requests_by_method.end() || rank >= recorded->second.size()) {
+            ++_unmatched_requests;
+            std::string error = R"({"jsonrpc":"2.0","id":)";
+            error += *fields.id;
+            error += R"(,"error":{"code":)" + std::to_string(content_modified) + R"(,"message":"not in the recording"}})";
+            schedule({.due = now, .sequence = _session.records.size(), .message = {.middle = std::move(error)}});
+        } else if (const recorded_request& request = _requests[recorded->second[rank]] ; request.response) {
+            // answered with its own id, after the time the server took
+            const record& response = _session.records[*request.response];
+            schedule({
+                    .due = due_after(now, response.timestamp_ns - std::min(request.timestamp_ns, response.timestamp_ns)),
+                    .sequence = *request.response,
+                    .message = {
+                            .head = response.body.substr(0, request.response_id_begin),
+                            .middle = std::string{*fields.id},
+                            .tail = response.body.substr(request.response_id_end)
+                    }
+            });
+        }
+    }
+
+    release_triggered(now);
+}
+
+std::vector<replay::outgoing_message> replay::replayer::take_due(clock::time_point now) {
+    auto end = std::find_if(_queue.begin(), _queue.end(), [now](const scheduled_message& message) {
+        return message.due > now;
+    });
+
+    std::vector<outgoing_message> due;
+    due.reserve(static_cast<std::size_t>(end - _queue.begin()));
+    for (auto it = _queue.begin() ; it != end ; ++it) {
+        due.push_back(std::move(it->message));
+    }
+    _queue.erase(_queue.begin(), end);
+    // errors for requests that were not recorded have no head
+    _messages_sent += static_cast<std::uint64_t>(std::count_if(due.begin(), due.end(), [](const outgoing_message& message) {
+        return !message.head.empty();
+    }));
+    return due;
+}
+
+std::optional<replay::clock::time_point> replay::replayer::next_due() const {
+    if (_queue.empty()) {
+        return {};
+    }
+    return _queue.front().due;
+}
+
+void replay::replayer::schedule(scheduled_message message) {
+    auto it = std::upper_bound(_queue.begin(), _queue.end(), message, [](const scheduled_message& lhs, const scheduled_message& rhs) {
+        return lhs.due != rhs.due ? lhs.due < rhs.due : lhs.sequence < rhs.sequence;
+    });
+    _queue.insert(it, std::move(message));
+}
+
+replay::clock::time_point replay::replayer::due_after(clock::time_point trigger, std::uint64_t delay_ns) const noexcept {
+    if (_pace == pace::fast) {
+        return trigger;
+    }
+    return trigger + std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds{delay_ns});
+}
+
+void replay::replayer::release_triggered(clock::time_point now) {
+    for (; _next_triggered < _triggered.size() && _triggered[_next_triggered].client_messages_before <= _client_messages ; ++_next_triggered) {
+        const triggered_message& triggered = _triggered[_next_triggered];
+        schedule({
+                .due = due_after(now, triggered.delay_ns),
+                .sequence = triggered.record,
+                .message = {.head = _session.records[triggered.record].body}
+        });
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef IMEDIT_LS_REPLAY_REPLAYER_H
+#define IMEDIT_LS_REPLAY_REPLAYER_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "recording.h"
+
+namespace replay {
+    using clock = std::chrono::steady_clock;
+
+    enum class pace {
+        original, // messages keep the delays they had after the client's messages that triggered them
+        fast // messages are sent as soon as the client's messages that triggered them came
+    };
+
+    // Body of a message for the client, made of head, middle and tail. Views point into the recording
+    struct outgoing_message {
+        std::string_view head{};
+        std::string middle{}; // the client's id in responses, the whole body of messages that were not recorded
+        std::string_view tail{};
+
+        [[nodiscard]] std::size_t size() const noexcept {
+            return head.size() + middle.size() + tail.size();
+        }
+    };
+
+    // Plays the server's part of a recorded session, with no I/O: the client's messages are fed in, and the
+    // recorded messages of the server are collected once due.
+    // Requests of the client are matched to the recorded ones by method and rank among the requests of that method,
+    // and get the recorded answer with their id. The other messages of the server are sent once the client sent
+    // as many messages as it had before them in the recording
+    class replayer {
+    public:
+        replayer(const session& recorded, pace replay_pace, clock::time_point start);
+
+        // Handles the body of one message from the client
+        void receive(std::string_view body, clock::time_point now);
+
+        // Messages due at 'now', in the order they were recorded
+        [[nodiscard]] std::vector<outgoing_message> take_due(clock::time_point now);
+        [[nodiscard]] std::optional<clock::time_point> next_due() const;
+
+        [[nodiscard]] bool exit_requested() const noexcept {
+            return _exit_requested;
+        }
+
+        // requests of the client that were not in the recording, answered with an error
+        [[nodiscard]] std::uint64_t unmatched_requests() const noexcept {
+            return _unmatched_requests;
+        }
+
+        // recorded messages sent so far
+        [[nodiscard]] std::uint64_t messages_sent() const noexcept {
+            return _messages_sent;
+        }
+
+        [[nodiscard]] std::size_t recorded_server_messages() const noexcept {
+            return _recorded_server_messages;
+        }
+
+    private:
+        struct recorded_request {
+            std::uint64_t timestamp_ns{};
+            std::optional<std::size_t> response{}; // index of its answer in the records
+            std::size_t response_id_begin{}; // the id in the body of the answer, replaced by the client's
+            std::size_t response_id_end{};
+        };
+
+        // server messages other than answers to the client's requests
+        struct triggered_message {
+            std::size_t record{};
+            std::size_t client_messages_before{};
+            std::uint64_t delay_ns{}; // after the last of them
+        };
+
+        struct scheduled_message {
+            clock::time_point due;
+            std::size_t sequence; // record index, keeps messages due at the same time in the recorded order
+            outgoing_message message;
+        };
+
+        void schedule(scheduled_message message);
+        [[nodiscard]] clock::time_point due_after(clock::time_point trigger, std::uint64_t delay_ns) const noexcept;
+        // schedules the triggered messages the client sent enough messages for
+        void release_triggered(clock::time_point now);
+
+        const session& _session;
+        pace _pace;
+
+        std::vector<recorded_request> _requests{};
+        std::unordered_map<std::string_view, std::vector<std::size_t>> _requests_by_method{};
+        std::vector<triggered_message> _triggered{}; // in record order
+        std::size_t _recorded_server_messages{};
+
+        std::unordered_map<std::string, std::size_t> _live_requests_by_method{};
+        std::size_t _client_messages{};
+        std::size_t _next_triggered{};
+        std::vector<scheduled_message> _queue{}; // sorted by (due, sequence)
+        std::uint64_t _unmatched_requests{};
+        std::uint64_t _messages_sent{};
+        bool _exit_requested{false};
+    };
+}
+
+
+#endif //IMEDIT_LS_REPLAY_REPLAYER_H
@@ -0,0 +1,335 @@
+#include "json_value.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+    class parser {
+    public:
+        explicit parser(std::string_view text) noexcept : _text{text} {}
+
+        std::optional<mock::json_value> parse_document() {
+            auto value = parse_value(0);
+            skip_blanks();
+            if (!value || _pos != _text.size()) {
+                return {};
+            }
+            return value;
+        }
+
+    private:
+        static constexpr unsigned int max_depth = 256;
+
+        std::optional<mock::json_value> parse_value(unsigned int depth) {
+            skip_blanks();
+            if (_pos >= _text.size() || depth > max_depth) {
+                return {};
+            }
+
+            switch (_text[_pos]) {
+                case '{':
+                    return parse_object(depth);
+                case '[':
+                    return parse_array(depth);
+                case '"': {
+                    auto str = parse_string();
+                    if (!str) {
+                        return {};
+                    }
+                    return mock::json_value{std::move(*str)};
+                }
+                case 't':
+                    return parse_literal("true", mock::json_value{true});
+                case 'f':
+                    return parse_literal("false", mock::json_value{false});
+                case 'n':
+                    return parse_literal("null", mock::json_value{});
+                default:
+                    return parse_number();
+            }
+        }
+
+        std::optional<mock::json_value> parse_object(unsigned int depth) {
+            ++_pos;
+            mock::json_value::object members;
+            skip_blanks();
+            if (consume('}')) {
+                return mock::json_value{std::move(members)};
+            }
+
+            do {
+                skip_blanks();
+                auto key = parse_string();
+                skip_blanks();
+                if (!key || !consume(':')) {
+                    return {};
+                }
+                auto value = parse_value(depth + 1);
+                if (!value) {
+                    return {};
+                }
+                members.push_back({std::move(*key), std::move(*value)});
+                skip_blanks();
+            } while (consume(','));
+
+            if (!consume('}')) {
+                return {};
+            }
+            return mock::json_value{std::move(members)};
+        }
+
+        std::optional<mock::json_value> parse_array(unsigned int depth) {
+            ++_pos;
+            mock::json_value::array elements;
+            skip_blanks();
+            if (consume(']')) {
+                return mock::json_value{std::move(elements)};
+            }
+
+            do {
+                auto value = parse_value(depth + 1);
+                if (!value) {
+                    return {};
+                }
+                elements.push_back(std::move(*value));
+                skip_blanks();
+            } while (consume(','));
+
+            if (!consume(']')) {
+                return {};
+            }
+            return mock::json_value{std::move(elements)};
+        }
+
+        std::optional<std::string> parse_string() {
+            if (!consume('"')) {
+                return {};
+            }
+
+            std::string str;
+            while (_pos < _text.size()) {
+                const char c = _text[_pos];
+                _pos += 1;
+                if (c == '"') {
+                    return str;
+                }
+                if (c != '\\') {
+                    str += c;
+                    continue;
+                }
+                if (_pos == _text.size()) {
+                    return {};
+                }
+
+                const char escaped = _text[_pos];
+                _pos += 1;
+                switch (escaped) {
+                    case 'b': str += '\b'; break;
+                    case 'f': str += '\f'; break;
+                    case 'n': str += '\n'; break;
+                    case 'r': str += '\r'; break;
+                    case 't': str += '\t'; break;
+                    case 'u': {
+                        std::uint32_t cp{};
+                        if (!parse_hex4(cp)) {
+                            return {};
+                        }
+                        if (cp >= 0xd800 && cp < 0xdc00) {
+                            std::uint32_t low{};
+                            if (!consume('\\') || !consume('u') || !parse_hex4(low)) {
+                                return {};
+                            }
+                            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                        }
+                        append_utf8(str, cp);
+                        break;
+                    }
+                    default:
+                        str += escaped;
+                        break;
+                }
+            }
+            return {};
+        }
+
+        std::optional<mock::json_value> parse_number() {
+            double value{};
+            auto [end, error] = std::from_chars(_text.data() + _pos, _text.data() + _text.size(), value);
+            if (error != std::errc{}) {
+                return {};
+            }
+            _pos = static_cast<std::size_t>(end - _text.data());
+            return mock::json_value{value};
+        }
+
+        std::optional<mock::json_value> parse_literal(std::string_view literal, mock::json_value value) {
+            if (_text.substr(_pos, literal.size()) != literal) {
+                return {};
+            }
+            _pos += literal.size();
+            return value;
+        }
+
+        bool parse_hex4(std::uint32_t& value) {
+            if (_text.size() - _pos < 4) {
+                return false;
+            }
+            auto [end, error] = std::from_chars(_text.data() + _pos, _text.data() + _pos + 4, value, 16);
+            if (error != std::errc{} || end != _text.data() + _pos + 4) {
+                return false;
+            }
+            _pos += 4;
+            return true;
+        }
+
+        static void append_utf8(std::string& str, std::uint32_t cp) {
+            if (cp < 0x80) {
+                str += static_cast<char>(cp);
+            } else if (cp < 0x800) {
+                str += static_cast<char>(0xc0 | (cp >> 6));
+                str += static_cast<char>(0x80 | (cp & 0x3f));
+            } else if (cp < 0x10000) {
+                str += static_cast<char>(0xe0 | (cp >> 12));
+                str += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+                str += static_cast<char>(0x80 | (cp & 0x3f));
+            } else {
+                str += static_cast<char>(0xf0 | (cp >> 18));
+                str += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+                str += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+                str += static_cast<char>(0x80 | (cp & 0x3f));
+            }
+        }
+
+        bool consume(char c) noexcept {
+            if (_pos < _text.size() && _text[_pos] == c) {
+                ++_pos;
+                return true;
+            }
+            return false;
+        }
+
+        void skip_blanks() noexcept {
+            while (_pos < _text.size() && (_text[_pos] == ' ' || _text[_pos] == '\t' || _text[_pos] == '\n' || _text[_pos] == '\r')) {
+                ++_pos;
+            }
+        }
+
+        std::string_view _text;
+        std::size_t _pos{};
+    };
+
+    const mock::json_value null_value{};
+    const std::string empty_string{};
+    const mock::json_value::array empty_array{};
+}
+
+const mock::json_value* mock::json_value::find(std::string_view key) const noexcept {
+    const auto* members = std::get_if<object>(&_value);
+    if (members == nullptr) {
+        return nullptr;
+    }
+    for (const json_member& member : *members) {
+        if (member.key == key) {
+            return &member.value;
+        }
+    }
+    return nullptr;
+}
+
+const mock::json_value& mock::json_value::operator[](std::string_view key) const noexcept {
+    const json_value* value = find(key);
+    return value == nullptr ? null_value : *value;
+}
+
+double mock::json_value::as_number(double fallback) const noexcept {
+    const auto* number = std::get_if<double>(&_value);
+    return number == nullptr ? fallback : *number;
+}
+
+bool mock::json_value::as_bool(bool fallback) const noexcept {
+    const auto* b = std::get_if<bool>(&_value);
+    return b == nullptr ? fallback : *b;
+}
+
+const std::string& mock::json_value::as_string() const noexcept {
+    const auto* str = std::get_if<std::string>(&_value);
+    return str == nullptr ? empty_string : *str;
+}
+
+const mock::json_value::array& mock::json_value::as_array() const noexcept {
+    const auto* arr = std::get_if<array>(&_value);
+    return arr == nullptr ? empty_array : *arr;
+}
+
+std::string mock::json_value::dump() const {
+    std::string out;
+    std::visit([&out](const auto& value) {
+        using value_t = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<value_t, std::nullptr_t>) {
+            out = "null";
+        } else if constexpr (std::is_same_v<value_t, bool>) {
+            out = value ? "true" : "false";
+        } else if constexpr (std::is_same_v<value_t, double>) {
+            char buffer[32];
+            // integers are written without exponent nor fraction, the cast is only done in the range it is exact in
+            const bool integer = std::abs(value) < 1e15
+                                 && !std::islessgreater(static_cast<double>(static_cast<std::int64_t>(value)), value);
+            auto [end, error] = integer
+                    ? std::to_chars(buffer, buffer + sizeof(buffer), static_cast<long long>(value))
+                    : std::to_chars(buffer, buffer + sizeof(buffer), value);
+            out.assign(buffer, error == std::errc{} ? end : buffer);
+        } else if constexpr (std::is_same_v<value_t, std::string>) {
+            append_json_string(out, value);
+        } else if constexpr (std::is_same_v<value_t, array>) {
+            out += '[';
+            for (std::size_t i = 0 ; i < value.size() ; ++i) {
+                if (i != 0) {
+                    out += ',';
+                }
+                out += value[i].dump();
+            }
+            out += ']';
+        } else {
+            out += '{';
+            for (std::size_t i = 0 ; i < value.size() ; ++i) {
+                if (i != 0) {
+                    out += ',';
+                }
+                append_json_string(out, value[i].key);
+                out += ':';
+                out += value[i].value.dump();
+            }
+            out += '}';
+        }
+    }, _value);
+    return out;
+}
+
+std::optional<mock::json_value> mock::parse_json(std::string_view text) {
+    return parser{text}.parse_document();
+}
+
+void mock::append_json_string(std::string& out, std::string_view str) {
+    constexpr std::string_view hex = "0123456789abcdef";
+    out += '"';
+    for (char c : str) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out += "\\u00";
+                    out += hex[static_cast<unsigned char>(c) >> 4];
+                    out += hex[static_cast<unsigned char>(c) & 0xf];
+                } else {
+                    out += c;
+                }
+                break;
+        }
+    }
+    out += '"';
+}
@@ -0,0 +1,64 @@
+#ifndef IMEDIT_LS_MOCK_JSON_VALUE_H
+#define IMEDIT_LS_MOCK_JSON_VALUE_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace mock {
+    struct json_member;
+
+    // Minimal JSON document model, enough to read the client's messages
+    class json_value {
+    public:
+        using array = std::vector<json_value>;
+        using object = std::vector<json_member>;
+
+        json_value() = default;
+        explicit json_value(bool b) : _value{b} {}
+        explicit json_value(double d) : _value{d} {}
+        explicit json_value(std::string str) : _value{std::move(str)} {}
+        explicit json_value(array arr) : _value{std::move(arr)} {}
+        explicit json_value(object obj) : _value{std::move(obj)} {}
+
+        [[nodiscard]] bool is_null() const noexcept {
+            return std::holds_alternative<std::nullptr_t>(_value);
+        }
+
+        [[nodiscard]] bool is_object() const noexcept {
+            return std::holds_alternative<object>(_value);
+        }
+
+        // member of an object, or nullptr
+        [[nodiscard]] const json_value* find(std::string_view key) const noexcept;
+        // member of an object, or a null value
+        [[nodiscard]] const json_value& operator[](std::string_view key) const noexcept;
+
+        [[nodiscard]] double as_number(double fallback = 0) const noexcept;
+        [[nodiscard]] bool as_bool(bool fallback = false) const noexcept;
+        // empty if not a string
+        [[nodiscard]] const std::string& as_string() const noexcept;
+        // empty if not an array
+        [[nodiscard]] const array& as_array() const noexcept;
+
+        [[nodiscard]] std::string dump() const;
+
+    private:
+        std::variant<std::nullptr_t, bool, double, std::string, array, object> _value{nullptr};
+    };
+
+    struct json_member {
+        std::string key;
+        json_value value;
+    };
+
+    [[nodiscard]] std::optional<json_value> parse_json(std::string_view text);
+
+    // Appends str to out as a JSON string literal
+    void append_json_string(std::string& out, std::string_view str);
+}
+
+
+#endif //IMEDIT_LS_MOCK_JSON_VALUE_H
@@ -0,0 +1,149 @@
+#include "load_profile.h"
+
+#include <charconv>
+#include <string_view>
+
+namespace {
+    using namespace std::chrono_literals;
+
+    std::optional<mock::load_profile> named_profile(std::string_view name) {
+        mock::load_profile profile;
+        if (name == "instant") {
+            return profile;
+        }
+        if (name == "typical") {
+            profile.latency = 5ms;
+            profile.jitter = 10ms;
+            profile.diagnostics_delay = 200ms;
+            return profile;
+        }
+        if (name == "heavy") {
+            profile.tokens_per_line = 12;
+            profile.diagnostics_per_100_lines = 20;
+            profile.completion_items = 5000;
+            profile.latency = 40ms;
+            profile.jitter = 60ms;
+            profile.diagnostics_delay = 800ms;
+            return profile;
+        }
+        if (name == "flaky") {
+            profile.latency = 5ms;
+            profile.jitter = 10ms;
+            profile.diagnostics_delay = 200ms;
+            profile.slow_every = 7;
+            profile.slow_latency = 2s;
+            profile.stall_every = 23;
+            return profile;
+        }
+        if (name == "minimal") {
+            // no delta, no range, full document sync: the client's fallbacks
+            profile.semantic_tokens_delta = false;
+            profile.semantic_tokens_range = false;
+            profile.incremental_sync = false;
+            return profile;
+        }
+        return {};
+    }
+
+    bool parse_uint(std::string_view str, unsigned int& value) {
+        auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), value);
+        return error == std::errc{} && end == str.data() + str.size();
+    }
+
+    bool parse_ms(std::string_view str, std::chrono::milliseconds& value) {
+        unsigned int ms{};
+        if (!parse_uint(str, ms)) {
+            return false;
+        }
+        value = std::chrono::milliseconds{ms};
+        return true;
+    }
+}
+
+const char* const mock::load_profile_usage =
+    "usage: ImEdit_LS_mock_server [--profile NAME] [OPTION VALUE]...\n"
+    "  --profile NAME               instant (default), typical, heavy, flaky or minimal\n"
+    "  --tokens-per-line N          semantic tokens per line, 0 for one per identifier\n"
+    "  --diagnostics-per-100-lines N\n"
+    "  --completion-items N\n"
+    "  --latency-ms N               delay before each answer\n"
+    "  --jitter-ms N                random delay added to each answer, up to N\n"
+    "  --diagnostics-delay-ms N     delay before diagnostics are published after a change\n"
+    "  --slow-every N               answer every Nth request --slow-ms later (0: never)\n"
+    "  --slow-ms N\n"
+    "  --stall-every N              never answer every Nth request unless cancelled (0: never)\n"
+    "  --no-delta, --no-range, --full-sync\n"
+    "  --seed N\n";
+
+std::optional<mock::load_profile> mock::parse_load_profile(int argc, char* argv[]) {
+    std::optional<load_profile> profile = named_profile("instant");
+
+    // the profile is applied first, other options override it whatever their order
+    for (int i = 1 ; i + 1 < argc ; ++i) {
+        if (std::string_view{argv[i]} == "--profile") {
+            profile = named_profile(argv[i + 1]);
+            if (!profile) {
+                return {};
+            }
+        }
+    }
+
+    for (int i = 1 ; i < argc ; ++i) {
+        std::string_view arg = argv[i];
+        if (!arg.starts_with("--")) {
+            continue;
+        }
+
+        if (arg == "--no-delta") {
+            profile->semantic_tokens_delta = false;
+            continue;
+        }
+        if (arg == "--no-range") {
+            profile->semantic_tokens_range = false;
+            continue;
+        }
+        if (arg == "--full-sync") {
+            profile->incremental_sync = false;
+            continue;
+        }
+
+        if (i + 1 == argc) {
+            return {};
+        }
+        std::string_view value = argv[++i];
+        unsigned int seed{};
+
+        bool valid = true;
+        if (arg == "--profile") {
+            // already applied
+        } else if (arg == "--tokens-per-line") {
+            valid = parse_uint(value, profile->tokens_per_line);
+        } else if (arg == "--diagnostics-per-100-lines") {
+            valid = parse_uint(value, profile->diagnostics_per_100_lines);
+        } else if (arg == "--completion-items") {
+            valid = parse_uint(value, profile->completion_items);
+        } else if (arg == "--latency-ms") {
+            valid = parse_ms(value, profile->latency);
+        } else if (arg == "--jitter-ms") {
+            valid = parse_ms(value, profile->jitter);
+        } else if (arg == "--diagnostics-delay-ms") {
+            valid = parse_ms(value, profile->diagnostics_delay);
+        } else if (arg == "--slow-every") {
+            valid = parse_uint(value, profile->slow_every);
+        } else if (arg == "--slow-ms") {
+            valid = parse_ms(value, profile->slow_latency);
+        } else if (arg == "--stall-every") {
+            valid = parse_uint(value, profile->stall_every);
+        } else if (arg == "--seed") {
+            valid = parse_uint(value, seed);
+            profile->seed = seed;
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            return {};
+        }
+    }
+    return profile;
+}
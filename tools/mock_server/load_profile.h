@@ -0,0 +1,48 @@
+#ifndef IMEDIT_LS_MOCK_LOAD_PROFILE_H
+#define IMEDIT_LS_MOCK_LOAD_PROFILE_H
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mock {
+    // What the mock server advertises, how much it answers, and how late
+    struct load_profile {
+        // capabilities
+        bool semantic_tokens_delta{true};
+        bool semantic_tokens_range{true};
+        bool incremental_sync{true};
+        std::vector<std::string> token_types{
+            "namespace", "type", "class", "enum", "parameter", "variable", "property", "enumMember",
+            "function", "method", "macro", "comment", "typeParameter", "concept", "operator"
+        };
+        std::vector<std::string> token_modifiers{"declaration", "definition", "readonly", "static"};
+
+        // sizes
+        unsigned int tokens_per_line{0}; // 0: one token per identifier of the line
+        unsigned int diagnostics_per_100_lines{1};
+        unsigned int completion_items{200};
+
+        // latencies
+        std::chrono::milliseconds latency{0};
+        std::chrono::milliseconds jitter{0}; // added uniformly at random to each latency
+        std::chrono::milliseconds diagnostics_delay{0};
+        unsigned int slow_every{0}; // every nth request is answered slow_latency later, 0 for never
+        std::chrono::milliseconds slow_latency{1000};
+        unsigned int stall_every{0}; // every nth request is never answered, unless cancelled. 0 for never
+
+        std::uint32_t seed{42};
+    };
+
+    // Parses the command line, starting from the profile named by --profile. Arguments starting with a single
+    // '-' are those of the real servers the mock stands in for, and are ignored.
+    // Returns an empty optional on invalid arguments.
+    [[nodiscard]] std::optional<load_profile> parse_load_profile(int argc, char* argv[]);
+
+    extern const char* const load_profile_usage;
+}
+
+
+#endif //IMEDIT_LS_MOCK_LOAD_PROFILE_H
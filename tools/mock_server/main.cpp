@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "mock_server.h"
+
+namespace {
+    bool write_all(std::string_view data) {
+        while (!data.empty()) {
+            ssize_t written = ::write(STDOUT_FILENO, data.data(), data.size());
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data.remove_prefix(static_cast<std::size_t>(written));
+        }
+        return true;
+    }
+
+    bool send(std::string_view body) {
+        std::string message = "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        message += body;
+        return write_all(message);
+    }
+
+    // Extracts the first complete message of 'input'. Returns false when more input is needed
+    bool next_message(std::string& input, std::string& body) {
+        auto header_end = input.find("\r\n\r\n");
+        if (header_end == std::string::npos) {
+            return false;
+        }
+
+        std::size_t length{};
+        std::string_view headers{input.data(), header_end};
+        constexpr std::string_view content_length = "Content-Length:";
+        if (auto pos = headers.find(content_length) ; pos != std::string_view::npos) {
+            pos += content_length.size();
+            while (pos < headers.size() && headers[pos] == ' ') {
+                ++pos;
+            }
+            std::from_chars(headers.data() + pos, headers.data() + headers.size(), length);
+        }
+
+        std::size_t body_begin = header_end + 4;
+        if (input.size() < body_begin + length) {
+            return false;
+        }
+        body.assign(input, body_begin, length);
+        input.erase(0, body_begin + length);
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    auto profile = mock::parse_load_profile(argc, argv);
+    if (!profile) {
+        std::cerr << mock::load_profile_usage;
+        return 2;
+    }
+
+    mock::server server{std::move(*profile)};
+    std::string input;
+    std::string body;
+    char buffer[64 * 1024];
+    bool input_open = true;
+
+    while (!server.exit_requested()) {
+        auto now = mock::clock::now();
+        for (const std::string& message : server.take_due(now)) {
+            if (!send(message)) {
+                return 1;
+            }
+        }
+
+        if (!input_open) {
+            // stdin closed: flush what is still scheduled, then leave
+            auto due = server.next_due();
+            if (!due) {
+                break;
+            }
+            usleep(static_cast<useconds_t>(std::chrono::duration_cast<std::chrono::microseconds>(*due - now).count()));
+            continue;
+        }
+
+        int timeout = -1;
+        if (auto due = server.next_due() ; due) {
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(*due - now).count();
+            timeout = static_cast<int>(std::max<decltype(wait)>(wait, 0));
+        }
+
+        pollfd fd{.fd = STDIN_FILENO, .events = POLLIN, .revents = 0};
+        int ready = ::poll(&fd, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            return 1;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        ssize_t count = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        if (count == 0) {
+            input_open = false;
+            continue;
+        }
+
+        input.append(buffer, static_cast<std::size_t>(count));
+        now = mock::clock::now();
+        while (next_message(input, body)) {
+            server.receive(body, now);
+        }
+    }
+
+    // answers already due, such as the one to shutdown, are still sent on exit
+    for (const std::string& message : server.take_due(mock::clock::now())) {
+        send(message);
+    }
+    return 0;
+}
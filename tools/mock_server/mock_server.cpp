@@ -0,0 +1,452 @@
+#include "mock_server.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace {
+    constexpr int method_not_found = -32601;
+    constexpr int request_cancelled = -32800;
+
+    std::vector<std::string> split_lines(std::string_view text) {
+        std::vector<std::string> lines;
+        while (true) {
+            auto end = text.find('\n');
+            lines.emplace_back(text.substr(0, end));
+            if (end == std::string_view::npos) {
+                return lines;
+            }
+            text.remove_prefix(end + 1);
+        }
+    }
+
+    void append_uint(std::string& out, std::uint64_t value) {
+        char buffer[24];
+        auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, end);
+    }
+
+    void append_uint_array(std::string& out, const std::uint32_t* begin, const std::uint32_t* end) {
+        out += '[';
+        for (const std::uint32_t* it = begin ; it != end ; ++it) {
+            if (it != begin) {
+                out += ',';
+            }
+            append_uint(out, *it);
+        }
+        out += ']';
+    }
+
+    void append_position(std::string& out, std::uint64_t line, std::uint64_t character) {
+        out += R"({"line":)";
+        append_uint(out, line);
+        out += R"(,"character":)";
+        append_uint(out, character);
+        out += '}';
+    }
+
+    std::uint32_t fnv1a(std::string_view str) noexcept {
+        std::uint32_t hash = 2166136261u;
+        for (char c : str) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return hash;
+    }
+
+    bool is_identifier_start(char c) noexcept {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    bool is_identifier_char(char c) noexcept {
+        return is_identifier_start(c) || (c >= '0' && c <= '9');
+    }
+
+    unsigned int to_uint(const mock::json_value& value) {
+        double number = value.as_number();
+        return number <= 0 ? 0 : static_cast<unsigned int>(number);
+    }
+}
+
+mock::server::server(load_profile profile)
+    : _profile{std::move(profile)}
+    , _rng{_profile.seed}
+{}
+
+void mock::server::receive(std::string_view body, clock::time_point now) {
+    auto message = parse_json(body);
+    if (!message || !message->is_object()) {
+        return;
+    }
+
+    const std::string& method = (*message)["method"].as_string();
+    if (method.empty()) {
+        // answer to one of our requests, we never send any
+        return;
+    }
+
+    const json_value& params = (*message)["params"];
+    if (const json_value* id = message->find("id") ; id != nullptr) {
+        handle_request(id->dump(), method, params, now);
+    } else {
+        handle_notification(method, params, now);
+    }
+}
+
+std::vector<std::string> mock::server::take_due(clock::time_point now) {
+    auto end = std::find_if(_queue.begin(), _queue.end(), [now](const scheduled_message& message) {
+        return message.due > now;
+    });
+
+    std::vector<std::string> due;
+    due.reserve(static_cast<std::size_t>(end - _queue.begin()));
+    for (auto it = _queue.begin() ; it != end ; ++it) {
+        due.push_back(std::move(it->body));
+    }
+    _queue.erase(_queue.begin(), end);
+    return due;
+}
+
+std::optional<mock::clock::time_point> mock::server::next_due() const {
+    if (_queue.empty()) {
+        return {};
+    }
+    return _queue.front().due;
+}
+
+void mock::server::handle_request(const std::string& id, std::string_view method, const json_value& params, clock::time_point now) {
+    // the lifecycle is never slowed down, so that clients always start and stop
+    if (method == "initialize") {
+        schedule({.due = now, .sequence = {}, .body = R"({"jsonrpc":"2.0","id":)" + id + R"(,"result":)" + initialize_result(params) + "}"});
+        return;
+    }
+    if (method == "shutdown") {
+        schedule({.due = now, .sequence = {}, .body = R"({"jsonrpc":"2.0","id":)" + id + R"(,"result":null})"});
+        return;
+    }
+
+    ++_request_count;
+    if (method == "textDocument/semanticTokens/full" || method == "textDocument/semanticTokens/full/delta"
+        || method == "textDocument/semanticTokens/range") {
+        respond(id, semantic_tokens_result(params, method), now);
+    } else if (method == "textDocument/completion") {
+        respond(id, completion_result(), now);
+    } else if (method == "completionItem/resolve") {
+        std::string item = params.dump();
+        if (params.is_object()) {
+            std::string documentation = R"("documentation":{"kind":"markdown","value":)";
+            append_json_string(documentation, "Documentation of **" + params["label"].as_string() + "**");
+            documentation += '}';
+            item.insert(item.size() - 1, (item.size() > 2 ? "," : "") + documentation);
+        }
+        respond(id, item, now);
+    } else if (method == "textDocument/hover") {
+        std::string result = R"({"contents":{"kind":"markdown","value":)";
+        append_json_string(result, "`mock` hover at line " + std::to_string(to_uint(params["position"]["line"]))
+                                   + ", character " + std::to_string(to_uint(params["position"]["character"])));
+        result += "}}";
+        respond(id, result, now);
+    } else if (method == "textDocument/definition") {
+        std::string result = R"([{"uri":)";
+        append_json_string(result, params["textDocument"]["uri"].as_string());
+        result += R"(,"range":{"start":)";
+        append_position(result, 0, 0);
+        result += R"(,"end":)";
+        append_position(result, 0, 1);
+        result += "}}]";
+        respond(id, result, now);
+    } else {
+        respond_error(id, method_not_found, "method not found", now);
+    }
+}
+
+void mock::server::handle_notification(std::string_view method, const json_value& params, clock::time_point now) {
+    if (method == "exit") {
+        _exit_requested = true;
+        return;
+    }
+
+    if (method == "$/cancelRequest") {
+        std::string id = params["id"].dump();
+        if (_stalled_requests.erase(id) != 0) {
+            respond_error(id, request_cancelled, "request cancelled", now);
+            return;
+        }
+        auto it = std::find_if(_queue.begin(), _queue.end(), [&id](const scheduled_message& message) {
+            return message.request_id == id;
+        });
+        if (it != _queue.end()) {
+            _queue.erase(it);
+            respond_error(id, request_cancelled, "request cancelled", now);
+        }
+        return;
+    }
+
+    const std::string& uri = params["textDocument"]["uri"].as_string();
+    if (method == "textDocument/didOpen") {
+        _documents[uri].lines = split_lines(params["textDocument"]["text"].as_string());
+        schedule_diagnostics(uri, now);
+    } else if (method == "textDocument/didChange") {
+        document& doc = _documents[uri];
+        for (const json_value& change : params["contentChanges"].as_array()) {
+            apply_change(doc, change);
+        }
+        schedule_diagnostics(uri, now);
+    } else if (method == "textDocument/didClose") {
+        _documents.erase(uri);
+    }
+}
+
+void mock::server::respond(const std::string& id, std::string_view result, clock::time_point now) {
+    if (_profile.stall_every != 0 && _request_count % _profile.stall_every == 0) {
+        _stalled_requests.insert(id);
+        return;
+    }
+
+    auto delay = _profile.latency;
+    if (_profile.jitter.count() > 0) {
+        std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(0, _profile.jitter.count());
+        delay += std::chrono::milliseconds{jitter(_rng)};
+    }
+    if (_profile.slow_every != 0 && _request_count % _profile.slow_every == 0) {
+        delay += _profile.slow_latency;
+    }
+
+    std::string body = R"({"jsonrpc":"2.0","id":)" + id + R"(,"result":)";
+    body += result;
+    body += '}';
+    schedule({.due = now + delay, .sequence = {}, .body = std::move(body), .request_id = id});
+}
+
+void mock::server::respond_error(const std::string& id, int code, std::string_view message, clock::time_point due) {
+    std::string body = R"({"jsonrpc":"2.0","id":)" + id + R"(,"error":{"code":)" + std::to_string(code) + R"(,"message":)";
+    append_json_string(body, message);
+    body += "}}";
+    schedule({.due = due, .sequence = {}, .body = std::move(body)});
+}
+
+void mock::server::schedule(scheduled_message message) {
+    message.sequence = _sequence++;
+    auto position = std::upper_bound(_queue.begin(), _queue.end(), message, [](const scheduled_message& lhs, const scheduled_message& rhs) {
+        return lhs.due < rhs.due || (lhs.due == rhs.due && lhs.sequence < rhs.sequence);
+    });
+    _queue.insert(position, std::move(message));
+}
+
+void mock::server::apply_change(document& doc, const json_value& change) {
+    const std::string& text = change["text"].as_string();
+    const json_value* range = change.find("range");
+    if (range == nullptr) {
+        doc.lines = split_lines(text);
+        return;
+    }
+
+    // positions are taken as byte offsets: exact for utf-8, and for ascii whatever the negotiated encoding
+    auto clamp_position = [&doc](const json_value& position) {
+        auto line = std::min<std::size_t>(to_uint(position["line"]), doc.lines.size() - 1);
+        auto character = std::min<std::size_t>(to_uint(position["character"]), doc.lines[line].size());
+        return std::pair{line, character};
+    };
+    auto [start_line, start_char] = clamp_position((*range)["start"]);
+    auto [end_line, end_char] = clamp_position((*range)["end"]);
+    if (end_line < start_line || (end_line == start_line && end_char < start_char)) {
+        return;
+    }
+
+    std::vector<std::string> inserted = split_lines(text);
+    inserted.front().insert(0, doc.lines[start_line], 0, start_char);
+    inserted.back().append(doc.lines[end_line], end_char);
+
+    auto first = doc.lines.begin() + static_cast<std::ptrdiff_t>(start_line);
+    first = doc.lines.erase(first, first + static_cast<std::ptrdiff_t>(end_line - start_line + 1));
+    doc.lines.insert(first, std::make_move_iterator(inserted.begin()), std::make_move_iterator(inserted.end()));
+}
+
+void mock::server::schedule_diagnostics(const std::string& uri, clock::time_point now) {
+    // like real servers, only publish the diagnostics of the latest version
+    std::erase_if(_queue, [&uri](const scheduled_message& message) noexcept {
+        return message.diagnostics_uri == uri;
+    });
+
+    const document& doc = _documents[uri];
+    std::size_t count = doc.lines.size() * _profile.diagnostics_per_100_lines / 100;
+
+    std::string body = R"({"jsonrpc":"2.0","method":"textDocument/publishDiagnostics","params":{"uri":)";
+    append_json_string(body, uri);
+    body += R"(,"diagnostics":[)";
+    for (std::size_t i = 0 ; i < count ; ++i) {
+        std::size_t line = i * doc.lines.size() / count;
+        if (i != 0) {
+            body += ',';
+        }
+        body += R"({"range":{"start":)";
+        append_position(body, line, 0);
+        body += R"(,"end":)";
+        append_position(body, line, doc.lines[line].size());
+        body += R"(},"severity":)";
+        append_uint(body, i % 4 + 1);
+        body += R"(,"source":"mock","message":"mock diagnostic )";
+        append_uint(body, i);
+        body += "\"}";
+    }
+    body += "]}}";
+
+    schedule({.due = now + _profile.diagnostics_delay, .sequence = {}, .body = std::move(body), .diagnostics_uri = uri});
+}
+
+std::string mock::server::initialize_result(const json_value& params) const {
+    bool utf8 = false;
+    for (const json_value& encoding : params["capabilities"]["general"]["positionEncodings"].as_array()) {
+        utf8 = utf8 || encoding.as_string() == "utf-8";
+    }
+
+    auto append_string_array = [](std::string& out, const std::vector<std::string>& strings) {
+        out += '[';
+        for (std::size_t i = 0 ; i < strings.size() ; ++i) {
+            if (i != 0) {
+                out += ',';
+            }
+            append_json_string(out, strings[i]);
+        }
+        out += ']';
+    };
+
+    std::string result = R"({"capabilities":{"positionEncoding":)";
+    result += utf8 ? R"("utf-8")" : R"("utf-16")";
+    result += R"(,"textDocumentSync":{"openClose":true,"change":)";
+    result += _profile.incremental_sync ? "2" : "1";
+    result += R"(},"completionProvider":{"triggerCharacters":[".",">",":"],"resolveProvider":true})";
+    result += R"(,"hoverProvider":true,"definitionProvider":true)";
+    result += R"(,"semanticTokensProvider":{"legend":{"tokenTypes":)";
+    append_string_array(result, _profile.token_types);
+    result += R"(,"tokenModifiers":)";
+    append_string_array(result, _profile.token_modifiers);
+    result += R"(},"full":{"delta":)";
+    result += _profile.semantic_tokens_delta ? "true" : "false";
+    result += R"(},"range":)";
+    result += _profile.semantic_tokens_range ? "true" : "false";
+    result += R"(}},"serverInfo":{"name":"ImEdit_LS mock server","version":"1.0"}})";
+    return result;
+}
+
+std::string mock::server::semantic_tokens_result(const json_value& params, std::string_view method) {
+    document& doc = _documents[params["textDocument"]["uri"].as_string()];
+    const auto line_count = static_cast<unsigned int>(doc.lines.size());
+
+    std::string result = "{";
+    if (method == "textDocument/semanticTokens/range") {
+        const json_value& range = params["range"];
+        unsigned int first = std::min(to_uint(range["start"]["line"]), line_count);
+        unsigned int last = to_uint(range["end"]["line"]) + (to_uint(range["end"]["character"]) > 0 ? 1 : 0);
+        auto data = encode_tokens(doc, first, std::clamp(last, first, line_count));
+
+        result += R"("data":)";
+        append_uint_array(result, data.data(), data.data() + data.size());
+        result += '}';
+        return result;
+    }
+
+    auto data = encode_tokens(doc, 0, line_count);
+    std::string result_id = std::to_string(++_result_id_counter);
+    result += R"("resultId":)";
+    append_json_string(result, result_id);
+
+    bool delta = method == "textDocument/semanticTokens/full/delta" && !doc.result_id.empty()
+                 && params["previousResultId"].as_string() == doc.result_id;
+    if (delta) {
+        // a single edit replacing what lies between the common prefix and suffix
+        const auto& old_data = doc.tokens;
+        std::size_t prefix = 0;
+        while (prefix < old_data.size() && prefix < data.size() && old_data[prefix] == data[prefix]) {
+            ++prefix;
+        }
+        std::size_t suffix = 0;
+        while (suffix < old_data.size() - prefix && suffix < data.size() - prefix
+               && old_data[old_data.size() - suffix - 1] == data[data.size() - suffix - 1]) {
+            ++suffix;
+        }
+
+        result += R"(,"edits":[)";
+        if (prefix != old_data.size() || prefix != data.size()) {
+            result += R"({"start":)";
+            append_uint(result, prefix);
+            result += R"(,"deleteCount":)";
+            append_uint(result, old_data.size() - prefix - suffix);
+            result += R"(,"data":)";
+            append_uint_array(result, data.data() + prefix, data.data() + data.size() - suffix);
+            result += '}';
+        }
+        result += "]}";
+    } else {
+        result += R"(,"data":)";
+        append_uint_array(result, data.data(), data.data() + data.size());
+        result += '}';
+    }
+
+    doc.tokens = std::move(data);
+    doc.result_id = std::move(result_id);
+    return result;
+}
+
+std::string mock::server::completion_result() const {
+    std::string result = R"({"isIncomplete":false,"items":[)";
+    for (unsigned int i = 0 ; i < _profile.completion_items ; ++i) {
+        std::string label = "mock_item_" + std::to_string(i);
+        if (i != 0) {
+            result += ',';
+        }
+        result += R"({"label":)";
+        append_json_string(result, label);
+        result += R"(,"kind":)";
+        append_uint(result, i % 25 + 1);
+        result += R"(,"detail":)";
+        append_json_string(result, "int " + label + "()");
+        result += R"(,"insertText":)";
+        append_json_string(result, label);
+        result += R"(,"data":)";
+        append_uint(result, i);
+        result += '}';
+    }
+    result += "]}";
+    return result;
+}
+
+std::vector<std::uint32_t> mock::server::encode_tokens(const document& doc, unsigned int first_line, unsigned int last_line) const {
+    std::vector<std::uint32_t> data;
+    std::uint32_t previous_line = 0;
+    std::uint32_t previous_char = 0;
+    auto emit = [&](std::uint32_t line, std::uint32_t character, std::uint32_t length, std::uint32_t hash) {
+        std::uint32_t delta_line = line - previous_line;
+        data.push_back(delta_line);
+        data.push_back(delta_line == 0 ? character - previous_char : character);
+        data.push_back(length);
+        data.push_back(hash % static_cast<std::uint32_t>(_profile.token_types.size()));
+        data.push_back((hash >> 16) & ((1u << _profile.token_modifiers.size()) - 1));
+        previous_line = line;
+        previous_char = character;
+    };
+
+    for (std::uint32_t line = first_line ; line < last_line ; ++line) {
+        std::string_view text = doc.lines[line];
+
+        if (_profile.tokens_per_line != 0) {
+            auto width = std::max<std::uint32_t>(1, static_cast<std::uint32_t>(text.size()) / _profile.tokens_per_line);
+            for (std::uint32_t i = 0 ; i < _profile.tokens_per_line && i * width < text.size() ; ++i) {
+                emit(line, i * width, std::max<std::uint32_t>(1, width / 2), fnv1a(text.substr(i * width, width)));
+            }
+            continue;
+        }
+
+        for (std::size_t pos = 0 ; pos < text.size() ;) {
+            if (!is_identifier_start(text[pos])) {
+                ++pos;
+                continue;
+            }
+            std::size_t end = pos + 1;
+            while (end < text.size() && is_identifier_char(text[end])) {
+                ++end;
+            }
+            emit(line, static_cast<std::uint32_t>(pos), static_cast<std::uint32_t>(end - pos), fnv1a(text.substr(pos, end - pos)));
+            pos = end;
+        }
+    }
+    return data;
+}
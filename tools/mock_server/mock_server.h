@@ -0,0 +1,80 @@
+#ifndef IMEDIT_LS_MOCK_MOCK_SERVER_H
+#define IMEDIT_LS_MOCK_MOCK_SERVER_H
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "json_value.h"
+#include "load_profile.h"
+
+namespace mock {
+    using clock = std::chrono::steady_clock;
+
+    // Language server state and answers, with no I/O: messages are fed in, and the answers are collected once due
+    class server {
+    public:
+        explicit server(load_profile profile);
+
+        // Handles the body of one message from the client
+        void receive(std::string_view body, clock::time_point now);
+
+        // Bodies of the messages due at 'now', in order
+        [[nodiscard]] std::vector<std::string> take_due(clock::time_point now);
+        [[nodiscard]] std::optional<clock::time_point> next_due() const;
+
+        [[nodiscard]] bool exit_requested() const noexcept {
+            return _exit_requested;
+        }
+
+    private:
+        struct document {
+            std::vector<std::string> lines{""};
+            std::vector<std::uint32_t> tokens{}; // last sent, delta-encoded
+            std::string result_id{};
+        };
+
+        struct scheduled_message {
+            clock::time_point due;
+            std::uint64_t sequence; // keeps messages due at the same time in order
+            std::string body;
+            std::string request_id{}; // raw JSON, responses only
+            std::string diagnostics_uri{}; // publishDiagnostics only
+        };
+
+        void handle_request(const std::string& id, std::string_view method, const json_value& params, clock::time_point now);
+        void handle_notification(std::string_view method, const json_value& params, clock::time_point now);
+
+        void respond(const std::string& id, std::string_view result, clock::time_point now);
+        void respond_error(const std::string& id, int code, std::string_view message, clock::time_point due);
+        void schedule(scheduled_message message);
+
+        void apply_change(document& doc, const json_value& change);
+        void schedule_diagnostics(const std::string& uri, clock::time_point now);
+
+        [[nodiscard]] std::string initialize_result(const json_value& params) const;
+        [[nodiscard]] std::string semantic_tokens_result(const json_value& params, std::string_view method);
+        [[nodiscard]] std::string completion_result() const;
+        [[nodiscard]] std::vector<std::uint32_t> encode_tokens(const document& doc, unsigned int first_line, unsigned int last_line) const;
+
+        load_profile _profile;
+        std::mt19937 _rng;
+        std::uint64_t _request_count{};
+        std::uint64_t _sequence{};
+        std::uint64_t _result_id_counter{};
+        bool _exit_requested{false};
+
+        std::unordered_map<std::string, document> _documents{};
+        std::vector<scheduled_message> _queue{}; // sorted by (due, sequence)
+        std::unordered_set<std::string> _stalled_requests{};
+    };
+}
+
+
+#endif //IMEDIT_LS_MOCK_MOCK_SERVER_H